@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "archive.h"
+
+#define SCREENS_MAGIC "CBMSCR01"
+#define LOG_MAGIC     "CBMLOG01"
+#define MAGIC_SIZE    8
+#define SCREEN_HEADER 11 // hash, graphic, length
+#define LOG_ENTRY     16
+
+// PackBits output is at most one byte per 128 longer than its input
+#define MAX_PACKED (SCREEN_SIZE + SCREEN_SIZE / 128 + 1)
+
+static void put_le32(unsigned char* p, uint32_t value)
+{
+  for (unsigned i = 0; i < 4; i++)
+  {
+    p[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+static void put_le64(unsigned char* p, uint64_t value)
+{
+  put_le32(p, (uint32_t)value);
+  put_le32(p + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t get_le32(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_le64(const unsigned char* p)
+{
+  return get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+//----------------------------------------------------------------------------------------
+// PackBits: a control byte n < 128 is followed by n + 1 literal bytes,
+// n > 128 by one byte repeated 257 - n times
+
+static unsigned pack(const unsigned char* src, unsigned size, unsigned char* dst)
+{
+  unsigned length = 0;
+  unsigned i = 0;
+  while (i < size)
+  {
+    unsigned run = 1;
+    while (i + run < size && run < 128 && src[i + run] == src[i])
+    {
+      run++;
+    }
+    if (run >= 3)
+    {
+      dst[length++] = (unsigned char)(257 - run);
+      dst[length++] = src[i];
+      i += run;
+      continue;
+    }
+    // literals up to the next run of three
+    unsigned start = i;
+    while (i < size && i - start < 128 &&
+           !(i + 2 < size && src[i] == src[i + 1] && src[i] == src[i + 2]))
+    {
+      i++;
+    }
+    dst[length++] = (unsigned char)(i - start - 1);
+    memcpy(dst + length, src + start, i - start);
+    length += i - start;
+  }
+  return length;
+}
+
+// unpack returns 0 if the data doesn't decode to exactly size bytes
+static int unpack(const unsigned char* src, unsigned length, unsigned char* dst, unsigned size)
+{
+  unsigned out = 0;
+  unsigned i = 0;
+  while (i < length)
+  {
+    unsigned n = src[i++];
+    if (n < 128)
+    {
+      if (i + n + 1 > length || out + n + 1 > size)
+      {
+        return 0;
+      }
+      memcpy(dst + out, src + i, n + 1);
+      i += n + 1;
+      out += n + 1;
+    }
+    else if (n > 128)
+    {
+      if (i >= length || out + 257 - n > size)
+      {
+        return 0;
+      }
+      memset(dst + out, src[i++], 257 - n);
+      out += 257 - n;
+    }
+  }
+  return out == size;
+}
+
+//----------------------------------------------------------------------------------------
+
+// archive_hash hashes the screen codes 8 at a time, the archive compares
+// the screens themselves on a match, so collisions only cost time
+uint64_t archive_hash(const unsigned char* screen, unsigned char graphic)
+{
+  uint64_t hash = 0xcbf29ce484222325ull ^ graphic;
+  for (unsigned i = 0; i < SCREEN_SIZE; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, screen + i, 8);
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+static int insert_slot(t_archive* archive, uint64_t hash, uint32_t id)
+{
+  if ((archive->screen_count + 1) * 2 > archive->slot_count)
+  {
+    uint32_t count = archive->slot_count * 2;
+    t_archive_slot* slots = malloc(count * sizeof(t_archive_slot));
+    if (slots == NULL)
+    {
+      return -1;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+      slots[i].id = ARCHIVE_NONE;
+    }
+    for (uint32_t i = 0; i < archive->slot_count; i++)
+    {
+      if (archive->slots[i].id != ARCHIVE_NONE)
+      {
+        uint32_t s = archive->slots[i].hash & (count - 1);
+        while (slots[s].id != ARCHIVE_NONE)
+        {
+          s = (s + 1) & (count - 1);
+        }
+        slots[s] = archive->slots[i];
+      }
+    }
+    free(archive->slots);
+    archive->slots = slots;
+    archive->slot_count = count;
+  }
+  uint32_t s = hash & (archive->slot_count - 1);
+  while (archive->slots[s].id != ARCHIVE_NONE)
+  {
+    s = (s + 1) & (archive->slot_count - 1);
+  }
+  archive->slots[s].hash = hash;
+  archive->slots[s].id = id;
+  return 0;
+}
+
+// add_screen_entry records the file offset of a new screen id
+static int add_screen_entry(t_archive* archive, uint64_t hash, uint64_t offset)
+{
+  if (archive->screen_count == archive->screen_size)
+  {
+    uint32_t size = archive->screen_size * 2;
+    uint64_t* offsets = realloc(archive->offsets, size * sizeof(uint64_t));
+    if (offsets == NULL)
+    {
+      return -1;
+    }
+    archive->offsets = offsets;
+    uint32_t* heads = realloc(archive->heads, size * sizeof(uint32_t));
+    if (heads == NULL)
+    {
+      return -1;
+    }
+    archive->heads = heads;
+    archive->screen_size = size;
+  }
+  if (insert_slot(archive, hash, archive->screen_count) < 0)
+  {
+    return -1;
+  }
+  archive->offsets[archive->screen_count] = offset;
+  archive->heads[archive->screen_count] = ARCHIVE_NONE;
+  archive->screen_count++;
+  return 0;
+}
+
+int archive_load_screen(t_archive* archive, uint32_t id, unsigned char* screen, unsigned char* graphic)
+{
+  unsigned char entry[SCREEN_HEADER + MAX_PACKED];
+  if (id >= archive->screen_count)
+  {
+    return -1;
+  }
+  ssize_t size = pread(archive->screens_fd, entry, sizeof(entry), archive->offsets[id]);
+  if (size < SCREEN_HEADER)
+  {
+    return -1;
+  }
+  unsigned length = entry[9] | (entry[10] << 8);
+  if (SCREEN_HEADER + length > (unsigned)size || !unpack(entry + SCREEN_HEADER, length, screen, SCREEN_SIZE))
+  {
+    return -1;
+  }
+  *graphic = entry[8];
+  return 0;
+}
+
+// archive_find returns the id of a screen, or ARCHIVE_NONE if it isn't archived
+uint32_t archive_find(t_archive* archive, const unsigned char* screen, unsigned char graphic)
+{
+  unsigned char stored[SCREEN_SIZE];
+  unsigned char stored_graphic;
+  uint64_t hash = archive_hash(screen, graphic);
+  uint32_t s = hash & (archive->slot_count - 1);
+  while (archive->slots[s].id != ARCHIVE_NONE)
+  {
+    if (archive->slots[s].hash == hash &&
+        archive_load_screen(archive, archive->slots[s].id, stored, &stored_graphic) == 0 &&
+        stored_graphic == graphic && memcmp(stored, screen, SCREEN_SIZE) == 0)
+    {
+      return archive->slots[s].id;
+    }
+    s = (s + 1) & (archive->slot_count - 1);
+  }
+  return ARCHIVE_NONE;
+}
+
+static int open_file(const char* directory, const char* name, int flags, const char* magic, off_t* size)
+{
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", directory, name);
+  int fd = open(path, flags | O_CREAT, 0644);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0)
+  {
+    perror(path);
+    return -1;
+  }
+  *size = st.st_size;
+  if (magic != NULL)
+  {
+    char header[MAGIC_SIZE];
+    if (st.st_size == 0)
+    {
+      if (write(fd, magic, MAGIC_SIZE) != MAGIC_SIZE)
+      {
+        perror(path);
+        close(fd);
+        return -1;
+      }
+      *size = MAGIC_SIZE;
+    }
+    else if (pread(fd, header, MAGIC_SIZE, 0) != MAGIC_SIZE || memcmp(header, magic, MAGIC_SIZE) != 0)
+    {
+      fprintf(stderr, "%s: not an archive file\n", path);
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+// load_screens builds the hash table from screens.dat, an incomplete
+// last entry (from a crash) is cut off
+static int load_screens(t_archive* archive, off_t size)
+{
+  unsigned char header[SCREEN_HEADER];
+  off_t offset = MAGIC_SIZE;
+  while (offset + SCREEN_HEADER <= size &&
+         pread(archive->screens_fd, header, SCREEN_HEADER, offset) == SCREEN_HEADER)
+  {
+    unsigned length = header[9] | (header[10] << 8);
+    if (offset + SCREEN_HEADER + length > size)
+    {
+      break;
+    }
+    if (add_screen_entry(archive, get_le64(header), offset) < 0)
+    {
+      return -1;
+    }
+    offset += SCREEN_HEADER + length;
+  }
+  return offset == size ? 0 : ftruncate(archive->screens_fd, offset);
+}
+
+// load_heads reads heads.dat, or rebuilds it from the log if it doesn't
+// match screens.dat
+static int load_heads(t_archive* archive, off_t size)
+{
+  if (size == (off_t)archive->screen_count * 4)
+  {
+    unsigned char entry[4];
+    for (uint32_t id = 0; id < archive->screen_count; id++)
+    {
+      if (pread(archive->heads_fd, entry, 4, (off_t)id * 4) != 4)
+      {
+        return -1;
+      }
+      archive->heads[id] = get_le32(entry);
+    }
+    return 0;
+  }
+  unsigned char entry[LOG_ENTRY];
+  for (uint32_t i = 0; i < archive->log_count; i++)
+  {
+    if (pread(archive->log_fd, entry, LOG_ENTRY, MAGIC_SIZE + (off_t)i * LOG_ENTRY) != LOG_ENTRY)
+    {
+      return -1;
+    }
+    uint32_t id = get_le32(entry + 8);
+    if (id < archive->screen_count)
+    {
+      archive->heads[id] = i;
+    }
+  }
+  unsigned char heads[4];
+  for (uint32_t id = 0; id < archive->screen_count; id++)
+  {
+    put_le32(heads, archive->heads[id]);
+    if (pwrite(archive->heads_fd, heads, 4, (off_t)id * 4) != 4)
+    {
+      return -1;
+    }
+  }
+  return ftruncate(archive->heads_fd, (off_t)archive->screen_count * 4);
+}
+
+// archive_open opens or creates the archive in directory, returns 0 or -1
+int archive_open(t_archive* archive, const char* directory)
+{
+  memset(archive, 0, sizeof(*archive));
+  archive->screens_fd = archive->log_fd = archive->heads_fd = -1;
+  if (mkdir(directory, 0755) < 0 && errno != EEXIST)
+  {
+    perror(directory);
+    return -1;
+  }
+  off_t screens_size, log_size, heads_size;
+  archive->screens_fd = open_file(directory, "screens.dat", O_RDWR | O_APPEND, SCREENS_MAGIC, &screens_size);
+  archive->log_fd = open_file(directory, "log.dat", O_RDWR | O_APPEND, LOG_MAGIC, &log_size);
+  archive->heads_fd = open_file(directory, "heads.dat", O_RDWR, NULL, &heads_size);
+  archive->screen_size = 1024;
+  archive->offsets = malloc(archive->screen_size * sizeof(uint64_t));
+  archive->heads = malloc(archive->screen_size * sizeof(uint32_t));
+  archive->slot_count = 2048;
+  archive->slots = malloc(archive->slot_count * sizeof(t_archive_slot));
+  if (archive->screens_fd < 0 || archive->log_fd < 0 || archive->heads_fd < 0 ||
+      archive->offsets == NULL || archive->heads == NULL || archive->slots == NULL)
+  {
+    archive_close(archive);
+    return -1;
+  }
+  for (uint32_t i = 0; i < archive->slot_count; i++)
+  {
+    archive->slots[i].id = ARCHIVE_NONE;
+  }
+
+  archive->log_count = (log_size - MAGIC_SIZE) / LOG_ENTRY;
+  if (MAGIC_SIZE + (off_t)archive->log_count * LOG_ENTRY != log_size &&
+      ftruncate(archive->log_fd, MAGIC_SIZE + (off_t)archive->log_count * LOG_ENTRY) < 0)
+  {
+    archive_close(archive);
+    return -1;
+  }
+  if (load_screens(archive, screens_size) < 0 || load_heads(archive, heads_size) < 0)
+  {
+    fprintf(stderr, "%s: can't read archive\n", directory);
+    archive_close(archive);
+    return -1;
+  }
+
+  archive->last_id = ARCHIVE_NONE;
+  unsigned char entry[LOG_ENTRY];
+  if (archive->log_count > 0 &&
+      pread(archive->log_fd, entry, LOG_ENTRY, MAGIC_SIZE + (off_t)(archive->log_count - 1) * LOG_ENTRY) == LOG_ENTRY)
+  {
+    archive->last_id = get_le32(entry + 8);
+    if (archive_load_screen(archive, archive->last_id, archive->last_screen, &archive->last_graphic) < 0)
+    {
+      archive->last_id = ARCHIVE_NONE;
+    }
+  }
+  return 0;
+}
+
+// archive_add logs an appearance of a screen at time (ms since the epoch),
+// storing the screen if it is new. Repeats of the latest screen are not
+// logged. Returns 1 if the screen was new, 0 if not, -1 on a write error.
+int archive_add(t_archive* archive, uint64_t time, const unsigned char* screen, unsigned char graphic)
+{
+  if (archive->last_id != ARCHIVE_NONE && graphic == archive->last_graphic &&
+      memcmp(screen, archive->last_screen, SCREEN_SIZE) == 0)
+  {
+    return 0;
+  }
+  int stored = 0;
+  uint32_t id = archive_find(archive, screen, graphic);
+  if (id == ARCHIVE_NONE)
+  {
+    unsigned char entry[SCREEN_HEADER + MAX_PACKED];
+    uint64_t hash = archive_hash(screen, graphic);
+    unsigned length = pack(screen, SCREEN_SIZE, entry + SCREEN_HEADER);
+    put_le64(entry, hash);
+    entry[8] = graphic;
+    entry[9] = length & 0xFF;
+    entry[10] = length >> 8;
+    off_t offset = lseek(archive->screens_fd, 0, SEEK_END);
+    if (offset < 0 || write(archive->screens_fd, entry, SCREEN_HEADER + length) != SCREEN_HEADER + length ||
+        add_screen_entry(archive, hash, offset) < 0)
+    {
+      return -1;
+    }
+    id = archive->screen_count - 1;
+    stored = 1;
+  }
+
+  unsigned char entry[LOG_ENTRY];
+  put_le64(entry, time);
+  put_le32(entry + 8, id);
+  put_le32(entry + 12, archive->heads[id]);
+  unsigned char head[4];
+  put_le32(head, archive->log_count);
+  if (write(archive->log_fd, entry, LOG_ENTRY) != LOG_ENTRY ||
+      pwrite(archive->heads_fd, head, 4, (off_t)id * 4) != 4)
+  {
+    return -1;
+  }
+  archive->heads[id] = archive->log_count;
+  archive->log_count++;
+  archive->last_id = id;
+  memcpy(archive->last_screen, screen, SCREEN_SIZE);
+  archive->last_graphic = graphic;
+  return stored;
+}
+
+// archive_appearances returns up to max_times times a screen appeared,
+// newest first, following the chain of its log entries
+unsigned archive_appearances(t_archive* archive, uint32_t id, uint64_t* times, unsigned max_times)
+{
+  if (id >= archive->screen_count)
+  {
+    return 0;
+  }
+  unsigned count = 0;
+  uint32_t entry_index = archive->heads[id];
+  unsigned char entry[LOG_ENTRY];
+  while (count < max_times && entry_index < archive->log_count &&
+         pread(archive->log_fd, entry, LOG_ENTRY, MAGIC_SIZE + (off_t)entry_index * LOG_ENTRY) == LOG_ENTRY)
+  {
+    times[count++] = get_le64(entry);
+    uint32_t previous = get_le32(entry + 12);
+    if (previous >= entry_index)
+    {
+      break; // a corrupt chain would loop
+    }
+    entry_index = previous;
+  }
+  return count;
+}
+
+void archive_close(t_archive* archive)
+{
+  if (archive->screens_fd >= 0) close(archive->screens_fd);
+  if (archive->log_fd >= 0) close(archive->log_fd);
+  if (archive->heads_fd >= 0) close(archive->heads_fd);
+  free(archive->offsets);
+  free(archive->heads);
+  free(archive->slots);
+  memset(archive, 0, sizeof(*archive));
+  archive->screens_fd = archive->log_fd = archive->heads_fd = -1;
+}
@@ -0,0 +1,59 @@
+// screen archive: each distinct screen is stored once, compressed, and
+// referenced by a log of the times it appeared
+//
+// An archive is a directory with three files, all numbers little endian:
+//
+//   screens.dat  "CBMSCR01", then per distinct screen: u64 hash, u8 graphic,
+//                u16 length, length bytes of PackBits compressed screen codes.
+//                The position in this file is the screen id (0, 1, ...).
+//   log.dat      "CBMLOG01", then per appearance: u64 time (ms since the
+//                epoch), u32 screen id, u32 log entry of the previous
+//                appearance of the same screen (ARCHIVE_NONE for the first)
+//   heads.dat    per screen id: u32 log entry of its latest appearance
+//
+// screens.dat and log.dat are append-only. The appearances of a screen form
+// a chain through the log, starting from its entry in heads.dat, so "when
+// did this screen appear" follows the chain instead of scanning the log.
+// The hash table from screen hash to id is built in memory when the
+// archive is opened, from screens.dat only.
+
+#ifndef __archive_h__
+#define __archive_h__
+
+#include <stdint.h>
+#include "screen.h"
+
+#define ARCHIVE_NONE 0xFFFFFFFF
+
+typedef struct {
+  uint64_t hash;
+  uint32_t id;
+} t_archive_slot;
+
+typedef struct {
+  int screens_fd;
+  int log_fd;
+  int heads_fd;
+  // per screen id
+  uint64_t* offsets; // of the entry in screens.dat
+  uint32_t* heads;
+  uint32_t screen_count;
+  uint32_t screen_size; // allocated entries
+  // hash table, open addressing, power of two
+  t_archive_slot* slots;
+  uint32_t slot_count;
+  uint32_t log_count;
+  uint32_t last_id; // of the latest appearance
+  unsigned char last_screen[SCREEN_SIZE];
+  unsigned char last_graphic;
+} t_archive;
+
+extern uint64_t archive_hash(const unsigned char* screen, unsigned char graphic);
+extern int archive_open(t_archive* archive, const char* directory);
+extern int archive_add(t_archive* archive, uint64_t time, const unsigned char* screen, unsigned char graphic);
+extern uint32_t archive_find(t_archive* archive, const unsigned char* screen, unsigned char graphic);
+extern int archive_load_screen(t_archive* archive, uint32_t id, unsigned char* screen, unsigned char* graphic);
+extern unsigned archive_appearances(t_archive* archive, uint32_t id, uint64_t* times, unsigned max_times);
+extern void archive_close(t_archive* archive);
+
+#endif
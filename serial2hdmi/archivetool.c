@@ -0,0 +1,217 @@
+// archivetool fills and queries screen archives
+//
+// usage: archivetool ingest archive session [frames per second]
+//        archivetool find archive recording ms
+//        archivetool stats archive
+//
+// ingest adds the screens of a raw session (timed at the given frame rate,
+// default 50) or a recording (see recording.h) to the archive and reports
+// the ingest rate and the archive growth per hour against storing every
+// frame. find looks up the screen a recording shows at the given time and
+// prints when it appeared in the archive.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "receiver.h"
+#include "recording.h"
+#include "archive.h"
+
+#define MAX_APPEARANCES 20
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static off_t file_size(const char* directory, const char* name)
+{
+  char path[512];
+  struct stat st;
+  snprintf(path, sizeof(path), "%s/%s", directory, name);
+  return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+static off_t archive_size(const char* directory)
+{
+  return file_size(directory, "screens.dat") + file_size(directory, "log.dat") + file_size(directory, "heads.dat");
+}
+
+static void print_time(uint64_t time)
+{
+  char text[32];
+  time_t seconds = (time_t)(time / 1000);
+  strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+  printf("%s.%03u\n", text, (unsigned)(time % 1000));
+}
+
+static int ingest(const char* directory, const char* session_file, double frame_rate)
+{
+  static unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic = 1;
+  t_archive archive;
+  if (archive_open(&archive, directory) < 0)
+  {
+    return 1;
+  }
+  off_t size_before = archive_size(directory);
+  uint32_t screens_before = archive.screen_count;
+  uint32_t log_before = archive.log_count;
+  unsigned frames = 0;
+  uint64_t start_time;
+  uint64_t time = 0;
+  int result = 0;
+  double start = now();
+
+  if (is_recording(session_file))
+  {
+    t_player player;
+    if (player_open(&player, session_file) < 0)
+    {
+      archive_close(&archive);
+      return 1;
+    }
+    start_time = player.start_time;
+    do
+    {
+      time = start_time + player.time;
+      frames++;
+      if (archive_add(&archive, time, player.screen, player.graphic) < 0)
+      {
+        result = 1;
+        break;
+      }
+    } while (player_next(&player));
+    player_close(&player);
+  }
+  else
+  {
+    FILE* fp = fopen(session_file, "rb");
+    if (fp == NULL)
+    {
+      perror(session_file);
+      archive_close(&archive);
+      return 1;
+    }
+    // raw sessions have no timestamps, the file time is taken as the end
+    struct stat st;
+    fstat(fileno(fp), &st);
+    t_receiver_context context;
+    init_receiver_context(&context);
+    context.screen_buffer = screen;
+    context.graphic = &graphic;
+    unsigned total = st.st_size / (52 * 41);
+    start_time = (uint64_t)st.st_mtime * 1000 - (uint64_t)(total * 1000.0 / frame_rate);
+    int byte;
+    while ((byte = fgetc(fp)) != EOF)
+    {
+      if (handle_received_byte(&context, (unsigned char)byte))
+      {
+        time = start_time + (uint64_t)(frames * 1000.0 / frame_rate);
+        frames++;
+        if (archive_add(&archive, time, screen, graphic) < 0)
+        {
+          result = 1;
+          break;
+        }
+      }
+    }
+    fclose(fp);
+  }
+  double elapsed = now() - start;
+  if (result != 0)
+  {
+    perror(directory);
+  }
+
+  double hours = (time - start_time) / 3600000.0;
+  off_t growth = archive_size(directory) - size_before;
+  printf("%u frames, %u new screens, %u appearances logged\n",
+    frames, archive.screen_count - screens_before, archive.log_count - log_before);
+  printf("ingest %.0f frames/s\n", frames / elapsed);
+  if (hours > 0.0)
+  {
+    printf("archive %.1f KB per hour, every frame %.1f KB per hour\n",
+      growth / 1024.0 / hours, (double)frames * (SCREEN_SIZE + 1) / 1024.0 / hours);
+  }
+  archive_close(&archive);
+  return result;
+}
+
+static int find(const char* directory, const char* recording_file, uint32_t time)
+{
+  t_archive archive;
+  t_player player;
+  if (archive_open(&archive, directory) < 0)
+  {
+    return 1;
+  }
+  if (player_open(&player, recording_file) < 0)
+  {
+    fprintf(stderr, "%s: not a readable recording\n", recording_file);
+    archive_close(&archive);
+    return 1;
+  }
+  player_seek(&player, time);
+
+  double start = now();
+  uint32_t id = archive_find(&archive, player.screen, player.graphic);
+  uint64_t times[MAX_APPEARANCES];
+  unsigned count = archive_appearances(&archive, id, times, MAX_APPEARANCES);
+  double elapsed = now() - start;
+
+  if (id == ARCHIVE_NONE)
+  {
+    printf("screen not archived\n");
+  }
+  else
+  {
+    printf("screen %u, latest %u appearances:\n", id, count);
+    for (unsigned i = 0; i < count; i++)
+    {
+      print_time(times[i]);
+    }
+  }
+  printf("lookup took %.1f us\n", elapsed * 1e6);
+  player_close(&player);
+  archive_close(&archive);
+  return 0;
+}
+
+static int stats(const char* directory)
+{
+  t_archive archive;
+  if (archive_open(&archive, directory) < 0)
+  {
+    return 1;
+  }
+  printf("%u screens in %lld bytes, %u appearances in %lld bytes\n",
+    archive.screen_count, (long long)file_size(directory, "screens.dat"),
+    archive.log_count, (long long)file_size(directory, "log.dat"));
+  archive_close(&archive);
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc >= 4 && strcmp(argv[1], "ingest") == 0)
+  {
+    return ingest(argv[2], argv[3], argc > 4 ? atof(argv[4]) : 50.0);
+  }
+  if (argc == 5 && strcmp(argv[1], "find") == 0)
+  {
+    return find(argv[2], argv[3], (uint32_t)strtoul(argv[4], NULL, 10));
+  }
+  if (argc == 3 && strcmp(argv[1], "stats") == 0)
+  {
+    return stats(argv[2]);
+  }
+  fprintf(stderr, "usage: archivetool ingest archive session [frames per second]\n"
+                  "       archivetool find archive recording ms\n"
+                  "       archivetool stats archive\n");
+  return 2;
+}
@@ -0,0 +1,263 @@
+// CBM 8032 character ROM (german), see doc/characters-german.bin
+// 256 characters of 8x8 pixels, one byte per pixel row, MSB is leftmost:
+// characters 0..127 are the graphic set, characters 128..255 the text set
+unsigned char cbmCharRomData[2048] = {
+  // graphic set
+  0x1c, 0x22, 0x4a, 0x56, 0x4c, 0x20, 0x1e, 0x00, // 00
+  0x18, 0x24, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x00, // 01
+  0x7c, 0x22, 0x22, 0x3c, 0x22, 0x22, 0x7c, 0x00, // 02
+  0x1c, 0x22, 0x40, 0x40, 0x40, 0x22, 0x1c, 0x00, // 03
+  0x78, 0x24, 0x22, 0x22, 0x22, 0x24, 0x78, 0x00, // 04
+  0x7e, 0x40, 0x40, 0x78, 0x40, 0x40, 0x7e, 0x00, // 05
+  0x7e, 0x40, 0x40, 0x78, 0x40, 0x40, 0x40, 0x00, // 06
+  0x1c, 0x22, 0x40, 0x4e, 0x42, 0x22, 0x1c, 0x00, // 07
+  0x42, 0x42, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x00, // 08
+  0x1c, 0x08, 0x08, 0x08, 0x08, 0x08, 0x1c, 0x00, // 09
+  0x0e, 0x04, 0x04, 0x04, 0x04, 0x44, 0x38, 0x00, // 0A
+  0x42, 0x44, 0x48, 0x70, 0x48, 0x44, 0x42, 0x00, // 0B
+  0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7e, 0x00, // 0C
+  0x42, 0x66, 0x5a, 0x5a, 0x42, 0x42, 0x42, 0x00, // 0D
+  0x42, 0x62, 0x52, 0x4a, 0x46, 0x42, 0x42, 0x00, // 0E
+  0x18, 0x24, 0x42, 0x42, 0x42, 0x24, 0x18, 0x00, // 0F
+  0x7c, 0x42, 0x42, 0x7c, 0x40, 0x40, 0x40, 0x00, // 10
+  0x18, 0x24, 0x42, 0x42, 0x4a, 0x24, 0x1a, 0x00, // 11
+  0x7c, 0x42, 0x42, 0x7c, 0x48, 0x44, 0x42, 0x00, // 12
+  0x3c, 0x42, 0x40, 0x3c, 0x02, 0x42, 0x3c, 0x00, // 13
+  0x3e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, // 14
+  0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3c, 0x00, // 15
+  0x42, 0x42, 0x42, 0x24, 0x24, 0x18, 0x18, 0x00, // 16
+  0x42, 0x42, 0x42, 0x5a, 0x5a, 0x66, 0x42, 0x00, // 17
+  0x42, 0x42, 0x24, 0x18, 0x24, 0x42, 0x42, 0x00, // 18
+  0x22, 0x22, 0x22, 0x1c, 0x08, 0x08, 0x08, 0x00, // 19
+  0x7e, 0x02, 0x04, 0x18, 0x20, 0x40, 0x7e, 0x00, // 1A
+  0x3c, 0x20, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x00, // 1B
+  0x00, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x00, // 1C
+  0x3c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x3c, 0x00, // 1D
+  0x00, 0x08, 0x1c, 0x2a, 0x08, 0x08, 0x08, 0x08, // 1E
+  0x00, 0x00, 0x10, 0x20, 0x7f, 0x20, 0x10, 0x00, // 1F
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 20
+  0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x08, 0x00, // 21
+  0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, // 22
+  0x24, 0x24, 0x7e, 0x24, 0x7e, 0x24, 0x24, 0x00, // 23
+  0x08, 0x1e, 0x28, 0x1c, 0x0a, 0x3c, 0x08, 0x00, // 24
+  0x00, 0x62, 0x64, 0x08, 0x10, 0x26, 0x46, 0x00, // 25
+  0x30, 0x48, 0x48, 0x30, 0x4a, 0x44, 0x3a, 0x00, // 26
+  0x04, 0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, // 27
+  0x04, 0x08, 0x10, 0x10, 0x10, 0x08, 0x04, 0x00, // 28
+  0x20, 0x10, 0x08, 0x08, 0x08, 0x10, 0x20, 0x00, // 29
+  0x08, 0x2a, 0x1c, 0x3e, 0x1c, 0x2a, 0x08, 0x00, // 2A
+  0x00, 0x08, 0x08, 0x3e, 0x08, 0x08, 0x00, 0x00, // 2B
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x10, // 2C
+  0x00, 0x00, 0x00, 0x7e, 0x00, 0x00, 0x00, 0x00, // 2D
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, // 2E
+  0x00, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, // 2F
+  0x3c, 0x42, 0x46, 0x5a, 0x62, 0x42, 0x3c, 0x00, // 30
+  0x08, 0x18, 0x28, 0x08, 0x08, 0x08, 0x3e, 0x00, // 31
+  0x3c, 0x42, 0x02, 0x0c, 0x30, 0x40, 0x7e, 0x00, // 32
+  0x3c, 0x42, 0x02, 0x1c, 0x02, 0x42, 0x3c, 0x00, // 33
+  0x04, 0x0c, 0x14, 0x24, 0x7e, 0x04, 0x04, 0x00, // 34
+  0x7e, 0x40, 0x78, 0x04, 0x02, 0x44, 0x38, 0x00, // 35
+  0x1c, 0x20, 0x40, 0x7c, 0x42, 0x42, 0x3c, 0x00, // 36
+  0x7e, 0x42, 0x04, 0x08, 0x10, 0x10, 0x10, 0x00, // 37
+  0x3c, 0x42, 0x42, 0x3c, 0x42, 0x42, 0x3c, 0x00, // 38
+  0x3c, 0x42, 0x42, 0x3e, 0x02, 0x04, 0x38, 0x00, // 39
+  0x00, 0x00, 0x08, 0x00, 0x00, 0x08, 0x00, 0x00, // 3A
+  0x00, 0x00, 0x08, 0x00, 0x00, 0x08, 0x08, 0x10, // 3B
+  0x0e, 0x18, 0x30, 0x60, 0x30, 0x18, 0x0e, 0x00, // 3C
+  0x00, 0x00, 0x7e, 0x00, 0x7e, 0x00, 0x00, 0x00, // 3D
+  0x70, 0x18, 0x0c, 0x06, 0x0c, 0x18, 0x70, 0x00, // 3E
+  0x3c, 0x42, 0x02, 0x0c, 0x10, 0x00, 0x10, 0x00, // 3F
+  0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, // 40
+  0x08, 0x1c, 0x3e, 0x7f, 0x7f, 0x1c, 0x3e, 0x00, // 41
+  0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, // 42
+  0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0x00, // 43
+  0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, // 44
+  0x00, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 45
+  0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, // 46
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, // 47
+  0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, // 48
+  0x00, 0x00, 0x00, 0x00, 0xe0, 0x10, 0x08, 0x08, // 49
+  0x08, 0x08, 0x08, 0x04, 0x03, 0x00, 0x00, 0x00, // 4A
+  0x08, 0x08, 0x08, 0x10, 0xe0, 0x00, 0x00, 0x00, // 4B
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0xff, // 4C
+  0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, // 4D
+  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, // 4E
+  0xff, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, // 4F
+  0xff, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, // 50
+  0x00, 0x3c, 0x7e, 0x7e, 0x7e, 0x7e, 0x3c, 0x00, // 51
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, // 52
+  0x36, 0x7f, 0x7f, 0x7f, 0x3e, 0x1c, 0x08, 0x00, // 53
+  0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, // 54
+  0x00, 0x00, 0x00, 0x00, 0x03, 0x04, 0x08, 0x08, // 55
+  0x81, 0x42, 0x24, 0x18, 0x18, 0x24, 0x42, 0x81, // 56
+  0x00, 0x3c, 0x42, 0x42, 0x42, 0x42, 0x3c, 0x00, // 57
+  0x08, 0x1c, 0x2a, 0x77, 0x2a, 0x08, 0x08, 0x00, // 58
+  0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, // 59
+  0x08, 0x1c, 0x3e, 0x7f, 0x3e, 0x1c, 0x08, 0x00, // 5A
+  0x08, 0x08, 0x08, 0x08, 0xff, 0x08, 0x08, 0x08, // 5B
+  0xa0, 0x50, 0xa0, 0x50, 0xa0, 0x50, 0xa0, 0x50, // 5C
+  0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, // 5D
+  0x00, 0x00, 0x01, 0x3e, 0x54, 0x14, 0x14, 0x00, // 5E
+  0xff, 0x7f, 0x3f, 0x1f, 0x0f, 0x07, 0x03, 0x01, // 5F
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 60
+  0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, // 61
+  0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, // 62
+  0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 63
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, // 64
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, // 65
+  0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, // 66
+  0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, // 67
+  0x00, 0x00, 0x00, 0x00, 0xaa, 0x55, 0xaa, 0x55, // 68
+  0xff, 0xfe, 0xfc, 0xf8, 0xf0, 0xe0, 0xc0, 0x80, // 69
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, // 6A
+  0x08, 0x08, 0x08, 0x08, 0x0f, 0x08, 0x08, 0x08, // 6B
+  0x00, 0x00, 0x00, 0x00, 0x0f, 0x0f, 0x0f, 0x0f, // 6C
+  0x08, 0x08, 0x08, 0x08, 0x0f, 0x00, 0x00, 0x00, // 6D
+  0x00, 0x00, 0x00, 0x00, 0xf8, 0x08, 0x08, 0x08, // 6E
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, // 6F
+  0x00, 0x00, 0x00, 0x00, 0x0f, 0x08, 0x08, 0x08, // 70
+  0x08, 0x08, 0x08, 0x08, 0xff, 0x00, 0x00, 0x00, // 71
+  0x00, 0x00, 0x00, 0x00, 0xff, 0x08, 0x08, 0x08, // 72
+  0x08, 0x08, 0x08, 0x08, 0xf8, 0x08, 0x08, 0x08, // 73
+  0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, // 74
+  0xe0, 0xe0, 0xe0, 0xe0, 0xe0, 0xe0, 0xe0, 0xe0, // 75
+  0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, // 76
+  0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 77
+  0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, // 78
+  0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, // 79
+  0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xff, // 7A
+  0x00, 0x00, 0x00, 0x00, 0xf0, 0xf0, 0xf0, 0xf0, // 7B
+  0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x00, 0x00, 0x00, // 7C
+  0x08, 0x08, 0x08, 0x08, 0xf8, 0x00, 0x00, 0x00, // 7D
+  0xf0, 0xf0, 0xf0, 0xf0, 0x00, 0x00, 0x00, 0x00, // 7E
+  0xf0, 0xf0, 0xf0, 0xf0, 0x0f, 0x0f, 0x0f, 0x0f, // 7F
+  // text set
+  0x3c, 0x42, 0x44, 0x48, 0x44, 0x42, 0x44, 0x08, // 80
+  0x00, 0x00, 0x38, 0x04, 0x3c, 0x44, 0x3a, 0x00, // 81
+  0x40, 0x40, 0x5c, 0x62, 0x42, 0x62, 0x5c, 0x00, // 82
+  0x00, 0x00, 0x3c, 0x42, 0x40, 0x42, 0x3c, 0x00, // 83
+  0x02, 0x02, 0x3a, 0x46, 0x42, 0x46, 0x3a, 0x00, // 84
+  0x00, 0x00, 0x3c, 0x42, 0x7e, 0x40, 0x3c, 0x00, // 85
+  0x0c, 0x12, 0x10, 0x7c, 0x10, 0x10, 0x10, 0x00, // 86
+  0x00, 0x00, 0x3a, 0x46, 0x46, 0x3a, 0x02, 0x3c, // 87
+  0x40, 0x40, 0x5c, 0x62, 0x42, 0x42, 0x42, 0x00, // 88
+  0x08, 0x00, 0x18, 0x08, 0x08, 0x08, 0x1c, 0x00, // 89
+  0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x44, 0x38, // 8A
+  0x40, 0x40, 0x44, 0x48, 0x50, 0x68, 0x44, 0x00, // 8B
+  0x18, 0x08, 0x08, 0x08, 0x08, 0x08, 0x1c, 0x00, // 8C
+  0x00, 0x00, 0x76, 0x49, 0x49, 0x49, 0x49, 0x00, // 8D
+  0x00, 0x00, 0x5c, 0x62, 0x42, 0x42, 0x42, 0x00, // 8E
+  0x00, 0x00, 0x3c, 0x42, 0x42, 0x42, 0x3c, 0x00, // 8F
+  0x00, 0x00, 0x5c, 0x62, 0x62, 0x5c, 0x40, 0x40, // 90
+  0x00, 0x00, 0x3a, 0x46, 0x46, 0x3a, 0x02, 0x02, // 91
+  0x00, 0x00, 0x5c, 0x62, 0x40, 0x40, 0x40, 0x00, // 92
+  0x00, 0x00, 0x3e, 0x40, 0x3c, 0x02, 0x7c, 0x00, // 93
+  0x10, 0x10, 0x7c, 0x10, 0x10, 0x12, 0x0c, 0x00, // 94
+  0x00, 0x00, 0x42, 0x42, 0x42, 0x46, 0x3a, 0x00, // 95
+  0x00, 0x00, 0x42, 0x42, 0x42, 0x24, 0x18, 0x00, // 96
+  0x00, 0x00, 0x41, 0x49, 0x49, 0x49, 0x36, 0x00, // 97
+  0x00, 0x00, 0x42, 0x24, 0x18, 0x24, 0x42, 0x00, // 98
+  0x00, 0x00, 0x42, 0x42, 0x46, 0x3a, 0x02, 0x3c, // 99
+  0x00, 0x00, 0x7e, 0x04, 0x18, 0x20, 0x7e, 0x00, // 9A
+  0x24, 0x00, 0x42, 0x42, 0x42, 0x46, 0x3a, 0x00, // 9B
+  0x24, 0x00, 0x3c, 0x42, 0x42, 0x42, 0x3c, 0x00, // 9C
+  0x24, 0x00, 0x3c, 0x02, 0x3e, 0x42, 0x3d, 0x00, // 9D
+  0x00, 0x00, 0x44, 0x44, 0x44, 0x64, 0x5a, 0x40, // 9E
+  0x30, 0x48, 0x48, 0x30, 0x00, 0x00, 0x00, 0x00, // 9F
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // A0
+  0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x08, 0x00, // A1
+  0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, // A2
+  0x1c, 0x32, 0x68, 0x54, 0x2a, 0x16, 0x4c, 0x38, // A3
+  0x08, 0x1e, 0x28, 0x1c, 0x0a, 0x3c, 0x08, 0x00, // A4
+  0x00, 0x62, 0x64, 0x08, 0x10, 0x26, 0x46, 0x00, // A5
+  0x30, 0x48, 0x48, 0x30, 0x4a, 0x44, 0x3a, 0x00, // A6
+  0x04, 0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, // A7
+  0x04, 0x08, 0x10, 0x10, 0x10, 0x08, 0x04, 0x00, // A8
+  0x20, 0x10, 0x08, 0x08, 0x08, 0x10, 0x20, 0x00, // A9
+  0x08, 0x2a, 0x1c, 0x3e, 0x1c, 0x2a, 0x08, 0x00, // AA
+  0x00, 0x08, 0x08, 0x3e, 0x08, 0x08, 0x00, 0x00, // AB
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x10, // AC
+  0x00, 0x00, 0x00, 0x7e, 0x00, 0x00, 0x00, 0x00, // AD
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, // AE
+  0x00, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, // AF
+  0x3c, 0x42, 0x46, 0x5a, 0x62, 0x42, 0x3c, 0x00, // B0
+  0x08, 0x18, 0x28, 0x08, 0x08, 0x08, 0x3e, 0x00, // B1
+  0x3c, 0x42, 0x02, 0x0c, 0x30, 0x40, 0x7e, 0x00, // B2
+  0x3c, 0x42, 0x02, 0x1c, 0x02, 0x42, 0x3c, 0x00, // B3
+  0x04, 0x0c, 0x14, 0x24, 0x7e, 0x04, 0x04, 0x00, // B4
+  0x7e, 0x40, 0x78, 0x04, 0x02, 0x44, 0x38, 0x00, // B5
+  0x1c, 0x20, 0x40, 0x7c, 0x42, 0x42, 0x3c, 0x00, // B6
+  0x7e, 0x42, 0x04, 0x08, 0x10, 0x10, 0x10, 0x00, // B7
+  0x3c, 0x42, 0x42, 0x3c, 0x42, 0x42, 0x3c, 0x00, // B8
+  0x3c, 0x42, 0x42, 0x3e, 0x02, 0x04, 0x38, 0x00, // B9
+  0x00, 0x00, 0x08, 0x00, 0x00, 0x08, 0x00, 0x00, // BA
+  0x00, 0x00, 0x08, 0x00, 0x00, 0x08, 0x08, 0x10, // BB
+  0x70, 0x10, 0x70, 0x40, 0x70, 0x00, 0x00, 0x00, // BC
+  0x00, 0x00, 0x7e, 0x00, 0x7e, 0x00, 0x00, 0x00, // BD
+  0x70, 0x10, 0x30, 0x10, 0x70, 0x00, 0x00, 0x00, // BE
+  0x3c, 0x42, 0x02, 0x0c, 0x10, 0x00, 0x10, 0x00, // BF
+  0x20, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, // C0
+  0x18, 0x24, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x00, // C1
+  0x7c, 0x22, 0x22, 0x3c, 0x22, 0x22, 0x7c, 0x00, // C2
+  0x1c, 0x22, 0x40, 0x40, 0x40, 0x22, 0x1c, 0x00, // C3
+  0x78, 0x24, 0x22, 0x22, 0x22, 0x24, 0x78, 0x00, // C4
+  0x7e, 0x40, 0x40, 0x78, 0x40, 0x40, 0x7e, 0x00, // C5
+  0x7e, 0x40, 0x40, 0x78, 0x40, 0x40, 0x40, 0x00, // C6
+  0x1c, 0x22, 0x40, 0x4e, 0x42, 0x22, 0x1c, 0x00, // C7
+  0x42, 0x42, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x00, // C8
+  0x1c, 0x08, 0x08, 0x08, 0x08, 0x08, 0x1c, 0x00, // C9
+  0x0e, 0x04, 0x04, 0x04, 0x04, 0x44, 0x38, 0x00, // CA
+  0x42, 0x44, 0x48, 0x70, 0x48, 0x44, 0x42, 0x00, // CB
+  0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7e, 0x00, // CC
+  0x42, 0x66, 0x5a, 0x5a, 0x42, 0x42, 0x42, 0x00, // CD
+  0x42, 0x62, 0x52, 0x4a, 0x46, 0x42, 0x42, 0x00, // CE
+  0x18, 0x24, 0x42, 0x42, 0x42, 0x24, 0x18, 0x00, // CF
+  0x7c, 0x42, 0x42, 0x7c, 0x40, 0x40, 0x40, 0x00, // D0
+  0x18, 0x24, 0x42, 0x42, 0x4a, 0x24, 0x1a, 0x00, // D1
+  0x7c, 0x42, 0x42, 0x7c, 0x48, 0x44, 0x42, 0x00, // D2
+  0x3c, 0x42, 0x40, 0x3c, 0x02, 0x42, 0x3c, 0x00, // D3
+  0x3e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, // D4
+  0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3c, 0x00, // D5
+  0x42, 0x42, 0x42, 0x24, 0x24, 0x18, 0x18, 0x00, // D6
+  0x42, 0x42, 0x42, 0x5a, 0x5a, 0x66, 0x42, 0x00, // D7
+  0x42, 0x42, 0x24, 0x18, 0x24, 0x42, 0x42, 0x00, // D8
+  0x22, 0x22, 0x22, 0x1c, 0x08, 0x08, 0x08, 0x00, // D9
+  0x7e, 0x02, 0x04, 0x18, 0x20, 0x40, 0x7e, 0x00, // DA
+  0x5a, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3c, 0x00, // DB
+  0x5a, 0x24, 0x42, 0x42, 0x42, 0x24, 0x18, 0x00, // DC
+  0x5a, 0x24, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x00, // DD
+  0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, // DE
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, // DF
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // E0
+  0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, // E1
+  0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, // E2
+  0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // E3
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, // E4
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, // E5
+  0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, // E6
+  0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, // E7
+  0x00, 0x00, 0x00, 0x00, 0xaa, 0x55, 0xaa, 0x55, // E8
+  0x99, 0x33, 0x66, 0xcc, 0x99, 0x33, 0x66, 0xcc, // E9
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, // EA
+  0x08, 0x08, 0x08, 0x08, 0x0f, 0x08, 0x08, 0x08, // EB
+  0x00, 0x00, 0x00, 0x00, 0x0f, 0x0f, 0x0f, 0x0f, // EC
+  0x08, 0x08, 0x08, 0x08, 0x0f, 0x00, 0x00, 0x00, // ED
+  0x00, 0x00, 0x00, 0x00, 0xf8, 0x08, 0x08, 0x08, // EE
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, // EF
+  0x00, 0x00, 0x00, 0x00, 0x0f, 0x08, 0x08, 0x08, // F0
+  0x08, 0x08, 0x08, 0x08, 0xff, 0x00, 0x00, 0x00, // F1
+  0x00, 0x00, 0x00, 0x00, 0xff, 0x08, 0x08, 0x08, // F2
+  0x08, 0x08, 0x08, 0x08, 0xf8, 0x08, 0x08, 0x08, // F3
+  0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, // F4
+  0xe0, 0xe0, 0xe0, 0xe0, 0xe0, 0xe0, 0xe0, 0xe0, // F5
+  0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, // F6
+  0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // F7
+  0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, // F8
+  0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, // F9
+  0x01, 0x02, 0x44, 0x48, 0x50, 0x60, 0x40, 0x00, // FA
+  0x00, 0x00, 0x00, 0x00, 0xf0, 0xf0, 0xf0, 0xf0, // FB
+  0x0f, 0x0f, 0x0f, 0x0f, 0x00, 0x00, 0x00, 0x00, // FC
+  0x08, 0x08, 0x08, 0x08, 0xf8, 0x00, 0x00, 0x00, // FD
+  0xf0, 0xf0, 0xf0, 0xf0, 0x00, 0x00, 0x00, 0x00, // FE
+  0xf0, 0xf0, 0xf0, 0xf0, 0x0f, 0x0f, 0x0f, 0x0f, // FF
+};
@@ -1,231 +1,372 @@
+// displaytest benchmarks render strategies over screen sequences
+//
+// usage: displaytest [session file ...]
+//
+// Strategies:
+//   full     clear and draw all 2000 glyphs each frame
+//   dirty    draw only the cells that changed, on a preserved surface
+//   rows     redraw the rows that changed, one matrix setup per row
+//   scroll   like dirty, but a detected scroll moves the frame content
+//            with vgCopyPixels and only the new rows are drawn
+//   blit     copy changed cells from the software glyph atlas into a
+//            frame in CPU memory and write the changed rows with vgWritePixels
+//
+// Sequences are synthetic ones with different change densities plus the
+// recorded sessions given on the command line (see session.h).
+//
+// The frame time against the number of tiles (see tiles.h) is measured
+// with full-xN and dirty-xN: N tiles in the layout serial2hdmi picks for
+// N devices, each tile playing the sequence from a different point.
+// full-xN clears and draws every tile, dirty-xN draws the changed cells of
+// the tiles whose screen changed.
+//
+// The output is CSV on stdout, one line per sequence and strategy, so runs
+// on different boards can be compared:
+//   board,sequence,strategy,frames,fps,p50_ms,p99_ms,max_ms,cpu_ms_per_frame,cells_per_frame
+// Frame times include eglSwapBuffers, so they are bound by the display
+// refresh once rendering is fast enough; cpu_ms_per_frame isn't.
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <fcntl.h>
+#include <time.h>
 #include "VG/openvg.h"
 #include "VG/vgu.h"
 #include "graphics.h"
+#include "glyphs.h"
+#include "session.h"
+#include "tiles.h"
 
-#define SCREENW 1280
-#define SCREENH 720
-
-#define PET_GLYPH_WIDTH  16
-#define PET_GLYPH_HEIGHT 24
-#define PET_IMAGE_WIDTH  (16 * PET_GLYPH_WIDTH)
-#define PET_IMAGE_HEIGHT (16 * PET_GLYPH_HEIGHT)
+#define MAX_FRAMES 3000
+#define FRAMES      600 // per synthetic sequence
 
-// #define IMAGE_QUALITY VG_IMAGE_QUALITY_BETTER
-#define IMAGE_QUALITY VG_IMAGE_QUALITY_NONANTIALIASED
-// #define PIXEL_FORMAT VG_sXBGR_8888
-#define PIXEL_FORMAT VG_sRGB_565
+#define SOFT_FRAME_WIDTH  (80 * SOFT_GLYPH_WIDTH)
+#define SOFT_FRAME_HEIGHT (25 * SOFT_GLYPH_HEIGHT)
 
+static unsigned char screens[MAX_FRAMES][SCREEN_SIZE];
+static unsigned char graphics[MAX_FRAMES];
+static unsigned frameCount;
+static unsigned char currentGraphic;
 
-// PETSCII image contains glyphs in ROM index order
-extern unsigned char petSciiImageData[(PET_IMAGE_WIDTH / 8) * PET_IMAGE_HEIGHT];
+static double frameTimes[MAX_FRAMES];
 
-// uint32_t rgb_data[PET_IMAGE_WIDTH*PET_IMAGE_HEIGHT];
-uint16_t rgb_data[PET_IMAGE_WIDTH*PET_IMAGE_HEIGHT];
+static int screenW, screenH;
+static VGPaint paint;
 
-VGImage petSciiImage;
+//----------------------------------------------------------------------------------------
+// synthetic sequences
 
-void makePetSciiImage() {
-  unsigned int dstride = PET_IMAGE_WIDTH / 8;
-  VGImage imgTemp = vgCreateImage(PIXEL_FORMAT, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, IMAGE_QUALITY);
-  vgImageSubData(imgTemp, petSciiImageData, dstride, VG_BW_1, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT);
-  petSciiImage = vgCreateImage(PIXEL_FORMAT, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, IMAGE_QUALITY);
-  vgCopyImage(petSciiImage, 0, 0, imgTemp, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, VG_FALSE);
-  vgDestroyImage(imgTemp);
+static unsigned random_state = 1;
 
-  // set green color
-  // vgGetImageSubData(petSciiImage, &rgb_data, PET_IMAGE_WIDTH * sizeof(uint32_t), PIXEL_FORMAT, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT);
-  // for (unsigned i = 0; i < PET_IMAGE_WIDTH * PET_IMAGE_HEIGHT * 3; i++) {
-  //   if (rgb_data[i*3] != 0x00) {
-  //     rgb_data[i*3] = 0xFF40E030; // XBGR
-  //   }
-  // }
-  // vgImageSubData(petSciiImage, &rgb_data, PET_IMAGE_WIDTH * sizeof(uint32_t), PIXEL_FORMAT, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT);
+static unsigned nextRandom() {
+  random_state = random_state * 1103515245 + 12345;
+  return (random_state >> 16) & 0x7FFF;
+}
 
+// makeListing fills FRAMES screens of a program listing that scrolls up
+// by one line per frame, two every fourth frame, like LIST on the PET
+static void makeListing() {
+  unsigned char line[80];
+  unsigned lineNumber = 10;
+  memset(screens[0], ' ', SCREEN_SIZE);
+  graphics[0] = 1;
+  for (frameCount = 1; frameCount < FRAMES; frameCount++) {
+    unsigned scroll = frameCount % 4 == 0 ? 2 : 1;
+    memcpy(screens[frameCount], screens[frameCount - 1], SCREEN_SIZE);
+    screen_shift_rows(screens[frameCount], scroll, screens[frameCount]);
+    for (unsigned row = 25 - scroll; row < 25; row++) {
+      char text[81];
+      memset(line, ' ', 80);
+      int length = snprintf(text, sizeof(text), "%u PRINT \"LINE %u\";X%u:GOTO %u",
+        lineNumber, lineNumber, lineNumber % 7, lineNumber + 10);
+      for (int i = 0; i < length && i < 80; i++) {
+        // screen codes: letters are 1..26, digits and punctuation as ASCII
+        line[i] = (text[i] >= 'A' && text[i] <= 'Z') ? text[i] - 'A' + 1 : text[i];
+      }
+      memcpy(screens[frameCount] + row * 80, line, 80);
+      lineNumber += 10;
+    }
+    graphics[frameCount] = 1;
+  }
+}
 
-  vgGetImageSubData(petSciiImage, &rgb_data, PET_IMAGE_WIDTH * sizeof(uint16_t), PIXEL_FORMAT, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT);
-  for (unsigned i = 0; i < PET_IMAGE_WIDTH * PET_IMAGE_HEIGHT; i++) {
-    if (rgb_data[i] != 0x0000) {
-      rgb_data[i] = 0x4706;
+// makeSequence fills FRAMES screens, changing the given number of random
+// cells per frame, or only toggling the cursor every 20 frames
+static void makeSequence(unsigned cells, unsigned cursorOnly) {
+  random_state = 1;
+  for (unsigned i = 0; i < SCREEN_SIZE; i++) {
+    screens[0][i] = (unsigned char)(nextRandom() % 64);
+  }
+  graphics[0] = 1;
+  for (frameCount = 1; frameCount < FRAMES; frameCount++) {
+    memcpy(screens[frameCount], screens[frameCount - 1], SCREEN_SIZE);
+    graphics[frameCount] = 1;
+    if (cursorOnly) {
+      if (frameCount % 20 == 0) {
+        screens[frameCount][12 * 80 + 40] ^= 0x80;
+      }
+    } else if (cells == SCREEN_SIZE) {
+      for (unsigned i = 0; i < SCREEN_SIZE; i++) {
+        screens[frameCount][i] = (unsigned char)((screens[frameCount][i] + 1) & 0x7F);
+      }
+    } else {
+      for (unsigned i = 0; i < cells; i++) {
+        screens[frameCount][nextRandom() % SCREEN_SIZE] = (unsigned char)(nextRandom() % 256);
+      }
     }
   }
-  vgImageSubData(petSciiImage, &rgb_data, PET_IMAGE_WIDTH * sizeof(uint16_t), PIXEL_FORMAT, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT);
 }
 
-void destroyPetSciiImage() {
-  vgDestroyImage(petSciiImage);
+//----------------------------------------------------------------------------------------
+// strategies, each draws one frame and returns the number of cells drawn
+
+static void beginFrame(int clear) {
+  if (clear) {
+    Start(screenW, screenH);
+    Background(0, 0, 0);
+  } else {
+    Continue();
+  }
+  vgSetPaint(paint, VG_FILL_PATH);
+  vgSeti(VG_IMAGE_MODE, VG_DRAW_IMAGE_MULTIPLY);
+}
+
+static unsigned drawFull(const unsigned char* screen, const unsigned char* previous, int first) {
+  beginFrame(1);
+  drawGlyphs(screen, screenW, screenH, 1.0f, 1.0f);
+  End();
+  return SCREEN_SIZE;
 }
 
-VGImage glyphs[256];
+static unsigned drawDirty(const unsigned char* screen, const unsigned char* previous, int first) {
+  if (first) {
+    return drawFull(screen, previous, first);
+  }
+  beginFrame(0);
+  unsigned cells = drawDirtyGlyphs(screen, previous, screenW, screenH, 1.0f, 1.0f);
+  End();
+  return cells;
+}
 
-void prepareGlyphs() {
-  for (unsigned int glyphRow = 0; glyphRow < 16; glyphRow++) {
-    for (unsigned int glyphCol = 0; glyphCol < 16; glyphCol++) {
-      unsigned int index = glyphRow * 16 + glyphCol;
-      VGint x = glyphCol * PET_GLYPH_WIDTH;
-      VGint y = PET_IMAGE_HEIGHT - ((glyphRow + 1) * PET_GLYPH_HEIGHT);
-      glyphs[index] = vgChildImage(petSciiImage, x, y, PET_GLYPH_WIDTH, PET_GLYPH_HEIGHT);
+static unsigned drawRows(const unsigned char* screen, const unsigned char* previous, int first) {
+  if (first) {
+    return drawFull(screen, previous, first);
+  }
+  beginFrame(0);
+  unsigned rows = drawGlyphRows(screen, previous, screenW, screenH, 1.0f, 1.0f);
+  End();
+  return rows * 80;
+}
+
+// the software frame is bottom-up like OpenVG surfaces
+static uint32_t softFrame[SOFT_FRAME_HEIGHT * SOFT_FRAME_WIDTH];
+
+static unsigned drawBlit(const unsigned char* screen, const unsigned char* previous, int first) {
+  uint32_t* topRow = softFrame + (SOFT_FRAME_HEIGHT - 1) * SOFT_FRAME_WIDTH;
+  unsigned bank = GLYPH_BANK(currentGraphic);
+  unsigned cells = 0;
+  int firstRow = 25;
+  int lastRow = -1;
+
+  for (int index = 0; index < SCREEN_SIZE; index++) {
+    if (first || screen[index] != previous[index]) {
+      int row = index / 80;
+      soft_glyphs_draw_cell(topRow, -SOFT_FRAME_WIDTH, row, index % 80, bank, screen[index]);
+      if (row < firstRow) firstRow = row;
+      if (row > lastRow) lastRow = row;
+      cells++;
     }
   }
+
+  beginFrame(first);
+  if (lastRow >= 0) {
+    int bottom = SOFT_FRAME_HEIGHT - (lastRow + 1) * SOFT_GLYPH_HEIGHT;
+    int height = (lastRow - firstRow + 1) * SOFT_GLYPH_HEIGHT;
+    vgWritePixels(softFrame + bottom * SOFT_FRAME_WIDTH, SOFT_FRAME_WIDTH * sizeof(uint32_t), VG_sXBGR_8888,
+      (screenW - SOFT_FRAME_WIDTH) / 2, (screenH - SOFT_FRAME_HEIGHT) / 2 + bottom,
+      SOFT_FRAME_WIDTH, height);
+  }
+  End();
+  return cells;
 }
 
-void destroyGlyphs()
-{
-  for (unsigned int index = 0; index < 256; index++) {
-    vgDestroyImage(glyphs[index]);
-  }
-}
-
-static unsigned char petsciiToRomIndex[256] = {
-//  0    1    2    3    4    5    6    7    8    9    A    B    C    D    E    F
-   32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32, // 00 .. 0F
-   32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32, // 10 .. 1F
-   32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47, // 20 .. 2F
-   48,  49,  50,  51,  52,  53,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63, // 30 .. 3F
-    0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15, // 40 .. 4F
-   16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31, // 50 .. 5F
-   64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79, // 60 .. 6F
-   80,  81,  82,  83,  84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95, // 70 .. 7F
-   32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32, // 80 .. 8F
-   32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32,  32, // 90 .. 9F
-   96,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, // A0 .. AF
-  112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127, // B0 .. BF
-   64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79, // C0 .. CF
-   80,  81,  82,  83,  84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95, // D0 .. DF
-   96,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, // E0 .. EF
-  112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127, // F0 .. FF
+static unsigned drawScroll(const unsigned char* screen, const unsigned char* previous, int first) {
+  if (first) {
+    return drawFull(screen, previous, first);
+  }
+  int scroll = screen_detect_scroll(previous, screen);
+  beginFrame(0);
+  unsigned cells = scroll != 0
+    ? drawScrolledGlyphs(screen, previous, scroll, screenW, screenH, 1.0f, 1.0f)
+    : drawDirtyGlyphs(screen, previous, screenW, screenH, 1.0f, 1.0f);
+  End();
+  return cells;
+}
+
+typedef struct {
+  const char* name;
+  int preserve;
+  unsigned (*drawFrame)(const unsigned char* screen, const unsigned char* previous, int first);
+} t_strategy;
+
+static t_strategy strategies[] = {
+  { "full",   0, drawFull   },
+  { "dirty",  1, drawDirty  },
+  { "rows",   1, drawRows   },
+  { "blit",   1, drawBlit   },
+  { "scroll", 1, drawScroll },
 };
 
-// example screen encoded in PETSCII (unshifted)
-// see https://en.wikipedia.org/wiki/PETSCII
-static unsigned char exampleScreen[25 * 80 + 1] = "\
- 1       .         .         .         .         .         .         .         .\
- 2       .         .         .         .         .         .         .         .\
- 3       .         .         .         .         .         .         .         .\
- 4       .         .         . CBM8032 .         .         .         .         .\
- 5       .         .         .         .         .         .         .         .\
- 6       . ABCDEFG . HIJKLMN . OPQRSTU . VWXYZ   .         .         .         .\
- 7       .         .         .         .         .         .         .         .\
- 8       .         .         . 0123456 . 789     .         .         .         .\
- 9       .         .         .         .         .         .         .         .\
-10       . @[\\]!\"# . $%&'()* . +,-./:; . <=>?    .         .         .         .\
-11       .         .         .         .         .         .         .         .\
-12       .         .         .         .         .         .         .         .\
-13       .         .         .         .         .         .         .         .\
-14       .         .         .         .         .         .         .         .\
-15       .         .         .         .         .         .         .         .\
-16       .         .         .         .         .         .         .         .\
-17       .         .         .         .         .         .         .         .\
-18       .         . \xA6\xA6      .         .         .         .         .         .\
-19       .         . \xA6\xA6      .         .         .         .         .         .\
-20       .         .         .         .         .         .         .         .\
-21       .         .         .         .         .         .         .         .\
-22       .         .         .         .         .         .         .         .\
-23       .         .         .         .         .         .         .         .\
-24       .         .         .         .         .         .         .         .\
-25       .         .         .         .         .         .         .         .";
-
-static unsigned char screenContent[25 * 80]; // holds rom indices
-
-// uint32_t screenData[SCREENW*SCREENH];
-// VGImage screenImage;
-// VGImage screenImage0, screenImage1;
-
-void prepareImageTest()
-{
-  makePetSciiImage();
-  prepareGlyphs();
-  // screenImage = vgCreateImage(VG_sXBGR_8888, SCREENW, SCREENH, IMAGE_QUALITY);
-  // screenImage0 = vgCreateImage(VG_sXBGR_8888, SCREENW, SCREENH, IMAGE_QUALITY);
-  // screenImage1 = vgCreateImage(VG_sXBGR_8888, SCREENW, SCREENH, IMAGE_QUALITY);
-  // for (unsigned i = 0; i < SCREENW*SCREENH; i++) {
-  //   screenData[i] = 0xFF000000;
-  // }
-  // vgImageSubData(screenImage0, screenData, SCREENW * sizeof(uint32_t), VG_sXBGR_8888, 0, 0, SCREENW, SCREENH);
-  // for (unsigned i = 0; i < SCREENW*SCREENH; i++) {
-  //   screenData[i] = 0xFF40E030;
-  // }
-  // vgImageSubData(screenImage1, screenData, SCREENW * sizeof(uint32_t), VG_sXBGR_8888, 0, 0, SCREENW, SCREENH);
-}
-
-void finishImageTest()
-{
-  // vgDestroyImage(screenImage0);
-  // vgDestroyImage(screenImage1);
-  // vgDestroyImage(screenImage);
-  destroyGlyphs();
-  destroyPetSciiImage();
-}
-
-void imageTest(int screenW, int screenH, unsigned frame) {
-
-  for (unsigned int i = 0; i < 25 * 80; i++) {
-    exampleScreen[32] = (unsigned char)(' ' + (frame % 32));
-    screenContent[i] = petsciiToRomIndex[exampleScreen[i]];
-  }
-
-  Start(screenW, screenH);
-
-  // uint32_t color = (frame % 2 == 0) ? 0xFF000000 : 0xFF40E030;
-  // for (unsigned i = 0; i < SCREENW*SCREENH; i++) {
-  //   screenData[i] = color;
-  // }
-  // vgImageSubData(screenImage, screenData, SCREENW * sizeof(uint32_t), VG_sXBGR_8888, 0, 0, SCREENW, SCREENH);
-  // if (frame % 2 == 0) {
-  //   vgSetPixels(0, 0, screenImage0, 0, 0, SCREENW, SCREENH);
-  // } else {
-  //   vgSetPixels(0, 0, screenImage1, 0, 0, SCREENW, SCREENH);
-  // }
-  // vgSetPixels(0, 0, screenImage, 0, 0, SCREENW, SCREENH);
-  // if (frame % 2 == 0) {
-  //     Background(0, 0, 0);
-  // } else {
-  //     Background(255, 255, 255);
-  // }
-  Background(0, 0, 0);
-
-  vgSeti(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
-  vgSeti(VG_IMAGE_MODE, VG_DRAW_IMAGE_NORMAL);
-  vgSeti(VG_IMAGE_QUALITY, IMAGE_QUALITY); // antialiasing doesn't take extra time
-
-  // VGfloat scaleX = 24.0f / 16.0f;
-  // VGfloat scaleY = 36.0f / 24.0f;
-
-  for (int row = 0; row < 25; row++) {
-    for (int col = 0; col < 80; col++) {
-      int index = row * 80 + col;
-      unsigned char cbmCode = screenContent[index];
-      vgLoadIdentity();
-      // VGfloat dx = (VGfloat)screenW / 2.0f + scaleX * (VGfloat)(PET_GLYPH_WIDTH * (col - 40));
-      // VGfloat dy = (VGfloat)screenH / 2.0f + scaleY * (VGfloat)(PET_GLYPH_HEIGHT * (12 - row));
-      VGfloat dx = (VGfloat)SCREENW / 2.0f + (VGfloat)(PET_GLYPH_WIDTH * (col - 40));
-      VGfloat dy = (VGfloat)SCREENH / 2.0f + (VGfloat)(PET_GLYPH_HEIGHT * (12 - row));
-      vgTranslate(dx, dy);
-      // vgScale(scaleX, scaleY);
-      vgDrawImage(glyphs[cbmCode]);
+//----------------------------------------------------------------------------------------
+
+static double clockSeconds(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compareTimes(const void* a, const void* b) {
+  double da = *(const double*)a, db = *(const double*)b;
+  return da < db ? -1 : da > db ? 1 : 0;
+}
+
+static void printResult(const char* board, const char* sequence, const char* strategy,
+  double wall, double cpu, unsigned long cells) {
+  qsort(frameTimes, frameCount, sizeof(double), compareTimes);
+  printf("%s,%s,%s,%u,%.1f,%.3f,%.3f,%.3f,%.3f,%.1f\n",
+    board, sequence, strategy, frameCount, frameCount / wall,
+    1000.0 * frameTimes[frameCount / 2], 1000.0 * frameTimes[(frameCount * 99) / 100],
+    1000.0 * frameTimes[frameCount - 1], 1000.0 * cpu / frameCount,
+    (double)cells / frameCount);
+  fflush(stdout);
+}
+
+static void runStrategy(const char* board, const char* sequence, t_strategy* strategy) {
+  unsigned long cells = 0;
+
+  SwapBehavior(strategy->preserve);
+  double cpuStart = clockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+  double wallStart = clockSeconds(CLOCK_MONOTONIC);
+
+  for (unsigned frame = 0; frame < frameCount; frame++) {
+    double start = clockSeconds(CLOCK_MONOTONIC);
+    // a character set switch changes every cell
+    int first = selectGlyphBank(graphics[frame]) || frame == 0;
+    currentGraphic = graphics[frame];
+    cells += strategy->drawFrame(screens[frame], screens[frame == 0 ? 0 : frame - 1], first);
+    frameTimes[frame] = clockSeconds(CLOCK_MONOTONIC) - start;
+  }
+
+  double wall = clockSeconds(CLOCK_MONOTONIC) - wallStart;
+  double cpu = clockSeconds(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+  printResult(board, sequence, strategy->name, wall, cpu, cells);
+}
+
+// runTiled plays the sequence in count tiles, tile t starting at frame
+// t * frameCount / count
+static void runTiled(const char* board, const char* sequence, unsigned count, int dirty) {
+  t_tile_layout layout;
+  tile_layout(&layout, count, screenW, screenH);
+  unsigned long cells = 0;
+
+  SwapBehavior(dirty);
+  double cpuStart = clockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+  double wallStart = clockSeconds(CLOCK_MONOTONIC);
+
+  for (unsigned frame = 0; frame < frameCount; frame++) {
+    double start = clockSeconds(CLOCK_MONOTONIC);
+    beginFrame(!dirty || frame == 0);
+    for (unsigned tile = 0; tile < layout.count; tile++) {
+      unsigned index = (frame + tile * frameCount / layout.count) % frameCount;
+      unsigned previous = (index + frameCount - 1) % frameCount;
+      int x, y;
+      tile_origin(&layout, tile, screenH, &x, &y);
+      setGlyphOrigin(x, y);
+      selectGlyphBank(graphics[index]);
+      if (!dirty || frame == 0 || graphics[index] != graphics[previous]) {
+        drawGlyphs(screens[index], layout.tile_w, layout.tile_h, layout.scale, layout.scale);
+        cells += SCREEN_SIZE;
+      } else if (!screen_equal(screens[index], screens[previous])) {
+        cells += drawDirtyGlyphs(screens[index], screens[previous],
+          layout.tile_w, layout.tile_h, layout.scale, layout.scale);
+      }
     }
+    setGlyphOrigin(0, 0);
+    End();
+    frameTimes[frame] = clockSeconds(CLOCK_MONOTONIC) - start;
   }
 
-  End();
+  double wall = clockSeconds(CLOCK_MONOTONIC) - wallStart;
+  double cpu = clockSeconds(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+  char name[32];
+  snprintf(name, sizeof(name), "%s-x%u", dirty ? "dirty" : "full", count);
+  printResult(board, sequence, name, wall, cpu, cells);
+}
+
+static void runSequence(const char* board, const char* sequence) {
+  for (unsigned i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++) {
+    runStrategy(board, sequence, &strategies[i]);
+  }
+  for (unsigned count = 1; count <= MAX_TILES; count *= 2) {
+    runTiled(board, sequence, count, 0);
+    runTiled(board, sequence, count, 1);
+  }
+}
+
+// readBoard gets the board model from the device tree, commas removed for CSV
+static void readBoard(char* board, size_t size) {
+  strncpy(board, "unknown", size);
+  FILE* fp = fopen("/proc/device-tree/model", "r");
+  if (fp != NULL) {
+    if (fgets(board, size, fp) == NULL) {
+      strncpy(board, "unknown", size);
+    }
+    fclose(fp);
+  }
+  board[size - 1] = '\0';
+  for (char* c = board; *c != '\0'; c++) {
+    if (*c == ',' || *c == '\n') {
+      *c = ' ';
+    }
+  }
 }
 
-// main initializes the system and shows the picture.
-// Exit and clean up when you hit [RETURN].
 int main(int argc, char **argv) {
-  int w, h;
-  SaveTerm();
-  InitOpenVG(&w, &h);
-  RawTerm();
-  prepareImageTest(w, h);
-  for (unsigned i = 0; i < 600; i++) {
-    imageTest(w, h, i);
-  }
-  finishImageTest();
-  RestoreTerm();
+  char board[128];
+  readBoard(board, sizeof(board));
+
+  InitOpenVG(&screenW, &screenH);
+  prepareGlyphBanks();
+  soft_glyphs_init(0xFF40E030, 0xFF000000); // XBGR, same green as the paint
+  paint = vgCreatePaint();
+  VGfloat paintColor[4] = { 0.2f, 0.9f, 0.3f, 1.0f };
+  vgSetParameterfv(paint, VG_PAINT_COLOR, 4, paintColor);
+
+  printf("board,sequence,strategy,frames,fps,p50_ms,p99_ms,max_ms,cpu_ms_per_frame,cells_per_frame\n");
+
+  makeSequence(0, 0);
+  runSequence(board, "idle");
+  makeSequence(0, 1);
+  runSequence(board, "cursor");
+  makeSequence(20, 0);
+  runSequence(board, "typing-1%");
+  makeSequence(500, 0);
+  runSequence(board, "busy-25%");
+  makeSequence(SCREEN_SIZE, 0);
+  runSequence(board, "full-100%");
+  makeListing();
+  runSequence(board, "list");
+
+  for (int i = 1; i < argc; i++) {
+    frameCount = load_session(argv[i], screens, graphics, MAX_FRAMES);
+    if (frameCount > 0) {
+      runSequence(board, argv[i]);
+    }
+  }
+
+  vgDestroyPaint(paint);
+  destroyGlyphBanks();
   FinishOpenVG();
   return 0;
 }
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "events.h"
+
+#define RING_MAGIC "CBMEVT01"
+
+// events of one frame, the writer may be storing them before it
+// publishes the new count
+#define MAX_FRAME_EVENTS (SCREEN_SIZE + 1)
+
+static void shm_path(char* path, size_t size, const char* name)
+{
+  snprintf(path, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+void event_stream_open_fd(t_event_stream* stream, int fd)
+{
+  stream->fd = fd;
+  stream->ring = NULL;
+}
+
+// event_stream_open_ring creates the shared memory ring name with capacity
+// events (a power of two), returns 0 or -1
+int event_stream_open_ring(t_event_stream* stream, const char* name, uint32_t capacity)
+{
+  char path[256];
+  shm_path(path, sizeof(path), name);
+  stream->fd = -1;
+  stream->ring = NULL;
+  if ((capacity & (capacity - 1)) != 0 || capacity < 2 * MAX_FRAME_EVENTS)
+  {
+    fprintf(stderr, "event ring capacity must be a power of two of at least %u\n", 2 * MAX_FRAME_EVENTS);
+    return -1;
+  }
+  int fd = shm_open(path, O_CREAT | O_RDWR, 0644);
+  if (fd < 0)
+  {
+    perror(path);
+    return -1;
+  }
+  stream->ring_bytes = sizeof(t_event_ring) + capacity * sizeof(t_screen_event);
+  if (ftruncate(fd, stream->ring_bytes) < 0)
+  {
+    perror(path);
+    close(fd);
+    return -1;
+  }
+  void* ring = mmap(NULL, stream->ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED)
+  {
+    perror(path);
+    return -1;
+  }
+  stream->ring = ring;
+  stream->ring->capacity = capacity;
+  __atomic_store_n(&stream->ring->written, 0, __ATOMIC_RELAXED);
+  memcpy(stream->ring->magic, RING_MAGIC, 8); // last, readers check it first
+  return 0;
+}
+
+static int write_all(int fd, const void* data, size_t size)
+{
+  const unsigned char* p = data;
+  while (size > 0)
+  {
+    ssize_t written = write(fd, p, size);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return -1;
+    }
+    p += written;
+    size -= written;
+  }
+  return 0;
+}
+
+// event_stream_frame emits the changes from the old to the new screen,
+// returns the number of events or -1 if the pipe is closed
+int event_stream_frame(t_event_stream* stream, uint32_t frame,
+  const unsigned char* old_screen, const unsigned char* new_screen,
+  unsigned char old_graphic, unsigned char new_graphic)
+{
+  unsigned count = 0;
+  if (old_graphic != new_graphic)
+  {
+    t_screen_event* event = &stream->events[count++];
+    event->frame = frame;
+    event->row = EVENT_GRAPHIC;
+    event->col = EVENT_GRAPHIC;
+    event->old_code = old_graphic;
+    event->new_code = new_graphic;
+  }
+  unsigned changed = screen_diff(old_screen, new_screen, stream->positions);
+  for (unsigned i = 0; i < changed; i++)
+  {
+    unsigned position = stream->positions[i];
+    t_screen_event* event = &stream->events[count++];
+    event->frame = frame;
+    event->row = position / SCREEN_COLS;
+    event->col = position % SCREEN_COLS;
+    event->old_code = old_screen[position];
+    event->new_code = new_screen[position];
+  }
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  if (stream->ring != NULL)
+  {
+    t_event_ring* ring = stream->ring;
+    uint64_t written = ring->written;
+    // the previous count must be visible before any of the slots it frees are
+    // overwritten, readers rely on it to tell overwritten events
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (unsigned i = 0; i < count; i++)
+    {
+      ring->events[(written + i) & (ring->capacity - 1)] = stream->events[i];
+    }
+    __atomic_store_n(&ring->written, written + count, __ATOMIC_RELEASE);
+    return count;
+  }
+  if (write_all(stream->fd, stream->events, count * sizeof(t_screen_event)) < 0)
+  {
+    return -1;
+  }
+  return count;
+}
+
+void event_stream_close(t_event_stream* stream)
+{
+  if (stream->ring != NULL)
+  {
+    munmap(stream->ring, stream->ring_bytes);
+    stream->ring = NULL;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+// event_reader_open maps the ring name for reading from its current end
+int event_reader_open(t_event_reader* reader, const char* name)
+{
+  char path[256];
+  shm_path(path, sizeof(path), name);
+  reader->ring = NULL;
+  int fd = shm_open(path, O_RDONLY, 0);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0)
+  {
+    perror(path);
+    return -1;
+  }
+  void* ring = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED)
+  {
+    perror(path);
+    return -1;
+  }
+  reader->ring = ring;
+  reader->ring_bytes = st.st_size;
+  if ((size_t)st.st_size < sizeof(t_event_ring) || memcmp(reader->ring->magic, RING_MAGIC, 8) != 0 ||
+      sizeof(t_event_ring) + reader->ring->capacity * sizeof(t_screen_event) > (size_t)st.st_size)
+  {
+    fprintf(stderr, "%s: not an event ring\n", path);
+    event_reader_close(reader);
+    return -1;
+  }
+  reader->read = __atomic_load_n(&reader->ring->written, __ATOMIC_ACQUIRE);
+  return 0;
+}
+
+// event_ring_read copies up to max_events new events, oldest first, and
+// returns their number; lost is set to the number of events that were
+// overwritten before they could be read
+unsigned event_ring_read(t_event_reader* reader, t_screen_event* events, unsigned max_events, uint64_t* lost)
+{
+  const t_event_ring* ring = reader->ring;
+  uint64_t capacity = ring->capacity;
+  // events the writer may be overwriting right now are not safe to read
+  uint64_t safe = capacity - MAX_FRAME_EVENTS;
+  *lost = 0;
+
+  uint64_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+  if (written < reader->read)
+  {
+    reader->read = 0; // the writer started over
+  }
+  if (written - reader->read > safe)
+  {
+    *lost = written - safe - reader->read;
+    reader->read = written - safe;
+  }
+  unsigned count = written - reader->read < max_events ? written - reader->read : max_events;
+  for (unsigned i = 0; i < count; i++)
+  {
+    events[i] = ring->events[(reader->read + i) & (capacity - 1)];
+  }
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  uint64_t now = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+  if (now - reader->read > safe)
+  {
+    uint64_t overwritten = now - safe - reader->read;
+    if (overwritten >= count)
+    {
+      *lost += count;
+      reader->read += count;
+      return 0;
+    }
+    memmove(events, events + overwritten, (count - overwritten) * sizeof(t_screen_event));
+    *lost += overwritten;
+    reader->read += overwritten;
+    count -= overwritten;
+  }
+  reader->read += count;
+  return count;
+}
+
+void event_reader_close(t_event_reader* reader)
+{
+  if (reader->ring != NULL)
+  {
+    munmap((void*)reader->ring, reader->ring_bytes);
+    reader->ring = NULL;
+  }
+}
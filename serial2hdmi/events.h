@@ -0,0 +1,74 @@
+// per-cell change events of successive screens, for automation that
+// reacts to fields changing without parsing full screens
+//
+// Each event is 8 bytes, little endian: u32 frame, u8 row, u8 col,
+// u8 old screen code, u8 new screen code. A change of the graphic flag is
+// an event with row and col EVENT_GRAPHIC and the old and new flag.
+// Frames count all received screens, also unchanged ones, so the frame
+// number tells the time at the source frame rate. The stream starts from
+// a screen of spaces in graphic mode.
+//
+// Events go to a pipe (or any file descriptor) as a plain byte stream,
+// or into a ring in shared memory that any number of consumers poll:
+//
+//   header   "CBMEVT01", u32 capacity (events, power of two), u32 reserved,
+//            u64 events written so far
+//   events   capacity events, event n at n % capacity
+//
+// The writer stores the events before it increments the written count
+// (release), so a consumer reads the count (acquire), copies the events it
+// hasn't seen, then reads the count again: events older than the second
+// count minus the capacity may have been overwritten while copying and are
+// lost, which event_ring_read reports. The writer never waits for consumers.
+
+#ifndef __events_h__
+#define __events_h__
+
+#include <stdint.h>
+#include "screen.h"
+
+#define EVENT_GRAPHIC 0xFF
+#define EVENT_RING_DEFAULT 65536
+
+typedef struct {
+  uint32_t frame;
+  uint8_t row;
+  uint8_t col;
+  uint8_t old_code;
+  uint8_t new_code;
+} t_screen_event;
+
+typedef struct {
+  char magic[8];
+  uint32_t capacity;
+  uint32_t reserved;
+  uint64_t written;
+  t_screen_event events[];
+} t_event_ring;
+
+typedef struct {
+  int fd;              // pipe output, or -1
+  t_event_ring* ring;  // shared memory output, or NULL
+  size_t ring_bytes;
+  t_screen_event events[SCREEN_SIZE + 1];
+  unsigned short positions[SCREEN_SIZE];
+} t_event_stream;
+
+extern void event_stream_open_fd(t_event_stream* stream, int fd);
+extern int event_stream_open_ring(t_event_stream* stream, const char* name, uint32_t capacity);
+extern int event_stream_frame(t_event_stream* stream, uint32_t frame,
+  const unsigned char* old_screen, const unsigned char* new_screen,
+  unsigned char old_graphic, unsigned char new_graphic);
+extern void event_stream_close(t_event_stream* stream);
+
+typedef struct {
+  const t_event_ring* ring;
+  size_t ring_bytes;
+  uint64_t read;
+} t_event_reader;
+
+extern int event_reader_open(t_event_reader* reader, const char* name);
+extern unsigned event_ring_read(t_event_reader* reader, t_screen_event* events, unsigned max_events, uint64_t* lost);
+extern void event_reader_close(t_event_reader* reader);
+
+#endif
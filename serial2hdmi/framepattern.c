@@ -0,0 +1,41 @@
+#include <string.h>
+#include "framepattern.h"
+
+int frame_pattern_valid(const char* pattern)
+{
+  unsigned conversions = 0;
+  for (const char* p = pattern; *p != '\0'; p++)
+  {
+    if (*p != '%')
+    {
+      continue;
+    }
+    p++;
+    if (*p == '%')
+    {
+      continue;
+    }
+    while (*p == '0' || *p == '-' || *p == '+' || *p == ' ' || *p == '#')
+    {
+      p++;
+    }
+    while (*p >= '0' && *p <= '9')
+    {
+      p++;
+    }
+    if (*p == '.')
+    {
+      p++;
+      while (*p >= '0' && *p <= '9')
+      {
+        p++;
+      }
+    }
+    if (*p == '\0' || strchr("diuxXo", *p) == NULL)
+    {
+      return 0;
+    }
+    conversions++;
+  }
+  return conversions == 1;
+}
@@ -0,0 +1,11 @@
+// file name patterns for numbered frames, e.g. frame%05u.ppm, which are
+// passed to snprintf as the format with the frame number as the only argument
+
+#ifndef __framepattern_h__
+#define __framepattern_h__
+
+// frame_pattern_valid checks that pattern has exactly one conversion of an
+// unsigned integer (flags, width and precision allowed, %% is literal)
+extern int frame_pattern_valid(const char* pattern);
+
+#endif
@@ -0,0 +1,192 @@
+#include <string.h>
+#include "VG/openvg.h"
+#include "VG/vgu.h"
+#include "glyphs.h"
+#include "screen.h"
+
+static unsigned char atlasData[(PET_IMAGE_WIDTH / 8) * PET_IMAGE_HEIGHT];
+static VGImage atlasImages[GLYPH_BANKS];
+static VGImage glyphTable[GLYPH_BANKS][256];
+
+const VGImage* glyphs = glyphTable[GLYPH_BANK_GRAPHIC];
+
+// expandGlyph writes a glyph into the atlas at the given index,
+// in the same layout as petSciiImageData:
+// - the atlas holds 16 x 16 glyphs in index order, top left first
+// - OpenVG images start with the bottom row
+// - VG_BW_1 holds the leftmost pixel in bit 0, as glyph_row_bits does
+static void expandGlyph(unsigned int bank, unsigned int index)
+{
+  unsigned int dstride = PET_IMAGE_WIDTH / 8;
+  unsigned int glyphRow = index / 16;
+  unsigned int glyphCol = index % 16;
+
+  for (unsigned int y = 0; y < PET_GLYPH_HEIGHT; y++) {
+    unsigned int bits = glyph_row_bits(bank, (unsigned char)index, y);
+    unsigned int imageRow = PET_IMAGE_HEIGHT - 1 - (glyphRow * PET_GLYPH_HEIGHT + y);
+    unsigned char* dst = atlasData + imageRow * dstride + glyphCol * 2;
+    dst[0] = (unsigned char)(bits & 0xFF);
+    dst[1] = (unsigned char)(bits >> 8);
+  }
+}
+
+static VGImage makeAtlasImage(unsigned int bank) {
+  unsigned int dstride = PET_IMAGE_WIDTH / 8;
+  memset(atlasData, 0, sizeof(atlasData));
+  // screen codes 128..255 show the same characters in reverse video,
+  // pre-generated here so they cost the same as normal ones when drawing
+  for (unsigned int index = 0; index < 256; index++) {
+    expandGlyph(bank, index);
+  }
+  VGImage imgTemp = vgCreateImage(VG_sABGR_8888, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, VG_IMAGE_QUALITY_BETTER);
+  vgImageSubData(imgTemp, atlasData, dstride, VG_BW_1, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT);
+  VGImage img = vgCreateImage(VG_sABGR_8888, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, VG_IMAGE_QUALITY_BETTER);
+  vgCopyImage(img, 0, 0, imgTemp, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, VG_FALSE);
+  vgDestroyImage(imgTemp);
+  return img;
+}
+
+// prepareGlyphBanks builds the atlases of both character sets once,
+// switching between them later never touches the images again
+void prepareGlyphBanks() {
+  for (unsigned int bank = 0; bank < GLYPH_BANKS; bank++) {
+    atlasImages[bank] = makeAtlasImage(bank);
+    for (unsigned int code = 0; code < 256; code++) {
+      VGint x = (code % 16) * PET_GLYPH_WIDTH;
+      VGint y = PET_IMAGE_HEIGHT - ((code / 16 + 1) * PET_GLYPH_HEIGHT);
+      glyphTable[bank][code] = vgChildImage(atlasImages[bank], x, y, PET_GLYPH_WIDTH, PET_GLYPH_HEIGHT);
+    }
+  }
+  glyphs = glyphTable[GLYPH_BANK_GRAPHIC];
+}
+
+void destroyGlyphBanks() {
+  for (unsigned int bank = 0; bank < GLYPH_BANKS; bank++) {
+    for (unsigned int code = 0; code < 256; code++) {
+      vgDestroyImage(glyphTable[bank][code]);
+    }
+    vgDestroyImage(atlasImages[bank]);
+  }
+}
+
+// selectGlyphBank makes the character set given by the graphic flag current,
+// returns 1 if it changed, i.e. the whole screen must be repainted
+unsigned selectGlyphBank(unsigned char graphic) {
+  const VGImage* bank = glyphTable[GLYPH_BANK(graphic)];
+  if (bank == glyphs) {
+    return 0;
+  }
+  glyphs = bank;
+  return 1;
+}
+
+// bottom left corner of the area the screen is centered in, see setGlyphOrigin
+static int originX = 0;
+static int originY = 0;
+
+// setGlyphOrigin moves the area of screenW x screenH the drawing functions
+// center the screen in, e.g. to a tile (see tiles.h), 0,0 is the display
+void setGlyphOrigin(int x, int y) {
+  originX = x;
+  originY = y;
+}
+
+// cell positions: the 80x25 cells are centered in the area,
+// scaled by the given factors, OpenVG's y axis points upwards
+static inline VGfloat cellX(int col, int screenW, VGfloat scaleX) {
+  return (VGfloat)originX + (VGfloat)screenW / 2.0f + scaleX * (VGfloat)(PET_GLYPH_WIDTH * (col - 40));
+}
+
+static inline VGfloat cellY(int row, int screenH, VGfloat scaleY) {
+  return (VGfloat)originY + (VGfloat)screenH / 2.0f + scaleY * (VGfloat)(PET_GLYPH_HEIGHT * (12 - row));
+}
+
+// drawGlyphs draws 80x25 screen codes with the current bank
+void drawGlyphs(const unsigned char* screen, int screenW, int screenH, VGfloat scaleX, VGfloat scaleY) {
+  vgSeti(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  for (int row = 0; row < 25; row++) {
+    for (int col = 0; col < 80; col++) {
+      unsigned char cbmCode = screen[row * 80 + col];
+      vgLoadIdentity();
+      vgTranslate(cellX(col, screenW, scaleX), cellY(row, screenH, scaleY));
+      vgScale(scaleX, scaleY);
+      vgDrawImage(glyphs[cbmCode]);
+    }
+  }
+}
+
+// drawDirtyGlyphs draws only the cells that differ from the previous screen
+// on top of the previous frame, so the surface must be preserved on swap.
+// Glyphs are opaque and cover their cell, nothing needs to be cleared.
+// Returns the number of cells drawn.
+unsigned drawDirtyGlyphs(const unsigned char* screen, const unsigned char* previous,
+  int screenW, int screenH, VGfloat scaleX, VGfloat scaleY) {
+  unsigned drawn = 0;
+  vgSeti(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  for (int index = 0; index < 25 * 80; index++) {
+    if (screen[index] != previous[index]) {
+      vgLoadIdentity();
+      vgTranslate(cellX(index % 80, screenW, scaleX), cellY(index / 80, screenH, scaleY));
+      vgScale(scaleX, scaleY);
+      vgDrawImage(glyphs[screen[index]]);
+      drawn++;
+    }
+  }
+  return drawn;
+}
+
+// drawGlyphRows redraws each row that differs from the previous screen as a
+// whole, the matrix is set up once per row and moved on by one glyph width
+// after each glyph. Like drawDirtyGlyphs, it needs a preserved surface.
+// Returns the number of rows drawn.
+unsigned drawGlyphRows(const unsigned char* screen, const unsigned char* previous,
+  int screenW, int screenH, VGfloat scaleX, VGfloat scaleY) {
+  unsigned drawn = 0;
+  vgSeti(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  for (int row = 0; row < 25; row++) {
+    const unsigned char* line = screen + row * 80;
+    if (memcmp(line, previous + row * 80, 80) == 0) {
+      continue;
+    }
+    vgLoadIdentity();
+    vgTranslate(cellX(0, screenW, scaleX), cellY(row, screenH, scaleY));
+    vgScale(scaleX, scaleY);
+    for (int col = 0; col < 80; col++) {
+      vgDrawImage(glyphs[line[col]]);
+      vgTranslate((VGfloat)PET_GLYPH_WIDTH, 0.0f);
+    }
+    drawn++;
+  }
+  return drawn;
+}
+
+// drawScrolledGlyphs moves the content of the previous frame by scroll rows
+// (positive: up, see screen_detect_scroll) with a single vgCopyPixels and
+// draws the cells that still differ, which after a plain scroll are only
+// the rows that scrolled in. Like drawDirtyGlyphs, it needs a preserved
+// surface. Returns the number of cells drawn.
+unsigned drawScrolledGlyphs(const unsigned char* screen, const unsigned char* previous, int scroll,
+  int screenW, int screenH, VGfloat scaleX, VGfloat scaleY) {
+  static unsigned char shifted[25 * 80];
+  int scrolled = scroll < 0 ? -scroll : scroll;
+  int x = (int)cellX(0, screenW, scaleX);
+  int bottom = (int)cellY(24, screenH, scaleY);
+  int width = (int)(scaleX * (VGfloat)(80 * PET_GLYPH_WIDTH));
+  int height = (int)(scaleY * (VGfloat)((25 - scrolled) * PET_GLYPH_HEIGHT));
+  int shift = (int)(scaleY * (VGfloat)(scrolled * PET_GLYPH_HEIGHT));
+
+  // surface y grows upwards, so content scrolling up moves to a higher y
+  if (scroll > 0) {
+    vgCopyPixels(x, bottom + shift, x, bottom, width, height);
+  } else if (scroll < 0) {
+    vgCopyPixels(x, bottom, x, bottom + shift, width, height);
+  }
+
+  // the rows that scrolled in still show stale pixels, they are all drawn
+  screen_shift_rows(previous, scroll, shifted);
+  int first = scroll > 0 ? 25 - scrolled : 0;
+  for (int index = first * 80; index < (first + scrolled) * 80; index++) {
+    shifted[index] = (unsigned char)~screen[index];
+  }
+  return drawDirtyGlyphs(screen, shifted, screenW, screenH, scaleX, scaleY);
+}
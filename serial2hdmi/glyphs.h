@@ -0,0 +1,27 @@
+// glyph atlas banks built from the CBM character ROM
+//
+// Both character sets are resident, the current one is selected by
+// switching the glyphs pointer, so a screen code indexes the glyph
+// of the current character set in a single table access.
+
+#include "softglyphs.h"
+
+#define PET_GLYPH_WIDTH  16
+#define PET_GLYPH_HEIGHT 24
+#define PET_IMAGE_WIDTH  (16 * PET_GLYPH_WIDTH)
+#define PET_IMAGE_HEIGHT (16 * PET_GLYPH_HEIGHT)
+
+// glyphs of the current bank, indexed by screen code
+extern const VGImage* glyphs;
+
+extern void prepareGlyphBanks();
+extern void destroyGlyphBanks();
+extern unsigned selectGlyphBank(unsigned char graphic);
+extern void setGlyphOrigin(int x, int y);
+extern void drawGlyphs(const unsigned char* screen, int screenW, int screenH, VGfloat scaleX, VGfloat scaleY);
+extern unsigned drawDirtyGlyphs(const unsigned char* screen, const unsigned char* previous,
+  int screenW, int screenH, VGfloat scaleX, VGfloat scaleY);
+extern unsigned drawGlyphRows(const unsigned char* screen, const unsigned char* previous,
+  int screenW, int screenH, VGfloat scaleX, VGfloat scaleY);
+extern unsigned drawScrolledGlyphs(const unsigned char* screen, const unsigned char* previous, int scroll,
+  int screenW, int screenH, VGfloat scaleX, VGfloat scaleY);
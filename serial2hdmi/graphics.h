@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <VG/openvg.h>
 #include <VG/vgu.h>
 #if defined(__cplusplus)
@@ -8,12 +9,14 @@ extern "C" {
 	extern void Shear(VGfloat, VGfloat);
 	extern void Scale(VGfloat, VGfloat);
 	extern void Start(int, int);
+	extern void Continue();
 	extern void End();
 	extern void SaveEnd(const char *);
 	extern void Background(unsigned int, unsigned int, unsigned int);
 	extern void BackgroundRGB(unsigned int, unsigned int, unsigned int, VGfloat);
 	extern void InitOpenVG(int *, int *);
 	extern void FinishOpenVG();
+	extern void SwapBehavior(int);
 	extern void Fill(unsigned int, unsigned int, unsigned int, VGfloat);
 	extern void RGBA(unsigned int, unsigned int, unsigned int, VGfloat, VGfloat[4]);
 	extern void RGB(unsigned int, unsigned int, unsigned int, VGfloat[4]);
@@ -26,6 +29,16 @@ extern "C" {
 	// Added by Paeryn
 	extern void AreaClear(unsigned int x, unsigned int y, unsigned int w, unsigned int h);
 	extern void WindowClear();
+
+	// Frame timing of Start/End/SaveEnd/CaptureEnd
+	extern void FrameTimes(FILE *fp);
+	extern void SaveFrameTimes(const char *filename);
+
+	// Asynchronous capture to PPM files
+	extern void CaptureInit();
+	extern int CaptureEnd(const char *filename);
+	extern void CaptureStats(FILE *fp);
+	extern void CaptureFinish();
 #if defined(__cplusplus)
 }
 #endif
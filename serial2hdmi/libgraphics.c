@@ -10,6 +10,11 @@
 //
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <termios.h>
 #include <assert.h>
 #include "VG/openvg.h"
@@ -33,6 +38,182 @@ typedef struct {
 
 static STATE_T _state, *state = &_state;	// global graphics state
 
+//
+// Frame timing
+//
+// Start, End, SaveEnd and CaptureEnd take a monotonic timestamp at each phase of a
+// frame and keep the last FRAME_TIMES frames in a ring buffer. The render
+// thread is the only writer, it publishes a frame by incrementing
+// frame_count after the entry is complete, so readers in other threads
+// need no locks: they copy the entries and drop the ones the writer might
+// have overwritten meanwhile. Each timestamp is a clock_gettime call that
+// the vDSO serves without a syscall, four of them per frame with End, five
+// with SaveEnd and CaptureEnd.
+
+#define FRAME_TIMES 1024	// power of two
+
+typedef struct {
+	uint64_t start;		// Start called
+	uint64_t cleared;	// Start returned, surface cleared
+	uint64_t drawn;		// End, SaveEnd or CaptureEnd called, all drawing done
+	uint64_t captured;	// raster read back (same as drawn without capture)
+	uint64_t swapped;	// eglSwapBuffers returned
+} FRAME_TIME_T;
+
+static FRAME_TIME_T frame_times[FRAME_TIMES];
+static FRAME_TIME_T current_frame;
+static volatile unsigned int frame_count = 0;
+
+static inline uint64_t timestamp() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void publishFrameTime() {
+	unsigned int count = frame_count;
+	// the count published last must be seen before the entry it
+	// overwrites changes, for copyFrameTimes to drop that entry
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	frame_times[count & (FRAME_TIMES - 1)] = current_frame;
+	__atomic_store_n(&frame_count, count + 1, __ATOMIC_RELEASE);
+}
+
+// copyFrameTimes copies the recorded frames, oldest first, returns their number
+static unsigned int copyFrameTimes(FRAME_TIME_T *times) {
+	unsigned int end = __atomic_load_n(&frame_count, __ATOMIC_ACQUIRE);
+	unsigned int begin = end > FRAME_TIMES ? end - FRAME_TIMES : 0;
+	for (unsigned int i = begin; i < end; i++) {
+		times[i - begin] = frame_times[i & (FRAME_TIMES - 1)];
+	}
+	// entries overwritten while copying are not consistent, including
+	// the one the writer is filling in now; the fence keeps the copy's
+	// loads before the second look at frame_count
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	unsigned int now = __atomic_load_n(&frame_count, __ATOMIC_RELAXED);
+	unsigned int valid = now >= FRAME_TIMES ? now - FRAME_TIMES + 1 : 0;
+	if (valid > begin) {
+		if (valid >= end) {
+			return 0;
+		}
+		memmove(times, times + (valid - begin), (end - valid) * sizeof(FRAME_TIME_T));
+		begin = valid;
+	}
+	return end - begin;
+}
+
+//
+// Capture
+//
+// CaptureEnd reads the raster back into one of CAPTURE_BUFFERS buffers
+// allocated by CaptureInit and queues it for a worker thread, which
+// converts it to a PPM file. The render thread never allocates, converts
+// or writes files, it only waits for vgReadPixels. The buffers form a
+// single producer, single consumer ring: the render thread advances
+// capture_head, the worker capture_tail. If all buffers are still queued,
+// the frame is not captured and counted as dropped rather than waiting
+// for the worker.
+
+#define CAPTURE_BUFFERS 4	// power of two
+#define CAPTURE_FILENAME_SIZE 256
+
+typedef struct {
+	VGubyte *pixels;	// w * h ABGR, bottom-up
+	char filename[CAPTURE_FILENAME_SIZE];
+} CAPTURE_T;
+
+static CAPTURE_T captures[CAPTURE_BUFFERS];
+static VGubyte *capture_row;	// one RGB row for the worker
+static volatile unsigned int capture_head = 0;
+static volatile unsigned int capture_tail = 0;
+static volatile int capture_running = 0;
+static unsigned int capture_dropped = 0;
+static unsigned int capture_written = 0;	// by the worker, read with __atomic
+static uint64_t capture_encode_time = 0;	// ns spent by the worker, as well
+static sem_t capture_queued;
+static pthread_t capture_thread;
+
+// writePPM writes a captured raster top row first as binary PPM
+static void writePPM(const VGubyte *pixels, int w, int h, FILE *fp) {
+	fprintf(fp, "P6\n%d %d\n255\n", w, h);
+	for (int y = h - 1; y >= 0; y--) {
+		const VGubyte *src = pixels + (size_t)y * w * 4;
+		for (int x = 0; x < w; x++) {
+			// VG_sABGR_8888 has red in the lowest byte
+			capture_row[x * 3 + 0] = src[x * 4 + 0];
+			capture_row[x * 3 + 1] = src[x * 4 + 1];
+			capture_row[x * 3 + 2] = src[x * 4 + 2];
+		}
+		fwrite(capture_row, 1, w * 3, fp);
+	}
+}
+
+static void *captureWorker(void *arg) {
+	for (;;) {
+		sem_wait(&capture_queued);
+		unsigned int tail = capture_tail;
+		if (tail == __atomic_load_n(&capture_head, __ATOMIC_ACQUIRE)) {
+			if (!capture_running) {
+				break;
+			}
+			continue;
+		}
+		CAPTURE_T *capture = &captures[tail & (CAPTURE_BUFFERS - 1)];
+		uint64_t start = timestamp();
+		FILE *fp = fopen(capture->filename, "wb");
+		if (fp != NULL) {
+			writePPM(capture->pixels, state->screen_width, state->screen_height, fp);
+			fclose(fp);
+			__atomic_fetch_add(&capture_written, 1, __ATOMIC_RELAXED);
+		}
+		__atomic_fetch_add(&capture_encode_time, timestamp() - start, __ATOMIC_RELAXED);
+		__atomic_store_n(&capture_tail, tail + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+// CaptureInit allocates the capture buffers and starts the worker,
+// call after InitOpenVG
+void CaptureInit() {
+	size_t size = (size_t)state->screen_width * state->screen_height * 4;
+	for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+		captures[i].pixels = malloc(size);
+		assert(captures[i].pixels != NULL);
+	}
+	capture_row = malloc(state->screen_width * 3);
+	assert(capture_row != NULL);
+	sem_init(&capture_queued, 0, 0);
+	capture_running = 1;
+	int result = pthread_create(&capture_thread, NULL, captureWorker, NULL);
+	assert(result == 0);
+}
+
+// CaptureFinish writes the queued captures, stops the worker and frees the buffers
+void CaptureFinish() {
+	if (!capture_running) {
+		return;
+	}
+	capture_running = 0;
+	sem_post(&capture_queued);
+	pthread_join(capture_thread, NULL);
+	sem_destroy(&capture_queued);
+	for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+		free(captures[i].pixels);
+		captures[i].pixels = NULL;
+	}
+	free(capture_row);
+	capture_row = NULL;
+}
+
+// CaptureStats prints the number of written and dropped captures and the
+// worker time per capture, the render thread time is the capture phase of FrameTimes
+void CaptureStats(FILE *fp) {
+	unsigned int written = __atomic_load_n(&capture_written, __ATOMIC_RELAXED);
+	uint64_t encode_time = __atomic_load_n(&capture_encode_time, __ATOMIC_RELAXED);
+	fprintf(fp, "captures written %u dropped %u  encode %.3f ms/capture\n", written, capture_dropped,
+		written > 0 ? encode_time / 1e6 / written : 0.0);
+}
+
 // oglinit sets the display, OpenVGL context and screen information
 // state holds the display information
 void oglinit() {
@@ -156,12 +337,29 @@ void MakeImage(VGfloat x, VGfloat y, int w, int h, VGubyte * data) {
 	vgDestroyImage(img);
 }
 
-// dumpscreen writes the raster
+// dumpscreen writes the raster, the buffer is kept for the next dump
 void dumpscreen(int w, int h, FILE * fp) {
-	void *ScreenBuffer = malloc(w * h * 4);
+	static void *ScreenBuffer = NULL;
+	static size_t ScreenBufferSize = 0;
+	size_t size = (size_t)w * h * 4;
+	if (size > ScreenBufferSize) {
+		free(ScreenBuffer);
+		ScreenBuffer = malloc(size);
+		ScreenBufferSize = ScreenBuffer != NULL ? size : 0;
+		if (ScreenBuffer == NULL) {
+			return;
+		}
+	}
 	vgReadPixels(ScreenBuffer, (w * 4), VG_sABGR_8888, 0, 0, w, h);
-	fwrite(ScreenBuffer, 1, w * h * 4, fp);
-	free(ScreenBuffer);
+	fwrite(ScreenBuffer, 1, size, fp);
+}
+
+// SwapBehavior selects whether the surface content is preserved when
+// swapping, which costs a copy per swap but allows drawing only what changed
+void SwapBehavior(int preserve) {
+	EGLBoolean result = eglSurfaceAttrib(state->display, state->surface, EGL_SWAP_BEHAVIOR,
+		preserve ? EGL_BUFFER_PRESERVED : EGL_BUFFER_DESTROYED);
+	assert(EGL_FALSE != result);
 }
 
 // InitOpenVG sets the system to its initial state
@@ -285,6 +483,7 @@ void ClipEnd() {
 
 // Start begins the picture, clearing a rectangular region with a specified color
 void Start(int width, int height) {
+	current_frame.start = timestamp();
 	VGfloat color[4] = { 1, 1, 1, 1 };
 	vgSetfv(VG_CLEAR_COLOR, 4, color);
 	vgClear(0, 0, width, height);
@@ -293,18 +492,33 @@ void Start(int width, int height) {
 	setStroke(color);
 	strokeWidth(0);
 	vgLoadIdentity();
+	current_frame.cleared = timestamp();
+}
+
+// Continue begins a picture on top of the previous one, without clearing,
+// for drawing only what changed (see SwapBehavior)
+void Continue() {
+	current_frame.start = timestamp();
+	vgLoadIdentity();
+	current_frame.cleared = current_frame.start;
 }
 
 // End checks for errors, and renders to the display
 void End() {
+	current_frame.drawn = timestamp();
+	current_frame.captured = current_frame.drawn;
 	assert(vgGetError() == VG_NO_ERROR);
 	eglSwapBuffers(state->display, state->surface);
 	assert(eglGetError() == EGL_SUCCESS);
+	current_frame.swapped = timestamp();
+	publishFrameTime();
 }
 
-// SaveEnd dumps the raster before rendering to the display
+// SaveEnd dumps the raster before rendering to the display,
+// the dump is counted as capture phase
 void SaveEnd(const char *filename) {
 	FILE *fp;
+	current_frame.drawn = timestamp();
 	assert(vgGetError() == VG_NO_ERROR);
 	if (strlen(filename) == 0) {
 		dumpscreen(state->screen_width, state->screen_height, stdout);
@@ -315,8 +529,92 @@ void SaveEnd(const char *filename) {
 			fclose(fp);
 		}
 	}
+	current_frame.captured = timestamp();
+	eglSwapBuffers(state->display, state->surface);
+	assert(eglGetError() == EGL_SUCCESS);
+	current_frame.swapped = timestamp();
+	publishFrameTime();
+}
+
+// CaptureEnd queues the raster to be written to a PPM file by the capture
+// worker and renders to the display, returns 0 if no capture buffer was
+// free (see CaptureInit)
+int CaptureEnd(const char *filename) {
+	int queued = 0;
+	current_frame.drawn = timestamp();
+	assert(vgGetError() == VG_NO_ERROR);
+	unsigned int head = capture_head;
+	if (capture_running && head - __atomic_load_n(&capture_tail, __ATOMIC_ACQUIRE) < CAPTURE_BUFFERS) {
+		CAPTURE_T *capture = &captures[head & (CAPTURE_BUFFERS - 1)];
+		vgReadPixels(capture->pixels, state->screen_width * 4, VG_sABGR_8888,
+			0, 0, state->screen_width, state->screen_height);
+		strncpy(capture->filename, filename, CAPTURE_FILENAME_SIZE - 1);
+		capture->filename[CAPTURE_FILENAME_SIZE - 1] = '\0';
+		__atomic_store_n(&capture_head, head + 1, __ATOMIC_RELEASE);
+		sem_post(&capture_queued);
+		queued = 1;
+	} else {
+		capture_dropped++;
+	}
+	current_frame.captured = timestamp();
 	eglSwapBuffers(state->display, state->surface);
 	assert(eglGetError() == EGL_SUCCESS);
+	current_frame.swapped = timestamp();
+	publishFrameTime();
+	return queued;
+}
+
+static int compareDurations(const void *a, const void *b) {
+	uint64_t da = *(const uint64_t *)a, db = *(const uint64_t *)b;
+	return da < db ? -1 : da > db ? 1 : 0;
+}
+
+static void printPhase(FILE *fp, const char *name, uint64_t *durations, unsigned int n) {
+	qsort(durations, n, sizeof(uint64_t), compareDurations);
+	fprintf(fp, "%-7s p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n", name,
+		durations[n / 2] / 1e6, durations[(n * 99) / 100] / 1e6, durations[n - 1] / 1e6);
+}
+
+// FrameTimes prints p50, p99 and max of each phase over the recorded frames,
+// frame is the time from one swap to the next
+void FrameTimes(FILE *fp) {
+	static FRAME_TIME_T times[FRAME_TIMES];
+	static uint64_t durations[FRAME_TIMES];
+	unsigned int n = copyFrameTimes(times);
+	fprintf(fp, "frame times of the last %u frames\n", n);
+	if (n < 2) {
+		return;
+	}
+	for (unsigned int i = 0; i < n; i++) durations[i] = times[i].cleared - times[i].start;
+	printPhase(fp, "clear", durations, n);
+	for (unsigned int i = 0; i < n; i++) durations[i] = times[i].drawn - times[i].cleared;
+	printPhase(fp, "draw", durations, n);
+	for (unsigned int i = 0; i < n; i++) durations[i] = times[i].captured - times[i].drawn;
+	printPhase(fp, "capture", durations, n);
+	for (unsigned int i = 0; i < n; i++) durations[i] = times[i].swapped - times[i].captured;
+	printPhase(fp, "swap", durations, n);
+	for (unsigned int i = 0; i < n; i++) durations[i] = times[i].swapped - times[i].start;
+	printPhase(fp, "total", durations, n);
+	for (unsigned int i = 1; i < n; i++) durations[i - 1] = times[i].swapped - times[i - 1].swapped;
+	printPhase(fp, "frame", durations, n - 1);
+}
+
+// SaveFrameTimes writes the timestamps (ns) of the recorded frames as text,
+// one frame per line: start cleared drawn captured swapped
+void SaveFrameTimes(const char *filename) {
+	static FRAME_TIME_T times[FRAME_TIMES];
+	unsigned int n = copyFrameTimes(times);
+	FILE *fp = fopen(filename, "w");
+	if (fp == NULL) {
+		return;
+	}
+	for (unsigned int i = 0; i < n; i++) {
+		fprintf(fp, "%llu %llu %llu %llu %llu\n",
+			(unsigned long long)times[i].start, (unsigned long long)times[i].cleared,
+			(unsigned long long)times[i].drawn, (unsigned long long)times[i].captured,
+			(unsigned long long)times[i].swapped);
+	}
+	fclose(fp);
 }
 
 // Backgroud clears the screen to a solid background color
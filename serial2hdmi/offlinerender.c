@@ -0,0 +1,340 @@
+// offlinerender renders a recording to video frames on all cores
+//
+// usage: offlinerender [-j threads] [-r frames per second] recording [pattern]
+//
+// Without pattern, the frames are written to stdout as raw 1280x600 RGB0,
+// e.g. for
+//   offlinerender session.rec | ffmpeg -f rawvideo -pix_fmt rgb0 -s 1280x600 -r 50 -i - session.mp4
+// With pattern, each frame is written to a PPM file named by the printf
+// pattern, e.g. frame%06u.ppm.
+//
+// The frames are split into jobs at the keyframes of the recording (see
+// recording.h), long keyframe intervals into jobs of JOB_FRAMES frames.
+// Each worker thread takes the next job, seeks to its first frame and steps
+// through the deltas from there, drawing only the cells that changed with
+// the software glyph atlas. Workers write image files themselves; for
+// stdout, they render into a ring of frame slots that the main thread
+// writes in order. Frames rendered per second per core go to stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "softglyphs.h"
+#include "recording.h"
+#include "framepattern.h"
+
+#define FRAME_WIDTH  (SCREEN_COLS * SOFT_GLYPH_WIDTH)
+#define FRAME_HEIGHT (SCREEN_ROWS * SOFT_GLYPH_HEIGHT)
+
+#define JOB_FRAMES   25
+#define MAX_THREADS  64
+#define SLOTS_PER_THREAD 8 // frame slots for stdout output
+
+// the same green as the paint of serial2hdmi, red in the lowest byte
+#define FOREGROUND 0xFF40E030
+#define BACKGROUND 0xFF000000
+
+// a frame buffer with the screen it shows, to draw changed cells only
+typedef struct {
+  uint32_t* pixels;
+  unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic;
+  int valid;
+} t_canvas;
+
+typedef struct {
+  unsigned first_frame;
+  unsigned frames;
+} t_job;
+
+static const char* recording_file;
+static const char* pattern = NULL;
+static double frame_rate = 50.0;
+
+static t_job* jobs;
+static unsigned job_count;
+static unsigned next_job = 0;
+
+// stdout output: frame f is rendered into slot f % slot_count once frame
+// f - slot_count is written
+static t_canvas* slots;
+static unsigned slot_count;
+static unsigned* slot_frame; // frame in the slot, rendered when slot_ready
+static unsigned char* slot_ready;
+static unsigned frames_written = 0;
+static pthread_mutex_t slot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t slot_changed = PTHREAD_COND_INITIALIZER;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t frame_time(unsigned frame)
+{
+  return (uint32_t)(frame * 1000.0 / frame_rate);
+}
+
+static int init_canvas(t_canvas* canvas)
+{
+  canvas->pixels = malloc(FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint32_t));
+  canvas->valid = 0;
+  return canvas->pixels != NULL ? 0 : -1;
+}
+
+static void render_canvas(t_canvas* canvas, const unsigned char* screen, unsigned char graphic)
+{
+  int all = !canvas->valid || canvas->graphic != graphic;
+  unsigned bank = GLYPH_BANK(graphic);
+  for (unsigned i = 0; i < SCREEN_SIZE; i++)
+  {
+    if (all || canvas->screen[i] != screen[i])
+    {
+      soft_glyphs_draw_cell(canvas->pixels, FRAME_WIDTH, i / SCREEN_COLS, i % SCREEN_COLS, bank, screen[i]);
+    }
+  }
+  memcpy(canvas->screen, screen, SCREEN_SIZE);
+  canvas->graphic = graphic;
+  canvas->valid = 1;
+}
+
+static void write_ppm(const t_canvas* canvas, unsigned frame)
+{
+  static __thread unsigned char row[FRAME_WIDTH * 3];
+  char filename[256];
+  snprintf(filename, sizeof(filename), pattern, frame);
+  FILE* fp = fopen(filename, "wb");
+  if (fp == NULL)
+  {
+    perror(filename);
+    return;
+  }
+  fprintf(fp, "P6\n%d %d\n255\n", FRAME_WIDTH, FRAME_HEIGHT);
+  const uint32_t* pixel = canvas->pixels;
+  for (unsigned y = 0; y < FRAME_HEIGHT; y++)
+  {
+    for (unsigned x = 0; x < FRAME_WIDTH; x++, pixel++)
+    {
+      row[x * 3 + 0] = *pixel & 0xFF;
+      row[x * 3 + 1] = (*pixel >> 8) & 0xFF;
+      row[x * 3 + 2] = (*pixel >> 16) & 0xFF;
+    }
+    fwrite(row, 1, sizeof(row), fp);
+  }
+  fclose(fp);
+}
+
+// acquire_slot waits until the slot of frame is written out
+static t_canvas* acquire_slot(unsigned frame)
+{
+  pthread_mutex_lock(&slot_mutex);
+  while (frame >= frames_written + slot_count)
+  {
+    pthread_cond_wait(&slot_changed, &slot_mutex);
+  }
+  pthread_mutex_unlock(&slot_mutex);
+  return &slots[frame % slot_count];
+}
+
+static void release_slot(unsigned frame)
+{
+  pthread_mutex_lock(&slot_mutex);
+  slot_frame[frame % slot_count] = frame;
+  slot_ready[frame % slot_count] = 1;
+  pthread_cond_broadcast(&slot_changed);
+  pthread_mutex_unlock(&slot_mutex);
+}
+
+static void* render_worker(void* arg)
+{
+  t_canvas canvas;
+  t_player player;
+  if (player_open(&player, recording_file) < 0 || (pattern != NULL && init_canvas(&canvas) < 0))
+  {
+    fprintf(stderr, "%s: can't render\n", recording_file);
+    exit(1);
+  }
+  for (;;)
+  {
+    unsigned job = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED);
+    if (job >= job_count)
+    {
+      break;
+    }
+    unsigned frame = jobs[job].first_frame;
+    player_seek(&player, frame_time(frame));
+    for (unsigned i = 0; i < jobs[job].frames; i++, frame++)
+    {
+      player_advance(&player, frame_time(frame));
+      if (pattern != NULL)
+      {
+        render_canvas(&canvas, player.screen, player.graphic);
+        write_ppm(&canvas, frame);
+      }
+      else
+      {
+        render_canvas(acquire_slot(frame), player.screen, player.graphic);
+        release_slot(frame);
+      }
+    }
+  }
+  player_close(&player);
+  if (pattern != NULL)
+  {
+    free(canvas.pixels);
+  }
+  return NULL;
+}
+
+// write_frames writes the rendered frames to stdout in order
+static void write_frames(unsigned frame_count)
+{
+  while (frames_written < frame_count)
+  {
+    unsigned slot = frames_written % slot_count;
+    pthread_mutex_lock(&slot_mutex);
+    while (!slot_ready[slot] || slot_frame[slot] != frames_written)
+    {
+      pthread_cond_wait(&slot_changed, &slot_mutex);
+    }
+    pthread_mutex_unlock(&slot_mutex);
+
+    size_t size = FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint32_t);
+    if (fwrite(slots[slot].pixels, 1, size, stdout) != size)
+    {
+      perror("stdout");
+      exit(1);
+    }
+
+    pthread_mutex_lock(&slot_mutex);
+    slot_ready[slot] = 0;
+    frames_written++;
+    pthread_cond_broadcast(&slot_changed);
+    pthread_mutex_unlock(&slot_mutex);
+  }
+  fflush(stdout);
+}
+
+// make_jobs splits the frames at the keyframes and into JOB_FRAMES
+static unsigned make_jobs(const t_player* player, unsigned frame_count)
+{
+  jobs = malloc((frame_count / JOB_FRAMES + player->index_count + 1) * sizeof(t_job));
+  if (jobs == NULL)
+  {
+    return 0;
+  }
+  unsigned keyframe = 1;
+  unsigned frame = 0;
+  job_count = 0;
+  while (frame < frame_count)
+  {
+    t_job* job = &jobs[job_count++];
+    job->first_frame = frame;
+    job->frames = 0;
+    while (frame < frame_count && job->frames < JOB_FRAMES)
+    {
+      if (keyframe < player->index_count && frame_time(frame) >= player_keyframe_time(player, keyframe))
+      {
+        keyframe++;
+        if (job->frames > 0)
+        {
+          break;
+        }
+      }
+      job->frames++;
+      frame++;
+    }
+  }
+  return job_count;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int i;
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+  {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+    {
+      threads = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      frame_rate = atof(argv[++i]);
+    }
+    else
+    {
+      break;
+    }
+  }
+  if (i >= argc || threads < 1 || threads > MAX_THREADS || frame_rate <= 0.0)
+  {
+    fprintf(stderr, "usage: offlinerender [-j threads] [-r frames per second] recording [pattern]\n");
+    return 2;
+  }
+  recording_file = argv[i];
+  if (i + 1 < argc)
+  {
+    pattern = argv[i + 1];
+    if (!frame_pattern_valid(pattern))
+    {
+      fprintf(stderr, "%s: the pattern needs exactly one integer conversion like %%06u\n", pattern);
+      return 2;
+    }
+  }
+
+  t_player player;
+  if (player_open(&player, recording_file) < 0)
+  {
+    fprintf(stderr, "%s: not a readable recording\n", recording_file);
+    return 1;
+  }
+  unsigned frame_count = (unsigned)(player.duration * frame_rate / 1000.0) + 1;
+  make_jobs(&player, frame_count);
+  player_close(&player);
+
+  soft_glyphs_init(FOREGROUND, BACKGROUND);
+
+  if (pattern == NULL)
+  {
+    slot_count = threads * SLOTS_PER_THREAD;
+    slots = calloc(slot_count, sizeof(t_canvas));
+    slot_frame = calloc(slot_count, sizeof(unsigned));
+    slot_ready = calloc(slot_count, 1);
+    for (unsigned s = 0; s < slot_count; s++)
+    {
+      if (slots == NULL || init_canvas(&slots[s]) < 0)
+      {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+      }
+    }
+  }
+
+  double start = now();
+  double cpu_start = (double)clock() / CLOCKS_PER_SEC;
+  pthread_t workers[MAX_THREADS];
+  for (unsigned t = 0; t < threads; t++)
+  {
+    pthread_create(&workers[t], NULL, render_worker, NULL);
+  }
+  if (pattern == NULL)
+  {
+    write_frames(frame_count);
+  }
+  for (unsigned t = 0; t < threads; t++)
+  {
+    pthread_join(workers[t], NULL);
+  }
+  double elapsed = now() - start;
+  double cpu = (double)clock() / CLOCKS_PER_SEC - cpu_start;
+
+  fprintf(stderr, "%u frames in %u jobs, %.2f s, %u threads: %.0f frames/s, %.0f frames/s per core, cpu %.2f s\n",
+    frame_count, job_count, elapsed, threads, frame_count / elapsed, frame_count / elapsed / threads, cpu);
+  return 0;
+}
@@ -0,0 +1,121 @@
+#include <math.h>
+#include <string.h>
+#include "pacing.h"
+
+// all times in seconds
+
+#define SOURCE_PHASE_GAIN   0.1   // how much a frame's arrival moves the source timeline
+#define SOURCE_PERIOD_GAIN  0.01  // how much it corrects the source period
+#define DISPLAY_PERIOD_GAIN 0.05
+
+#define MIN_SOURCE_PERIOD  0.010
+#define MAX_SOURCE_PERIOD  0.050
+
+void pacing_init(t_pacing* pacing, double latency)
+{
+  memset(pacing, 0, sizeof(*pacing));
+  pacing->source_period = 1.0 / 50.0;
+  pacing->display_period = 1.0 / 60.0;
+  pacing->latency = latency;
+}
+
+// pacing_source_frame takes the arrival time of a complete source frame
+// and returns its target presentation time
+//
+// The source timeline works like a PLL: the arrival is compared with the
+// predicted time (allowing for missed frames), and the phase and period
+// are corrected by a fraction of the error, so UART and USB jitter don't
+// reach the presentation. An error of more than a quarter period, e.g.
+// after the PET switched between 50 and 60 Hz, restarts the measurement.
+double pacing_source_frame(t_pacing* pacing, double arrival)
+{
+  if (!pacing->source_locked)
+  {
+    double delta = arrival - pacing->source_time;
+    if (pacing->source_time > 0.0 && MIN_SOURCE_PERIOD < delta && delta < MAX_SOURCE_PERIOD)
+    {
+      pacing->source_period = delta;
+      pacing->source_locked = 1;
+    }
+    pacing->source_time = arrival;
+  }
+  else
+  {
+    double frames = floor((arrival - pacing->source_time) / pacing->source_period + 0.5);
+    if (frames < 1.0)
+    {
+      frames = 1.0;
+    }
+    double predicted = pacing->source_time + frames * pacing->source_period;
+    double error = arrival - predicted;
+    if (fabs(error) < pacing->source_period / 4.0)
+    {
+      pacing->source_time = predicted + SOURCE_PHASE_GAIN * error;
+      pacing->source_period += SOURCE_PERIOD_GAIN * error / frames;
+    }
+    else
+    {
+      pacing->source_time = arrival;
+      pacing->source_locked = 0;
+    }
+  }
+  return pacing->source_time + pacing->latency;
+}
+
+// pacing_next_vsync returns the first predicted vsync at or after the given time
+double pacing_next_vsync(t_pacing* pacing, double time)
+{
+  if (pacing->last_swap <= 0.0 || time <= pacing->last_swap)
+  {
+    return time;
+  }
+  double vsyncs = ceil((time - pacing->last_swap) / pacing->display_period);
+  return pacing->last_swap + vsyncs * pacing->display_period;
+}
+
+// pacing_swapped takes the time when eglSwapBuffers returned, which is
+// the vsync the frame is shown at, and the target time of that frame
+//
+// Swaps don't happen on every vsync (unchanged screens are skipped),
+// so the display period is corrected from swap distances of up to
+// four vsyncs divided by their number of vsyncs.
+void pacing_swapped(t_pacing* pacing, double swap_time, double target)
+{
+  if (pacing->last_swap > 0.0)
+  {
+    double delta = swap_time - pacing->last_swap;
+    double vsyncs = floor(delta / pacing->display_period + 0.5);
+    if (vsyncs >= 1.0 && vsyncs <= 4.0)
+    {
+      pacing->display_period += DISPLAY_PERIOD_GAIN * (delta / vsyncs - pacing->display_period);
+    }
+  }
+  pacing->last_swap = swap_time;
+
+  int bin = (int)floor((swap_time - target) * 1000.0) - PACING_HISTOGRAM_MIN_MS;
+  if (bin < 0)
+  {
+    bin = 0;
+  }
+  if (bin >= PACING_HISTOGRAM_BINS)
+  {
+    bin = PACING_HISTOGRAM_BINS - 1;
+  }
+  pacing->histogram[bin] += 1;
+  pacing->presented += 1;
+}
+
+void pacing_print_histogram(t_pacing* pacing, FILE* fp)
+{
+  fprintf(fp, "source period %.3f ms, display period %.3f ms, presented %lu, superseded %lu\n",
+    1000.0 * pacing->source_period, 1000.0 * pacing->display_period,
+    pacing->presented, pacing->superseded);
+  fprintf(fp, "pacing error (presented - target):\n");
+  for (int bin = 0; bin < PACING_HISTOGRAM_BINS; bin++)
+  {
+    if (pacing->histogram[bin] != 0)
+    {
+      fprintf(fp, "  %+4d ms %8lu\n", bin + PACING_HISTOGRAM_MIN_MS, pacing->histogram[bin]);
+    }
+  }
+}
@@ -0,0 +1,41 @@
+// presentation pacing between the source frame rate (50 or 60 Hz from the
+// PET, measured by check_frame_rate on the XMOS side) and the display refresh
+//
+// Each source frame gets a target presentation time: its arrival time on a
+// smoothed source timeline plus a fixed latency. Each vsync presents the
+// newest screen whose target has passed, so a 50 Hz source on a 60 Hz
+// display repeats every fifth frame in an even 1-1-1-1-2 cadence instead
+// of whenever arrival jitter happens to cross a vsync. pacingsim.c checks
+// the cadence with synthetic timestamps.
+
+#ifndef __pacing_h__
+#define __pacing_h__
+
+#include <stdio.h>
+
+// pacing error histogram: 1 ms bins from PACING_HISTOGRAM_MIN_MS,
+// the first and last bin also count everything beyond them
+#define PACING_HISTOGRAM_BINS   32
+#define PACING_HISTOGRAM_MIN_MS -8
+
+typedef struct {
+  // source timeline, estimated from arrival timestamps
+  double source_period;
+  double source_time;
+  unsigned source_locked;
+  // display timeline, estimated from swap timestamps
+  double display_period;
+  double last_swap;
+  double latency;
+  unsigned long histogram[PACING_HISTOGRAM_BINS];
+  unsigned long presented;
+  unsigned long superseded;
+} t_pacing;
+
+extern void pacing_init(t_pacing* pacing, double latency);
+extern double pacing_source_frame(t_pacing* pacing, double arrival);
+extern double pacing_next_vsync(t_pacing* pacing, double time);
+extern void pacing_swapped(t_pacing* pacing, double swap_time, double target);
+extern void pacing_print_histogram(t_pacing* pacing, FILE* fp);
+
+#endif
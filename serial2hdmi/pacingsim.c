@@ -0,0 +1,118 @@
+// pacingsim drives pacing.c with synthetic source and vsync timestamps
+//
+// usage: pacingsim [source fps] [display Hz] [jitter ms] [frames] [seed]
+//
+// Source frames arrive at the source rate (50) plus a random UART/USB
+// jitter of up to the given milliseconds (2), the display refreshes at its
+// rate (60). Every source frame is a changed screen, queued and presented
+// like receiveLoop does: just before each vsync the newest due screen is
+// drawn, and the swap returns at the vsync. Prints how many vsyncs each
+// presented screen stayed on the display, the fewest and most screens shown
+// once between two shown twice, and pacing.c's histogram. A 50 Hz source
+// on a 60 Hz display should show every fifth screen twice and none three
+// times (1-1-1-1-2).
+// Exits with 1 if a screen stayed three vsyncs or more.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pacing.h"
+
+#define PRESENT_QUEUE_SIZE 4     // as in serial2hdmi.c
+#define PRESENT_LATENCY    0.020
+#define DRAW_TIME          0.002 // from the draw to the vsync
+#define MAX_SHOWN          4
+
+static double queue[PRESENT_QUEUE_SIZE];
+static unsigned queueFirst = 0;
+static unsigned queueCount = 0;
+
+static void queueScreen(t_pacing* pacing, double target) {
+  if (queueCount == PRESENT_QUEUE_SIZE) {
+    queueFirst = (queueFirst + 1) % PRESENT_QUEUE_SIZE;
+    queueCount--;
+    pacing->superseded++;
+  }
+  queue[(queueFirst + queueCount) % PRESENT_QUEUE_SIZE] = target;
+  queueCount++;
+}
+
+// presentScreen returns 1 if a screen is presented at vsync, drawn at now
+static int presentScreen(t_pacing* pacing, double now, double vsync) {
+  double predicted = pacing_next_vsync(pacing, now);
+  unsigned due = 0;
+  while (due < queueCount && queue[(queueFirst + due) % PRESENT_QUEUE_SIZE] <= predicted) {
+    due++;
+  }
+  if (due == 0) {
+    return 0;
+  }
+  pacing->superseded += due - 1;
+  double target = queue[(queueFirst + due - 1) % PRESENT_QUEUE_SIZE];
+  queueFirst = (queueFirst + due) % PRESENT_QUEUE_SIZE;
+  queueCount -= due;
+  pacing_swapped(pacing, vsync, target);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  double sourceFps = argc > 1 ? atof(argv[1]) : 50.0;
+  double displayHz = argc > 2 ? atof(argv[2]) : 60.0;
+  double jitter = (argc > 3 ? atof(argv[3]) : 2.0) / 1000.0;
+  unsigned frames = argc > 4 ? atoi(argv[4]) : 2500;
+  srand(argc > 5 ? atoi(argv[5]) : 1);
+  if (sourceFps <= 0.0 || displayHz <= 0.0 || frames == 0) {
+    fprintf(stderr, "usage: pacingsim [source fps] [display Hz] [jitter ms] [frames] [seed]\n");
+    return 2;
+  }
+
+  t_pacing pacing;
+  pacing_init(&pacing, PRESENT_LATENCY);
+
+  unsigned long shown[MAX_SHOWN + 1] = { 0 }; // vsyncs a screen stayed, the last counts more
+  unsigned frame = 0;
+  // the source starts off the vsyncs, exact ties would follow rounding
+  double phase = 0.37 / sourceFps;
+  double nextArrival = phase + 1.0 / sourceFps;
+  unsigned long vsync = 1;
+  unsigned long lastPresented = 0;
+  unsigned singles = 0;         // since the last screen shown twice
+  int doubles = 0;
+  unsigned minSingles = ~0u;
+  unsigned maxSingles = 0;
+  while (frame < frames || queueCount > 0) {
+    double vsyncTime = vsync / displayHz;
+    // the screens that arrive until the draw
+    while (frame < frames && nextArrival < vsyncTime - DRAW_TIME) {
+      double arrival = nextArrival + jitter * rand() / RAND_MAX;
+      queueScreen(&pacing, pacing_source_frame(&pacing, arrival));
+      frame++;
+      nextArrival = phase + (frame + 1) / sourceFps;
+    }
+    if (presentScreen(&pacing, vsyncTime - DRAW_TIME, vsyncTime)) {
+      if (lastPresented > 0) {
+        unsigned stayed = vsync - lastPresented;
+        shown[stayed < MAX_SHOWN ? stayed : MAX_SHOWN]++;
+        if (stayed == 1) {
+          singles++;
+        } else {
+          // the cadence is even if the gaps between the doubles are
+          if (doubles++ > 0) {
+            minSingles = singles < minSingles ? singles : minSingles;
+            maxSingles = singles > maxSingles ? singles : maxSingles;
+          }
+          singles = 0;
+        }
+      }
+      lastPresented = vsync;
+    }
+    vsync++;
+  }
+
+  printf("%.2f fps on %.2f Hz, +%.1f ms jitter, %u frames\n", sourceFps, displayHz, 1000.0 * jitter, frames);
+  printf("shown for 1 vsync %lu, 2 vsyncs %lu, 3 vsyncs %lu, more %lu\n", shown[1], shown[2], shown[3], shown[4]);
+  if (doubles > 1) {
+    printf("shown once between two shown twice: %u to %u\n", minSingles, maxSingles);
+  }
+  pacing_print_histogram(&pacing, stdout);
+  return shown[3] + shown[4] > 0 ? 1 : 0;
+}
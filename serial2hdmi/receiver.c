@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <errno.h>
+#include "receiver.h"
+
+// open_uart opens the serial device in non blocking read mode at 3 Mbit/s,
+// see serial_receiver_sketch.c for the meaning of the flags
+int open_uart(const char* device)
+{
+  int uart_filestream = open(device, O_RDONLY | O_NOCTTY | O_NDELAY);
+
+  if (uart_filestream == -1)
+  {
+    fprintf(stderr, "unable to open %s: %s\n", device, strerror(errno));
+    return -1;
+  }
+
+  struct termios options;
+  tcgetattr(uart_filestream, &options);
+  options.c_cflag = B3000000 | CS8 | CLOCAL | CREAD;
+  options.c_iflag = IGNPAR;
+  options.c_oflag = 0;
+  options.c_lflag = 0;
+  tcflush(uart_filestream, TCIFLUSH);
+  tcsetattr(uart_filestream, TCSANOW, &options);
+
+  return uart_filestream;
+}
+
+static int read_bytes(int uart_filestream, unsigned char* pBuffer, unsigned int buflen)
+{
+  int rx_length = read(uart_filestream, pBuffer, buflen);
+  if (rx_length == -1)
+  {
+    if (errno == EWOULDBLOCK) {
+      return 0;
+    }
+    perror("unable to read from uart");
+    return -1;
+  }
+  return rx_length;
+}
+
+//----------------------------------------------------------------------------------------
+
+void init_receiver_context(t_receiver_context* context)
+{
+  context->state = STATE_COUNTING_ZEROS;
+  context->count = 0;
+  context->rx_buffer_index = 0;
+  context->rx_buffer_count = 0;
+  memset(context->flags, 0, sizeof(context->flags));
+}
+
+static void handle_sync_loss(t_receiver_context* context, unsigned char byte)
+{
+  fprintf(stderr, "out of sync at bufnum %d count %d - received %02x\n", context->bufnum, context->count, byte);
+}
+
+static void handle_received_buffer(t_receiver_context* context)
+{
+  if (context->bufnum > 0)
+  {
+    if (context->bufnum < 51)
+    {
+      memcpy(context->screen_buffer + (context->bufnum - 1) * 40, context->buffer, 40);
+    }
+    else
+    {
+      memcpy(context->flags, context->buffer, 40);
+      *(context->graphic) = context->buffer[FLAGS_GRAPHIC];
+    }
+  }
+}
+
+// handle_received_byte returns 1 when the last buffer of a frame was received
+unsigned handle_received_byte(t_receiver_context* context, unsigned char byte)
+{
+  unsigned screen_complete = 0;
+
+  switch(context->state)
+  {
+  case STATE_COUNTING_ZEROS:
+    if (byte == 0)
+    {
+      context->count += 1;
+      if (context->count == 41)
+      {
+        context->state = STATE_IN_SYNC;
+        context->bufnum = 1;
+        context->count = 0;
+      }
+    }
+    else
+    {
+      context->count = 0;
+    }
+    break;
+
+  case STATE_IN_SYNC:
+    if (context->count < 40)
+    {
+      context->buffer[context->count] = byte;
+      context->count += 1;
+    }
+    else
+    {
+      if (byte == (unsigned char)context->bufnum)
+      {
+        handle_received_buffer(context);
+        context->bufnum += 1;
+        context->count = 0;
+        if (context->bufnum == 52)
+        {
+          context->state = STATE_COUNTING_ZEROS;
+          screen_complete = 1;
+        }
+      }
+      else
+      {
+        handle_sync_loss(context, byte);
+        context->state = STATE_COUNTING_ZEROS;
+        context->count = 0;
+      }
+    }
+    break;
+  }
+  return screen_complete;
+}
+
+// receive_screen consumes the available bytes until a screen is complete,
+// returns 1 if screen_buffer and graphic were filled with a complete screen,
+// 0 if no more bytes are available for now, and -1 on read errors
+int receive_screen(int stream, t_receiver_context* context, unsigned char* screen_buffer, unsigned char* graphic)
+{
+  context->screen_buffer = screen_buffer;
+  context->graphic = graphic;
+
+  while (1)
+  {
+    if (context->rx_buffer_index == context->rx_buffer_count)
+    {
+      int count = read_bytes(stream, context->rx_buffer, sizeof(context->rx_buffer));
+      if (count <= 0)
+      {
+        return count;
+      }
+      context->rx_buffer_index = 0;
+      context->rx_buffer_count = count;
+    }
+    else
+    {
+      unsigned char received_byte = context->rx_buffer[context->rx_buffer_index++];
+      if (handle_received_byte(context, received_byte))
+      {
+        return 1;
+      }
+    }
+  }
+}
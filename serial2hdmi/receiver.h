@@ -0,0 +1,41 @@
+// receiver for the binary frame format sent by app_fast_cbm_video_observer
+//
+// A frame consists of 52 buffers of 41 bytes, the last byte of each buffer
+// is the buffer number. Buffer 0 is all zeroes (sync), buffers 1 to 50 hold
+// the 80x25 screen codes, buffer 51 holds the flags (graphic state in byte 0).
+
+// flags, as in video_memory.h of the firmware
+#define FLAGS_GRAPHIC        0 // graphic pin
+#define FLAGS_TEARS          1 // writes that tore a line in this frame, up to 255
+#define FLAGS_TEAR_POSITIONS 2 // line, column and microseconds after the line's
+                               // copy of the first TEAR_POSITIONS of them
+#define TEAR_POSITIONS       8
+#define FLAGS_MISSED_SYNCS  26 // frame syncs missed so far, modulo 256
+#define FLAGS_SYNC_DRIFT    27 // microseconds this frame's sync was off its prediction,
+                               // signed, clamped to +-127
+#define FLAGS_SKIPPED       28 // copies the renderer did not send so far, modulo 256
+#define FLAGS_SUPERSEDED    29 // of them, those waiting for the UART when a newer
+                               // copy came, modulo 256
+
+#include "screen.h"
+
+#define STATE_COUNTING_ZEROS 1
+#define STATE_IN_SYNC        2
+
+typedef struct {
+  unsigned char rx_buffer[256];
+  unsigned rx_buffer_index;
+  unsigned rx_buffer_count;
+  unsigned state;
+  unsigned bufnum;
+  unsigned count;
+  unsigned char buffer[40];
+  unsigned char* screen_buffer;
+  unsigned char* graphic;
+  unsigned char flags[40]; // of the last complete screen
+} t_receiver_context;
+
+extern int open_uart(const char* device);
+extern void init_receiver_context(t_receiver_context* context);
+extern unsigned handle_received_byte(t_receiver_context* context, unsigned char byte);
+extern int receive_screen(int stream, t_receiver_context* context, unsigned char* screen_buffer, unsigned char* graphic);
@@ -0,0 +1,556 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "recording.h"
+
+#define HEADER_MAGIC   "CBMREC01"
+#define TRAILER_MAGIC  "CBMINDEX"
+#define HEADER_SIZE    16
+#define RECORD_HEADER  8
+#define INDEX_ENTRY    8
+#define TRAILER_SIZE   16
+
+// a delta is only written if it is smaller than a keyframe
+#define MAX_DELTA_PAYLOAD (SCREEN_SIZE - 1)
+
+// deltas longer than two rows of changes are checked for a scroll
+#define RECORDING_SCROLL_CHECK (2 * SCREEN_COLS)
+
+static void put_le16(unsigned char* p, unsigned value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+}
+
+static void put_le32(unsigned char* p, uint32_t value)
+{
+  put_le16(p, value & 0xFFFF);
+  put_le16(p + 2, value >> 16);
+}
+
+static unsigned get_le16(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_le32(const unsigned char* p)
+{
+  return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+//----------------------------------------------------------------------------------------
+// records
+
+// scroll_screen moves the rows of screen up by scroll rows (negative: down)
+// and fills the rows that scroll in with spaces
+static void scroll_screen(unsigned char* screen, int scroll)
+{
+  int rows = scroll < 0 ? -scroll : scroll;
+  screen_shift_rows(screen, scroll, screen);
+  memset(screen + (scroll > 0 ? SCREEN_ROWS - rows : 0) * SCREEN_COLS, ' ', rows * SCREEN_COLS);
+}
+
+// encode_delta writes the runs of cells that differ between old and current
+// to payload, returns the payload length, or a length above
+// MAX_DELTA_PAYLOAD if a keyframe is smaller
+static unsigned encode_delta(const unsigned char* old, const unsigned char* current, unsigned char* payload)
+{
+  unsigned length = 0;
+  unsigned i = 0;
+  while (i < SCREEN_SIZE && length <= MAX_DELTA_PAYLOAD)
+  {
+    if (old[i] == current[i])
+    {
+      i++;
+      continue;
+    }
+    unsigned start = i;
+    while (i < SCREEN_SIZE && i - start < 255 && old[i] != current[i])
+    {
+      i++;
+    }
+    unsigned run = i - start;
+    if (length + 3 + run > MAX_DELTA_PAYLOAD)
+    {
+      return MAX_DELTA_PAYLOAD + 1;
+    }
+    put_le16(payload + length, start);
+    payload[length + 2] = run;
+    memcpy(payload + length + 3, current + start, run);
+    length += 3 + run;
+  }
+  return length;
+}
+
+// record_encode writes the record that turns previous into screen to
+// record (RECORD_MAX bytes): a delta, a scroll if that is smaller, or a
+// keyframe if previous is NULL or a keyframe is smaller. Returns the
+// record length, or 0 if nothing changed.
+unsigned record_encode(const unsigned char* previous, unsigned char previous_graphic,
+  const unsigned char* screen, unsigned char graphic, uint32_t time, unsigned char* record)
+{
+  unsigned char* payload = record + RECORD_HEADER;
+  unsigned char type = RECORD_DELTA;
+  unsigned length = previous != NULL ? encode_delta(previous, screen, payload) : MAX_DELTA_PAYLOAD + 1;
+  if (length == 0 && graphic == previous_graphic)
+  {
+    return 0;
+  }
+
+  // a scroll changes every row, it is stored as the scroll plus the
+  // cells that differ from the scrolled screen, usually the new rows
+  if (previous != NULL && length > RECORDING_SCROLL_CHECK)
+  {
+    int scroll = screen_detect_scroll(previous, screen);
+    if (scroll != 0)
+    {
+      static unsigned char scrolled[SCREEN_SIZE];
+      static unsigned char scroll_payload[SCREEN_SIZE + 3];
+      memcpy(scrolled, previous, SCREEN_SIZE);
+      scroll_screen(scrolled, scroll);
+      unsigned scroll_length = encode_delta(scrolled, screen, scroll_payload + 1) + 1;
+      if (scroll_length < length && scroll_length <= MAX_DELTA_PAYLOAD)
+      {
+        scroll_payload[0] = (unsigned char)(signed char)scroll;
+        memcpy(payload, scroll_payload, scroll_length);
+        length = scroll_length;
+        type = RECORD_SCROLL;
+      }
+    }
+  }
+
+  if (length > MAX_DELTA_PAYLOAD)
+  {
+    type = RECORD_KEYFRAME;
+    length = SCREEN_SIZE;
+    memcpy(payload, screen, SCREEN_SIZE);
+  }
+  record[0] = type;
+  record[1] = graphic;
+  put_le16(record + 2, length);
+  put_le32(record + 4, time);
+  return RECORD_HEADER + length;
+}
+
+// apply_runs copies the runs of changed cells of a delta to screen,
+// returns 0 if they are corrupt
+static int apply_runs(unsigned char* screen, const unsigned char* payload, const unsigned char* end)
+{
+  while (payload < end)
+  {
+    if (payload + 3 > end)
+    {
+      return 0;
+    }
+    unsigned start = get_le16(payload);
+    unsigned run = payload[2];
+    if (start + run > SCREEN_SIZE || payload + 3 + run > end)
+    {
+      return 0;
+    }
+    memcpy(screen + start, payload + 3, run);
+    payload += 3 + run;
+  }
+  return 1;
+}
+
+// record_decode applies a complete record of length bytes to screen and
+// sets graphic and time, returns 0 if the record is corrupt
+int record_decode(const unsigned char* record, size_t length,
+  unsigned char* screen, unsigned char* graphic, uint32_t* time)
+{
+  if (length < RECORD_HEADER || length != RECORD_HEADER + get_le16(record + 2))
+  {
+    return 0;
+  }
+  const unsigned char* payload = record + RECORD_HEADER;
+  const unsigned char* end = record + length;
+
+  if (record[0] == RECORD_KEYFRAME)
+  {
+    if (length != RECORD_HEADER + SCREEN_SIZE)
+    {
+      return 0;
+    }
+    memcpy(screen, payload, SCREEN_SIZE);
+  }
+  else if (record[0] == RECORD_DELTA)
+  {
+    if (!apply_runs(screen, payload, end))
+    {
+      return 0;
+    }
+  }
+  else if (record[0] == RECORD_SCROLL)
+  {
+    int scroll = payload < end ? (signed char)payload[0] : 0;
+    if (scroll == 0 || scroll <= -SCREEN_ROWS || scroll >= SCREEN_ROWS)
+    {
+      return 0;
+    }
+    scroll_screen(screen, scroll);
+    if (!apply_runs(screen, payload + 1, end))
+    {
+      return 0;
+    }
+  }
+  else
+  {
+    return 0;
+  }
+  *graphic = record[1];
+  *time = get_le32(record + 4);
+  return 1;
+}
+
+//----------------------------------------------------------------------------------------
+// recorder
+
+static int write_record(t_recorder* recorder, const unsigned char* record, unsigned length)
+{
+  if (fwrite(record, 1, length, recorder->fp) != length || fflush(recorder->fp) != 0)
+  {
+    return -1;
+  }
+  recorder->offset += length;
+  return 0;
+}
+
+static int write_keyframe(t_recorder* recorder, uint32_t time)
+{
+  static unsigned char record[RECORD_MAX];
+  if (recorder->index_count == recorder->index_size)
+  {
+    unsigned size = recorder->index_size * 2;
+    t_recording_index* index = realloc(recorder->index, size * sizeof(t_recording_index));
+    if (index == NULL)
+    {
+      return -1;
+    }
+    recorder->index = index;
+    recorder->index_size = size;
+  }
+  t_recording_index* entry = &recorder->index[recorder->index_count];
+  entry->time = time;
+  entry->offset = recorder->offset;
+  unsigned length = record_encode(NULL, 0, recorder->screen, recorder->graphic, time, record);
+  if (write_record(recorder, record, length) < 0)
+  {
+    return -1;
+  }
+  recorder->index_count++;
+  recorder->keyframe_time = time;
+  recorder->delta_bytes = 0;
+  return 0;
+}
+
+// recorder_open creates a recording, returns 0 or -1 on error
+int recorder_open(t_recorder* recorder, const char* filename)
+{
+  memset(recorder, 0, sizeof(*recorder));
+  recorder->fp = fopen(filename, "wb");
+  if (recorder->fp == NULL)
+  {
+    perror(filename);
+    return -1;
+  }
+  recorder->index_size = 64;
+  recorder->index = malloc(recorder->index_size * sizeof(t_recording_index));
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t start = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  unsigned char header[HEADER_SIZE];
+  memcpy(header, HEADER_MAGIC, 8);
+  put_le32(header + 8, (uint32_t)start);
+  put_le32(header + 12, (uint32_t)(start >> 32));
+  if (recorder->index == NULL || fwrite(header, 1, HEADER_SIZE, recorder->fp) != HEADER_SIZE)
+  {
+    fclose(recorder->fp);
+    free(recorder->index);
+    return -1;
+  }
+  recorder->offset = HEADER_SIZE;
+  return 0;
+}
+
+// recorder_add appends a screen shown from time (ms since the start of the
+// recording, not decreasing) on, unchanged screens are not recorded.
+// Returns 0 or -1 on a write error.
+int recorder_add(t_recorder* recorder, uint32_t time, const unsigned char* screen, unsigned char graphic)
+{
+  static unsigned char record[RECORD_MAX];
+
+  if (recorder->frames == 0 ||
+      time - recorder->keyframe_time >= RECORDING_KEYFRAME_MS ||
+      recorder->delta_bytes >= RECORDING_KEYFRAME_BYTES)
+  {
+    memcpy(recorder->screen, screen, SCREEN_SIZE);
+    recorder->graphic = graphic;
+    recorder->frames++;
+    return write_keyframe(recorder, time);
+  }
+
+  unsigned length = record_encode(recorder->screen, recorder->graphic, screen, graphic, time, record);
+  if (length == 0)
+  {
+    return 0;
+  }
+  memcpy(recorder->screen, screen, SCREEN_SIZE);
+  recorder->graphic = graphic;
+  recorder->frames++;
+  if (record[0] == RECORD_KEYFRAME)
+  {
+    return write_keyframe(recorder, time);
+  }
+  recorder->delta_bytes += length;
+  return write_record(recorder, record, length);
+}
+
+// recorder_close appends the keyframe index and closes the recording
+int recorder_close(t_recorder* recorder)
+{
+  int result = 0;
+  uint32_t index_offset = recorder->offset;
+  unsigned char entry[INDEX_ENTRY];
+  for (unsigned i = 0; i < recorder->index_count; i++)
+  {
+    put_le32(entry, recorder->index[i].time);
+    put_le32(entry + 4, recorder->index[i].offset);
+    if (fwrite(entry, 1, INDEX_ENTRY, recorder->fp) != INDEX_ENTRY)
+    {
+      result = -1;
+    }
+  }
+  unsigned char trailer[TRAILER_SIZE];
+  put_le32(trailer, recorder->index_count);
+  put_le32(trailer + 4, index_offset);
+  memcpy(trailer + 8, TRAILER_MAGIC, 8);
+  if (fwrite(trailer, 1, TRAILER_SIZE, recorder->fp) != TRAILER_SIZE)
+  {
+    result = -1;
+  }
+  if (fclose(recorder->fp) != 0)
+  {
+    result = -1;
+  }
+  free(recorder->index);
+  recorder->index = NULL;
+  return result;
+}
+
+//----------------------------------------------------------------------------------------
+// player
+
+// is_recording tells recordings from raw session files
+int is_recording(const char* filename)
+{
+  char magic[8];
+  FILE* fp = fopen(filename, "rb");
+  if (fp == NULL)
+  {
+    return 0;
+  }
+  int result = fread(magic, 1, 8, fp) == 8 && memcmp(magic, HEADER_MAGIC, 8) == 0;
+  fclose(fp);
+  return result;
+}
+
+// record_length returns the size of the complete record at position, or 0
+static size_t record_length(const t_player* player, size_t position, size_t end)
+{
+  if (position + RECORD_HEADER > end)
+  {
+    return 0;
+  }
+  size_t length = RECORD_HEADER + get_le16(player->data + position + 2);
+  return position + length <= end ? length : 0;
+}
+
+// apply_record decodes the record at position into the player's screen,
+// returns the position of the next record, or 0 if the record is corrupt
+static size_t apply_record(t_player* player, size_t position)
+{
+  size_t length = record_length(player, position, player->records_end);
+  if (length == 0 ||
+      !record_decode(player->data + position, length, player->screen, &player->graphic, &player->time))
+  {
+    return 0;
+  }
+  return position + length;
+}
+
+// rebuild_index scans the records of a recording without index, which ends
+// at the last complete record
+static int rebuild_index(t_player* player)
+{
+  unsigned count = 0;
+  size_t position = HEADER_SIZE;
+  size_t length;
+  while ((length = record_length(player, position, player->size)) != 0)
+  {
+    count += player->data[position] == RECORD_KEYFRAME;
+    position += length;
+  }
+  player->records_end = position;
+  player->built_index = malloc(count * INDEX_ENTRY + 1);
+  if (player->built_index == NULL)
+  {
+    return -1;
+  }
+  unsigned char* entry = player->built_index;
+  for (position = HEADER_SIZE; position < player->records_end; position += record_length(player, position, player->size))
+  {
+    if (player->data[position] == RECORD_KEYFRAME)
+    {
+      put_le32(entry, get_le32(player->data + position + 4));
+      put_le32(entry + 4, position);
+      entry += INDEX_ENTRY;
+    }
+  }
+  player->index = player->built_index;
+  player->index_count = count;
+  return 0;
+}
+
+// player_open maps a recording and shows its first screen,
+// returns 0 or -1 if it can't be read or has no screens
+int player_open(t_player* player, const char* filename)
+{
+  memset(player, 0, sizeof(*player));
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+  {
+    perror(filename);
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < HEADER_SIZE)
+  {
+    close(fd);
+    return -1;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    perror(filename);
+    return -1;
+  }
+  player->data = data;
+  player->size = st.st_size;
+  if (memcmp(player->data, HEADER_MAGIC, 8) != 0)
+  {
+    player_close(player);
+    return -1;
+  }
+  player->start_time = get_le32(player->data + 8) | ((uint64_t)get_le32(player->data + 12) << 32);
+
+  const unsigned char* trailer = player->data + player->size - TRAILER_SIZE;
+  if (player->size >= HEADER_SIZE + TRAILER_SIZE && memcmp(trailer + 8, TRAILER_MAGIC, 8) == 0 &&
+      get_le32(trailer + 4) >= HEADER_SIZE &&
+      get_le32(trailer + 4) + (size_t)get_le32(trailer) * INDEX_ENTRY == player->size - TRAILER_SIZE)
+  {
+    player->index_count = get_le32(trailer);
+    player->records_end = get_le32(trailer + 4);
+    player->index = player->data + player->records_end;
+  }
+  else if (rebuild_index(player) < 0)
+  {
+    player_close(player);
+    return -1;
+  }
+  if (player->index_count == 0)
+  {
+    player_close(player);
+    return -1;
+  }
+
+  // the duration is the time of the last record after the last keyframe
+  size_t position = get_le32(player->index + (player->index_count - 1) * INDEX_ENTRY + 4);
+  size_t length;
+  while ((length = record_length(player, position, player->records_end)) != 0)
+  {
+    player->duration = get_le32(player->data + position + 4);
+    position += length;
+  }
+
+  return player_seek(player, 0) ? 0 : -1;
+}
+
+// player_next moves to the next screen, returns 0 at the end of the recording
+int player_next(t_player* player)
+{
+  if (player->position >= player->records_end)
+  {
+    return 0;
+  }
+  size_t next = apply_record(player, player->position);
+  if (next == 0)
+  {
+    player->position = player->records_end;
+    return 0;
+  }
+  player->position = next;
+  return 1;
+}
+
+// player_seek shows the screen at time: a binary search for the last
+// keyframe at or before time, then the deltas up to time
+int player_seek(t_player* player, uint32_t time)
+{
+  unsigned low = 0;
+  unsigned high = player->index_count;
+  while (high - low > 1)
+  {
+    unsigned middle = (low + high) / 2;
+    if (get_le32(player->index + middle * INDEX_ENTRY) <= time)
+    {
+      low = middle;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  player->position = get_le32(player->index + low * INDEX_ENTRY + 4);
+  if (!player_next(player))
+  {
+    return 0;
+  }
+  player_advance(player, time);
+  return 1;
+}
+
+// player_keyframe_time returns the time of keyframe i of the index
+uint32_t player_keyframe_time(const t_player* player, unsigned i)
+{
+  return get_le32(player->index + i * INDEX_ENTRY);
+}
+
+// player_advance moves forward to the screen at time without a seek,
+// for stepping through a recording in small increments
+void player_advance(t_player* player, uint32_t time)
+{
+  while (player->position < player->records_end &&
+         record_length(player, player->position, player->records_end) != 0 &&
+         get_le32(player->data + player->position + 4) <= time)
+  {
+    player_next(player);
+  }
+}
+
+void player_close(t_player* player)
+{
+  if (player->data != NULL)
+  {
+    munmap((void*)player->data, player->size);
+  }
+  free(player->built_index);
+  memset(player, 0, sizeof(*player));
+}
@@ -0,0 +1,94 @@
+// recordings store decoded screens: keyframes with all 2000 screen codes
+// and deltas with the changed cells only, each with a timestamp.
+//
+// File layout, all numbers little endian:
+//
+//   header   "CBMREC01", u64 start time (ms since the epoch)
+//   records  u8 type, u8 graphic, u16 payload length, u32 time (ms since start)
+//            'K' keyframe: the 2000 screen codes
+//            'D' delta: runs of changed cells, each u16 position, u8 length,
+//                then length screen codes
+//            'S' scroll: i8 rows the screen content moved up (negative:
+//                down), the rows scrolled in are spaces, then runs of
+//                changed cells like a delta
+//   index    appended when the recording is closed: per keyframe
+//            u32 time, u32 file offset of the record
+//   trailer  u32 keyframe count, u32 file offset of the index, "CBMINDEX"
+//
+// Records are only ever appended and flushed one at a time, so a recording
+// cut short by a crash is still readable up to its last complete record;
+// the player rebuilds the missing index by scanning the keyframes.
+//
+// A keyframe is written every RECORDING_KEYFRAME_MS or when the deltas
+// since the last one exceed RECORDING_KEYFRAME_BYTES, which bounds the work
+// for a seek to a binary search in the index plus replaying those deltas.
+
+#ifndef __recording_h__
+#define __recording_h__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "screen.h"
+
+#define RECORDING_KEYFRAME_MS    30000
+#define RECORDING_KEYFRAME_BYTES 65536
+
+#define RECORD_KEYFRAME 'K'
+#define RECORD_DELTA    'D'
+#define RECORD_SCROLL   'S'
+
+// the largest record, a keyframe with its header
+#define RECORD_MAX (8 + SCREEN_SIZE)
+
+typedef struct {
+  uint32_t time;
+  uint32_t offset;
+} t_recording_index;
+
+typedef struct {
+  FILE* fp;
+  uint32_t offset;
+  uint32_t keyframe_time;
+  uint32_t delta_bytes;
+  unsigned frames;
+  unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic;
+  t_recording_index* index;
+  unsigned index_count;
+  unsigned index_size;
+} t_recorder;
+
+// the player maps the file and decodes index and records in place
+typedef struct {
+  const unsigned char* data;
+  size_t size;
+  uint64_t start_time;
+  uint32_t duration;               // time of the last record
+  const unsigned char* index;      // index entries as in the file
+  unsigned char* built_index;      // if the index had to be rebuilt
+  unsigned index_count;
+  size_t records_end;
+  size_t position; // of the next record
+  uint32_t time;   // of the current screen
+  unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic;
+} t_player;
+
+extern unsigned record_encode(const unsigned char* previous, unsigned char previous_graphic,
+  const unsigned char* screen, unsigned char graphic, uint32_t time, unsigned char* record);
+extern int record_decode(const unsigned char* record, size_t length,
+  unsigned char* screen, unsigned char* graphic, uint32_t* time);
+
+extern int recorder_open(t_recorder* recorder, const char* filename);
+extern int recorder_add(t_recorder* recorder, uint32_t time, const unsigned char* screen, unsigned char graphic);
+extern int recorder_close(t_recorder* recorder);
+
+extern int is_recording(const char* filename);
+extern int player_open(t_player* player, const char* filename);
+extern int player_next(t_player* player);
+extern int player_seek(t_player* player, uint32_t time);
+extern void player_advance(t_player* player, uint32_t time);
+extern uint32_t player_keyframe_time(const t_player* player, unsigned i);
+extern void player_close(t_player* player);
+
+#endif
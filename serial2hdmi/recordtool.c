@@ -0,0 +1,521 @@
+// recordtool converts raw sessions to recordings and inspects recordings
+//
+// usage: recordtool convert session.bin recording [frames per second]
+//        recordtool info recording
+//        recordtool seek recording ms
+//        recordtool tears session.bin
+//        recordtool sync session.bin
+//        recordtool generate idle|list frames session.bin
+//        recordtool verify session.bin recording [seeks]
+//
+// convert decodes a raw serial session (see session.h), which has no
+// timestamps, so the screens are timed at the given frame rate (default 50).
+// info prints the duration, record counts and the size per hour.
+// seek prints the screen at the given time as text and the seek time.
+// tears prints the frames of a raw session whose flags report writes that
+// came too late for the observer's line copy, with their positions and
+// microseconds after the copy, and a summary per line to tune the delays.
+// sync prints the frame syncs the observer missed during a raw session and
+// how far the syncs were off the observer's prediction, and the frames the
+// observer skipped because the UART was busy.
+// generate writes a synthetic raw session of the given number of frames:
+// idle is a screen with a cursor blinking every 25 frames, a random cell
+// changed every third frame and a single scroll halfway; list is LIST output
+// scrolling by one line a frame, two every fourth, in bursts of 150 frames,
+// each followed by 100 frames of a blinking cursor. E.g. the size of an hour
+// at 50 Hz and the seek time, checked against the session:
+//   recordtool generate idle 180000 idle.bin
+//   recordtool convert idle.bin idle.rec && recordtool info idle.rec
+//   recordtool verify idle.bin idle.rec 5000
+// verify seeks the recording converted from a raw session (at 50 frames per
+// second) to the times of random frames of it, compares the screens with the
+// decoded ones, and prints the seek time.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "receiver.h"
+#include "recording.h"
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int convert(const char* session_file, const char* recording_file, double frame_rate)
+{
+  static unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic = 1;
+
+  FILE* fp = fopen(session_file, "rb");
+  if (fp == NULL)
+  {
+    perror(session_file);
+    return 1;
+  }
+  t_recorder recorder;
+  if (recorder_open(&recorder, recording_file) < 0)
+  {
+    fclose(fp);
+    return 1;
+  }
+
+  t_receiver_context context;
+  init_receiver_context(&context);
+  context.screen_buffer = screen;
+  context.graphic = &graphic;
+
+  unsigned frames = 0;
+  int byte;
+  int result = 0;
+  while ((byte = fgetc(fp)) != EOF)
+  {
+    if (handle_received_byte(&context, (unsigned char)byte))
+    {
+      uint32_t time = (uint32_t)(frames * 1000.0 / frame_rate);
+      if (recorder_add(&recorder, time, screen, graphic) < 0)
+      {
+        perror(recording_file);
+        result = 1;
+        break;
+      }
+      frames++;
+    }
+  }
+  fclose(fp);
+  printf("%u frames, %u recorded screens, %u keyframes\n", frames, recorder.frames, recorder.index_count);
+  if (recorder_close(&recorder) < 0)
+  {
+    perror(recording_file);
+    result = 1;
+  }
+  return result;
+}
+
+static int info(const char* recording_file)
+{
+  t_player player;
+  if (player_open(&player, recording_file) < 0)
+  {
+    fprintf(stderr, "%s: not a readable recording\n", recording_file);
+    return 1;
+  }
+  unsigned records = 1;
+  unsigned long changed_cells = 0;
+  unsigned char previous[SCREEN_SIZE];
+  memcpy(previous, player.screen, SCREEN_SIZE);
+  while (player_next(&player))
+  {
+    records++;
+    for (unsigned i = 0; i < SCREEN_SIZE; i++)
+    {
+      changed_cells += previous[i] != player.screen[i];
+    }
+    memcpy(previous, player.screen, SCREEN_SIZE);
+  }
+  double hours = player.duration / 3600000.0;
+  printf("duration %.1f s, %u screens, %u keyframes, %.1f changed cells per screen\n",
+    player.duration / 1000.0, records, player.index_count,
+    records > 1 ? (double)changed_cells / (records - 1) : 0.0);
+  printf("size %zu bytes", player.size);
+  if (hours > 0.0)
+  {
+    printf(", %.1f KB per hour", player.size / 1024.0 / hours);
+  }
+  printf("%s\n", player.built_index != NULL ? " (index rebuilt, recording not closed)" : "");
+  player_close(&player);
+  return 0;
+}
+
+static int seek(const char* recording_file, uint32_t time)
+{
+  t_player player;
+  if (player_open(&player, recording_file) < 0)
+  {
+    fprintf(stderr, "%s: not a readable recording\n", recording_file);
+    return 1;
+  }
+  double start = now();
+  player_seek(&player, time);
+  double elapsed = now() - start;
+
+  for (unsigned row = 0; row < SCREEN_ROWS; row++)
+  {
+    for (unsigned col = 0; col < SCREEN_COLS; col++)
+    {
+      // screen codes 1-26 are letters, 32-63 match ASCII, reverse is ignored
+      unsigned char code = player.screen[row * SCREEN_COLS + col] & 0x7F;
+      putchar(code >= 1 && code <= 26 ? 'A' + code - 1 : code >= 32 && code < 64 ? code : '.');
+    }
+    putchar('\n');
+  }
+  printf("screen at %.3f s, seek took %.1f us\n", player.time / 1000.0, elapsed * 1e6);
+  player_close(&player);
+  return 0;
+}
+
+static int tears(const char* session_file)
+{
+  static unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic = 1;
+
+  FILE* fp = fopen(session_file, "rb");
+  if (fp == NULL)
+  {
+    perror(session_file);
+    return 1;
+  }
+  t_receiver_context context;
+  init_receiver_context(&context);
+  context.screen_buffer = screen;
+  context.graphic = &graphic;
+
+  unsigned frames = 0;
+  unsigned torn_frames = 0;
+  unsigned long total = 0;
+  unsigned long per_line[SCREEN_ROWS] = {0};
+  unsigned logged = 0;
+  unsigned long after_copy = 0;
+  unsigned max_after_copy = 0;
+  int byte;
+  while ((byte = fgetc(fp)) != EOF)
+  {
+    if (!handle_received_byte(&context, (unsigned char)byte))
+    {
+      continue;
+    }
+    frames++;
+    unsigned count = context.flags[FLAGS_TEARS];
+    if (count == 0)
+    {
+      continue;
+    }
+    torn_frames++;
+    total += count;
+    printf("frame %u: %u%s", frames - 1, count, count == 255 ? "+" : "");
+    for (unsigned i = 0; i < count && i < TEAR_POSITIONS; i++)
+    {
+      const unsigned char* position = context.flags + FLAGS_TEAR_POSITIONS + 3 * i;
+      if (position[0] >= SCREEN_ROWS || position[1] >= SCREEN_COLS)
+      {
+        continue; // not from a firmware with tear detection
+      }
+      printf(" %u:%u+%uus", position[0], position[1], position[2]);
+      per_line[position[0]]++;
+      logged++;
+      after_copy += position[2];
+      if (position[2] > max_after_copy)
+      {
+        max_after_copy = position[2];
+      }
+    }
+    printf("\n");
+  }
+  fclose(fp);
+
+  printf("%u frames, %u with tears, %lu tears\n", frames, torn_frames, total);
+  if (logged > 0)
+  {
+    printf("logged per line:");
+    for (unsigned line = 0; line < SCREEN_ROWS; line++)
+    {
+      printf(" %lu", per_line[line]);
+    }
+    printf("\nafter the copy: avg %.1f us, max %u us\n", (double)after_copy / logged, max_after_copy);
+  }
+  return 0;
+}
+
+static int sync_stats(const char* session_file)
+{
+  static unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic = 1;
+
+  FILE* fp = fopen(session_file, "rb");
+  if (fp == NULL)
+  {
+    perror(session_file);
+    return 1;
+  }
+  t_receiver_context context;
+  init_receiver_context(&context);
+  context.screen_buffer = screen;
+  context.graphic = &graphic;
+
+  unsigned frames = 0;
+  unsigned long missed = 0;
+  unsigned char last_missed = 0;
+  unsigned long skipped = 0;
+  unsigned long superseded = 0;
+  unsigned char last_skipped = 0;
+  unsigned char last_superseded = 0;
+  unsigned long drift_sum = 0;
+  unsigned drift_max = 0;
+  unsigned off = 0; // clamped, likely not predicted at all
+  int byte;
+  while ((byte = fgetc(fp)) != EOF)
+  {
+    if (!handle_received_byte(&context, (unsigned char)byte))
+    {
+      continue;
+    }
+    unsigned char count = context.flags[FLAGS_MISSED_SYNCS];
+    if (frames > 0)
+    {
+      missed += (unsigned char)(count - last_missed);
+    }
+    last_missed = count;
+    if (frames > 0)
+    {
+      skipped += (unsigned char)(context.flags[FLAGS_SKIPPED] - last_skipped);
+      superseded += (unsigned char)(context.flags[FLAGS_SUPERSEDED] - last_superseded);
+    }
+    last_skipped = context.flags[FLAGS_SKIPPED];
+    last_superseded = context.flags[FLAGS_SUPERSEDED];
+    int drift = (signed char)context.flags[FLAGS_SYNC_DRIFT];
+    unsigned size = drift < 0 ? -drift : drift;
+    drift_sum += size;
+    if (size > drift_max)
+    {
+      drift_max = size;
+    }
+    off += size == 127;
+    frames++;
+  }
+  fclose(fp);
+
+  printf("%u frames, %lu syncs missed, %lu frames skipped by the observer (%lu superseded)\n",
+    frames, missed, skipped, superseded);
+  if (frames > 0)
+  {
+    printf("sync off its prediction: avg %.1f us, max %u us, %u frames 127 us or more\n",
+      (double)drift_sum / frames, drift_max, off);
+  }
+  return 0;
+}
+
+static unsigned random_state = 1;
+
+static unsigned next_random()
+{
+  random_state = random_state * 1103515245 + 12345;
+  return (random_state >> 16) & 0x7FFF;
+}
+
+// write_frame writes screen as the observer sends it, see receiver.h
+static void write_frame(FILE* fp, const unsigned char* screen, unsigned char graphic)
+{
+  unsigned char buffer[41] = { 0 };
+  fwrite(buffer, 1, 41, fp);
+  for (unsigned i = 0; i < 50; i++)
+  {
+    memcpy(buffer, screen + i * 40, 40);
+    buffer[40] = (unsigned char)(i + 1);
+    fwrite(buffer, 1, 41, fp);
+  }
+  memset(buffer, 0, 40);
+  buffer[FLAGS_GRAPHIC] = graphic;
+  buffer[40] = 51;
+  fwrite(buffer, 1, 41, fp);
+}
+
+// list_line puts the next line of a BASIC listing into the last row of screen
+static void list_line(unsigned char* screen, unsigned line_number)
+{
+  char text[81];
+  unsigned char* row = screen + (SCREEN_ROWS - 1) * SCREEN_COLS;
+  memset(row, ' ', SCREEN_COLS);
+  int length = snprintf(text, sizeof(text), "%u PRINT \"LINE %u\";X%u:GOTO %u",
+    line_number, line_number, line_number % 7, line_number + 10);
+  for (int i = 0; i < length && i < SCREEN_COLS; i++)
+  {
+    // screen codes: letters are 1..26, digits and punctuation as ASCII
+    row[i] = (text[i] >= 'A' && text[i] <= 'Z') ? text[i] - 'A' + 1 : text[i];
+  }
+}
+
+static int generate(const char* kind, unsigned frames, const char* session_file)
+{
+  int list = strcmp(kind, "list") == 0;
+  if (!list && strcmp(kind, "idle") != 0)
+  {
+    fprintf(stderr, "%s: not idle or list\n", kind);
+    return 2;
+  }
+  FILE* fp = fopen(session_file, "wb");
+  if (fp == NULL)
+  {
+    perror(session_file);
+    return 1;
+  }
+  static unsigned char screen[SCREEN_SIZE];
+  static unsigned char shown[SCREEN_SIZE];
+  memset(screen, ' ', SCREEN_SIZE);
+  random_state = 3;
+  unsigned line_number = 10;
+  for (unsigned frame = 0; frame < frames; frame++)
+  {
+    if (list)
+    {
+      unsigned phase = frame % 250;
+      if (phase < 150)
+      {
+        for (unsigned lines = phase % 4 == 0 ? 2 : 1; lines > 0; lines--)
+        {
+          screen_shift_rows(screen, 1, screen);
+          list_line(screen, line_number);
+          line_number += 10;
+        }
+      }
+      memcpy(shown, screen, SCREEN_SIZE);
+      if (phase >= 150 && (phase - 150) / 25 % 2 == 1)
+      {
+        shown[(SCREEN_ROWS - 2) * SCREEN_COLS] ^= 0x80; // the cursor below the listing
+      }
+      write_frame(fp, shown, 1);
+    }
+    else
+    {
+      if (frame % 25 == 0)
+      {
+        screen[9 * SCREEN_COLS] ^= 0x80;
+      }
+      if (frame % 3 == 0)
+      {
+        screen[next_random() % SCREEN_SIZE] = (unsigned char)(1 + next_random() % 59);
+      }
+      if (frame == frames / 2)
+      {
+        screen_shift_rows(screen, 1, screen);
+      }
+      write_frame(fp, screen, 1);
+    }
+  }
+  if (fclose(fp) != 0)
+  {
+    perror(session_file);
+    return 1;
+  }
+  return 0;
+}
+
+static int compare_times(const void* a, const void* b)
+{
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static int verify(const char* session_file, const char* recording_file, unsigned seeks)
+{
+  static unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic = 1;
+
+  FILE* fp = fopen(session_file, "rb");
+  if (fp == NULL)
+  {
+    perror(session_file);
+    return 1;
+  }
+  t_player player;
+  if (player_open(&player, recording_file) < 0)
+  {
+    fprintf(stderr, "%s: not a readable recording\n", recording_file);
+    fclose(fp);
+    return 1;
+  }
+  // the frames to seek to, from the size of the session, in order
+  struct stat st;
+  unsigned frames = fstat(fileno(fp), &st) == 0 ? st.st_size / (52 * 41) : 0;
+  uint32_t* targets = malloc((seeks > 0 ? seeks : 1) * sizeof(uint32_t));
+  random_state = 1;
+  for (unsigned i = 0; i < seeks; i++)
+  {
+    targets[i] = frames > 0 ? (uint32_t)(((uint64_t)next_random() << 15 | next_random()) % frames) : 0;
+  }
+  qsort(targets, seeks, sizeof(uint32_t), compare_times);
+
+  t_receiver_context context;
+  init_receiver_context(&context);
+  context.screen_buffer = screen;
+  context.graphic = &graphic;
+
+  unsigned frame = 0;
+  unsigned next = 0;
+  unsigned checked = 0;
+  unsigned mismatched = 0;
+  double seek_sum = 0.0;
+  double seek_max = 0.0;
+  int byte;
+  while (next < seeks && (byte = fgetc(fp)) != EOF)
+  {
+    if (!handle_received_byte(&context, (unsigned char)byte))
+    {
+      continue;
+    }
+    // at 50 frames per second, as convert times them
+    uint32_t time = (uint32_t)(frame * 1000.0 / 50.0);
+    for (; next < seeks && targets[next] == frame; next++)
+    {
+      double start = now();
+      player_seek(&player, time);
+      double elapsed = now() - start;
+      seek_sum += elapsed;
+      seek_max = elapsed > seek_max ? elapsed : seek_max;
+      checked++;
+      mismatched += player.graphic != graphic || memcmp(player.screen, screen, SCREEN_SIZE) != 0;
+    }
+    frame++;
+  }
+  fclose(fp);
+  player_close(&player);
+  free(targets);
+
+  printf("%u seeks, %u screens differ from the session, seek avg %.1f us, max %.1f us\n",
+    checked, mismatched, checked > 0 ? seek_sum / checked * 1e6 : 0.0, seek_max * 1e6);
+  return mismatched > 0 || checked < seeks ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc >= 4 && strcmp(argv[1], "convert") == 0)
+  {
+    return convert(argv[2], argv[3], argc > 4 ? atof(argv[4]) : 50.0);
+  }
+  if (argc == 3 && strcmp(argv[1], "info") == 0)
+  {
+    return info(argv[2]);
+  }
+  if (argc == 4 && strcmp(argv[1], "seek") == 0)
+  {
+    return seek(argv[2], (uint32_t)strtoul(argv[3], NULL, 10));
+  }
+  if (argc == 3 && strcmp(argv[1], "tears") == 0)
+  {
+    return tears(argv[2]);
+  }
+  if (argc == 3 && strcmp(argv[1], "sync") == 0)
+  {
+    return sync_stats(argv[2]);
+  }
+  if (argc == 5 && strcmp(argv[1], "generate") == 0)
+  {
+    return generate(argv[2], (unsigned)strtoul(argv[3], NULL, 10), argv[4]);
+  }
+  if ((argc == 4 || argc == 5) && strcmp(argv[1], "verify") == 0)
+  {
+    return verify(argv[2], argv[3], argc > 4 ? (unsigned)strtoul(argv[4], NULL, 10) : 1000);
+  }
+  fprintf(stderr, "usage: recordtool convert session.bin recording [frames per second]\n"
+                  "       recordtool info recording\n"
+                  "       recordtool seek recording ms\n"
+                  "       recordtool tears session.bin\n"
+                  "       recordtool sync session.bin\n"
+                  "       recordtool generate idle|list frames session.bin\n"
+                  "       recordtool verify session.bin recording [seeks]\n");
+  return 2;
+}
@@ -0,0 +1,135 @@
+// renderbench replays a session and measures the render time per frame
+//
+// usage: renderbench [session file]
+//
+// A session file is the raw byte stream from the serial device, see session.h.
+// Without a session file, a synthetic session is used where the cursor
+// blinks on a screen with a few lines of reverse video, which is what a
+// PET waiting at the READY prompt mostly looks like.
+//
+// Each session is rendered twice, once as it is and once with reverse
+// video stripped, to show that reverse cells cost the same as normal ones.
+// The draw time runs up to vgFinish, the swap waits for the display's
+// vsync and is reported apart, it would make every frame a frame period.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include "VG/openvg.h"
+#include "VG/vgu.h"
+#include "graphics.h"
+#include "glyphs.h"
+#include "session.h"
+
+#define MAX_FRAMES      3000
+#define SYNTHETIC_FRAMES 600
+#define BLINK_FRAMES      20 // cursor blink phase in frames
+
+static unsigned char screens[MAX_FRAMES][SCREEN_SIZE];
+static unsigned char graphics[MAX_FRAMES];
+static unsigned frameCount = 0;
+
+static unsigned char asciiToScreenCode(char c) {
+  if (c >= 'A' && c <= 'Z') {
+    return (unsigned char)(c - 'A' + 1);
+  }
+  return (unsigned char)c; // digits and punctuation are the same
+}
+
+static void putText(unsigned char* screen, int row, int col, const char* text, unsigned char reverse) {
+  for (int i = 0; text[i] != '\0' && col + i < 80; i++) {
+    screen[row * 80 + col + i] = asciiToScreenCode(text[i]) | reverse;
+  }
+}
+
+static void makeSyntheticSession() {
+  unsigned char screen[SCREEN_SIZE];
+  memset(screen, ' ', SCREEN_SIZE);
+  putText(screen, 0, 0, "                   *** COMMODORE BASIC 4.0 ***                                  ", 0x80);
+  putText(screen, 2, 0, " 31743 BYTES FREE", 0);
+  putText(screen, 4, 0, "READY.", 0);
+  putText(screen, 5, 0, "LIST", 0);
+  putText(screen, 6, 0, "10 PRINT \"HELLO\"", 0);
+  putText(screen, 7, 0, "20 GOTO 10", 0);
+  putText(screen, 8, 0, "READY.", 0);
+  putText(screen, 24, 0, " F1 RUN  F2 LIST  F3 LOAD  F4 SAVE                                              ", 0x80);
+
+  for (frameCount = 0; frameCount < SYNTHETIC_FRAMES; frameCount++) {
+    memcpy(screens[frameCount], screen, SCREEN_SIZE);
+    if ((frameCount / BLINK_FRAMES) % 2 == 0) {
+      screens[frameCount][9 * 80] |= 0x80; // cursor
+    }
+    graphics[frameCount] = 1;
+  }
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void renderSession(const char* title, int screenW, int screenH, VGPaint paint, unsigned char mask) {
+  static unsigned char screen[SCREEN_SIZE];
+  double total = 0.0;
+  double min = 1e9;
+  double max = 0.0;
+  double swapTotal = 0.0;
+  unsigned long reverseCells = 0;
+
+  for (unsigned frame = 0; frame < frameCount; frame++) {
+    for (unsigned i = 0; i < SCREEN_SIZE; i++) {
+      screen[i] = screens[frame][i] & mask;
+      reverseCells += screen[i] >> 7;
+    }
+    double start = now();
+    selectGlyphBank(graphics[frame]);
+    Start(screenW, screenH);
+    Background(0, 0, 0);
+    vgSetPaint(paint, VG_FILL_PATH);
+    vgSeti(VG_IMAGE_MODE, VG_DRAW_IMAGE_MULTIPLY);
+    drawGlyphs(screen, screenW, screenH, 1.0f, 1.0f);
+    vgFinish();
+    double drawn = now();
+    End();
+    double elapsed = drawn - start;
+    total += elapsed;
+    if (elapsed < min) min = elapsed;
+    if (elapsed > max) max = elapsed;
+    swapTotal += now() - drawn;
+  }
+
+  printf("%-10s frames %4u  reverse cells %7lu  draw ms/frame avg %6.3f min %6.3f max %6.3f  swap avg %6.3f\n",
+    title, frameCount, reverseCells,
+    1000.0 * total / frameCount, 1000.0 * min, 1000.0 * max, 1000.0 * swapTotal / frameCount);
+}
+
+int main(int argc, char **argv) {
+  int w, h;
+
+  if (argc > 1) {
+    frameCount = load_session(argv[1], screens, graphics, MAX_FRAMES);
+    if (frameCount == 0) {
+      fprintf(stderr, "no frames in %s\n", argv[1]);
+      return 1;
+    }
+  } else {
+    makeSyntheticSession();
+  }
+
+  InitOpenVG(&w, &h);
+  prepareGlyphBanks();
+  VGPaint paint = vgCreatePaint();
+  VGfloat paintColor[4] = { 0.2f, 0.9f, 0.3f, 1.0f };
+  vgSetParameterfv(paint, VG_PAINT_COLOR, 4, paintColor);
+
+  renderSession("as-is", w, h, paint, 0xFF);
+  renderSession("no-rvs", w, h, paint, 0x7F);
+
+  vgDestroyPaint(paint);
+  destroyGlyphBanks();
+  FinishOpenVG();
+  return 0;
+}
@@ -0,0 +1,143 @@
+#include <stdint.h>
+#include <string.h>
+#include "screen.h"
+
+// screen_equal compares two screens a row at a time, or-ing the xor of
+// all bytes of a row without branches so the compiler vectorizes it
+// (built with -O3), and stops at the first row that differs
+int screen_equal(const unsigned char* a, const unsigned char* b)
+{
+  for (unsigned row = 0; row < SCREEN_ROWS; row++)
+  {
+    const unsigned char* rowA = a + row * SCREEN_COLS;
+    const unsigned char* rowB = b + row * SCREEN_COLS;
+    unsigned char diff = 0;
+    for (unsigned i = 0; i < SCREEN_COLS; i++)
+    {
+      diff |= rowA[i] ^ rowB[i];
+    }
+    if (diff)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+#define DIFF_BLOCK 16
+
+// screen_diff stores the positions of the cells that differ between a and b
+// in positions (room for SCREEN_SIZE), returns their number. Blocks of
+// DIFF_BLOCK cells are compared like rows in screen_equal, only the blocks
+// that differ are scanned cell by cell.
+unsigned screen_diff(const unsigned char* a, const unsigned char* b, unsigned short* positions)
+{
+  unsigned count = 0;
+  for (unsigned block = 0; block < SCREEN_SIZE; block += DIFF_BLOCK)
+  {
+    unsigned char diff = 0;
+    for (unsigned i = 0; i < DIFF_BLOCK; i++)
+    {
+      diff |= a[block + i] ^ b[block + i];
+    }
+    if (diff)
+    {
+      for (unsigned i = block; i < block + DIFF_BLOCK; i++)
+      {
+        if (a[i] != b[i])
+        {
+          positions[count++] = (unsigned short)i;
+        }
+      }
+    }
+  }
+  return count;
+}
+
+static uint32_t row_hash(const unsigned char* row)
+{
+  uint32_t hash = 2166136261u;
+  for (unsigned i = 0; i < SCREEN_COLS; i++)
+  {
+    hash = (hash ^ row[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// screen_detect_scroll finds a vertical scroll from previous to screen by
+// comparing row hashes, returns the number of rows the content moved up
+// (negative: down), or 0 if it didn't scroll. A scroll counts if more than
+// half of the changed rows are rows of previous shifted by the same amount;
+// rows that are unchanged anyway (e.g. blank ones) don't count.
+int screen_detect_scroll(const unsigned char* previous, const unsigned char* screen)
+{
+  uint32_t previous_hash[SCREEN_ROWS];
+  uint32_t hash[SCREEN_ROWS];
+  unsigned changed = 0;
+  for (unsigned row = 0; row < SCREEN_ROWS; row++)
+  {
+    previous_hash[row] = row_hash(previous + row * SCREEN_COLS);
+    hash[row] = row_hash(screen + row * SCREEN_COLS);
+    changed += previous_hash[row] != hash[row];
+  }
+  if (changed < 2)
+  {
+    return 0;
+  }
+
+  int best = 0;
+  unsigned best_matches = 0;
+  for (int scroll = -(SCREEN_ROWS - 1); scroll < SCREEN_ROWS; scroll++)
+  {
+    unsigned matches = 0;
+    for (int row = 0; row < SCREEN_ROWS; row++)
+    {
+      int from = row + scroll;
+      if (scroll != 0 && from >= 0 && from < SCREEN_ROWS &&
+          hash[row] != previous_hash[row] && hash[row] == previous_hash[from])
+      {
+        matches++;
+      }
+    }
+    if (matches > best_matches)
+    {
+      best = scroll;
+      best_matches = matches;
+    }
+  }
+  if (best_matches < 2 || best_matches * 2 <= changed)
+  {
+    return 0;
+  }
+  // confirm the hash matches
+  unsigned confirmed = 0;
+  for (int row = 0; row < SCREEN_ROWS; row++)
+  {
+    int from = row + best;
+    if (from >= 0 && from < SCREEN_ROWS && hash[row] != previous_hash[row] &&
+        memcmp(screen + row * SCREEN_COLS, previous + from * SCREEN_COLS, SCREEN_COLS) == 0)
+    {
+      confirmed++;
+    }
+  }
+  return confirmed * 2 > changed ? best : 0;
+}
+
+// screen_shift_rows moves the rows of screen by scroll rows (positive: up)
+// into shifted, the rows that scroll in are left as they are in shifted
+void screen_shift_rows(const unsigned char* screen, int scroll, unsigned char* shifted)
+{
+  unsigned rows = SCREEN_ROWS - (scroll < 0 ? -scroll : scroll);
+  if (scroll > 0)
+  {
+    memmove(shifted, screen + scroll * SCREEN_COLS, rows * SCREEN_COLS);
+  }
+  else if (scroll < 0)
+  {
+    memmove(shifted - scroll * SCREEN_COLS, screen, rows * SCREEN_COLS);
+  }
+  else if (shifted != screen)
+  {
+    memcpy(shifted, screen, SCREEN_SIZE);
+  }
+}
@@ -0,0 +1,15 @@
+// 80x25 screens of CBM screen codes as received from the observer
+
+#ifndef __screen_h__
+#define __screen_h__
+
+#define SCREEN_COLS 80
+#define SCREEN_ROWS 25
+#define SCREEN_SIZE (SCREEN_COLS * SCREEN_ROWS)
+
+extern int screen_equal(const unsigned char* a, const unsigned char* b);
+extern unsigned screen_diff(const unsigned char* a, const unsigned char* b, unsigned short* positions);
+extern int screen_detect_scroll(const unsigned char* previous, const unsigned char* screen);
+extern void screen_shift_rows(const unsigned char* screen, int scroll, unsigned char* shifted);
+
+#endif
@@ -0,0 +1,475 @@
+// screend decodes the screens of several CBM machines on one host
+//
+// usage: screend [-j workers] [-m prefix] [-s] device ...
+//        screend -b ports [-j workers] [-t seconds] [-f session file]
+//
+// Every device gets its own receiver context and publishes its screens in
+// the shared memory segment prefix<n> (default cbm0, cbm1, ...), see
+// sharedscreen.h, e.g. screenmirror cbm1 follows the second machine.
+// The devices are multiplexed with epoll on a pool of worker threads
+// (default one per core). A device is registered one shot, so only one
+// worker at a time decodes it and the bytes of a port stay in order.
+// -s prints the frame rate of every port every 10 s. ^C prints totals.
+//
+// -b measures the scaling: it creates the given number of pseudo
+// terminals, feeds each at 3 Mbit/s (300000 bytes/s) from the session file
+// (default a synthetic screen sequence) and decodes them like devices.
+// It reports the frames decoded against the frames sent, the bytes the
+// feed couldn't write because a port fell behind (overruns on a real
+// UART) and the CPU time of the workers, as ports per core.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include "receiver.h"
+#include "sharedscreen.h"
+
+#define MAX_PORTS 64
+#define MAX_WORKERS 16
+#define STATS_INTERVAL 10.0
+#define FRAME_BYTES (52 * 41)
+#define PORT_RATE 300000.0 // 3 Mbit/s with start and stop bits
+
+typedef struct {
+  const char* device;
+  int fd;
+  t_receiver_context context;
+  unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic;
+  t_screen_publisher publisher;
+  int publishing;
+  uint64_t frames;
+  uint64_t bytes;
+} t_port;
+
+static t_port ports[MAX_PORTS];
+static unsigned port_count = 0;
+static int epoll_fd;
+static volatile sig_atomic_t stop = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t realtime_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void handle_signal(int signal)
+{
+  stop = 1;
+}
+
+static int open_port(t_port* port, const char* device, const char* prefix, unsigned index)
+{
+  memset(port, 0, sizeof(*port));
+  port->device = device;
+  port->graphic = 1;
+  port->fd = open_uart(device);
+  if (port->fd < 0)
+  {
+    return -1;
+  }
+  init_receiver_context(&port->context);
+  port->context.screen_buffer = port->screen;
+  port->context.graphic = &port->graphic;
+  char name[64];
+  snprintf(name, sizeof(name), "%s%u", prefix, index);
+  port->publishing = screen_publisher_open(&port->publisher, name) == 0;
+
+  struct epoll_event event;
+  event.events = EPOLLIN | EPOLLONESHOT;
+  event.data.ptr = port;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, port->fd, &event) < 0)
+  {
+    perror(device);
+    close(port->fd);
+    return -1;
+  }
+  return 0;
+}
+
+// service_port decodes what the port has received, returns 0 to wait for
+// more or -1 if the port is gone
+static int service_port(t_port* port)
+{
+  unsigned char buffer[4096];
+  for (;;)
+  {
+    ssize_t count = read(port->fd, buffer, sizeof(buffer));
+    if (count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (count < 0 && errno == EAGAIN)
+    {
+      return 0;
+    }
+    if (count <= 0)
+    {
+      return -1;
+    }
+    port->bytes += count;
+    for (ssize_t i = 0; i < count; i++)
+    {
+      if (handle_received_byte(&port->context, buffer[i]))
+      {
+        port->frames++;
+        if (port->publishing)
+        {
+          // the receive buffer still holds the flags buffer, the last of the frame
+          screen_publish(&port->publisher, port->frames, realtime_ns(), port->context.buffer, port->screen);
+        }
+      }
+    }
+  }
+}
+
+static void* worker(void* arg)
+{
+  struct epoll_event events[16];
+  while (!stop)
+  {
+    int count = epoll_wait(epoll_fd, events, 16, 200);
+    for (int i = 0; i < count; i++)
+    {
+      t_port* port = events[i].data.ptr;
+      if (service_port(port) < 0)
+      {
+        fprintf(stderr, "%s: closed\n", port->device);
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, port->fd, NULL);
+        continue;
+      }
+      // one shot, the port is handed to the next worker that sees it ready
+      struct epoll_event event;
+      event.events = EPOLLIN | EPOLLONESHOT;
+      event.data.ptr = port;
+      epoll_ctl(epoll_fd, EPOLL_CTL_MOD, port->fd, &event);
+    }
+  }
+  return NULL;
+}
+
+static double thread_cpu(pthread_t thread)
+{
+  clockid_t clock;
+  struct timespec ts;
+  if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0)
+  {
+    return 0.0;
+  }
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_ports(double elapsed)
+{
+  for (unsigned i = 0; i < port_count; i++)
+  {
+    fprintf(stderr, "%s: %llu frames, %.1f frames/s, %.0f bytes/s\n", ports[i].device,
+      (unsigned long long)ports[i].frames, ports[i].frames / elapsed, ports[i].bytes / elapsed);
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+typedef struct {
+  int masters[MAX_PORTS];
+  const unsigned char* data;
+  size_t size;
+  double seconds;
+  uint64_t sent;
+  uint64_t behind;
+  double cpu;
+} t_feed;
+
+// feed writes the session to every pseudo terminal at the port rate,
+// bytes a port doesn't take in time are skipped like a UART overrun
+static void* feed(void* arg)
+{
+  t_feed* feed = arg;
+  uint64_t positions[MAX_PORTS] = { 0 };
+  double start = now();
+  double elapsed;
+  while ((elapsed = now() - start) < feed->seconds)
+  {
+    uint64_t due = (uint64_t)(elapsed * PORT_RATE);
+    for (unsigned i = 0; i < port_count; i++)
+    {
+      while (positions[i] < due)
+      {
+        size_t offset = positions[i] % feed->size;
+        size_t length = due - positions[i];
+        if (length > feed->size - offset)
+        {
+          length = feed->size - offset;
+        }
+        ssize_t written = write(feed->masters[i], feed->data + offset, length);
+        if (written <= 0)
+        {
+          feed->behind += due - positions[i];
+          positions[i] = due;
+          break;
+        }
+        positions[i] += written;
+        feed->sent += written;
+      }
+    }
+    usleep(1000);
+  }
+  feed->cpu = thread_cpu(pthread_self());
+  return NULL;
+}
+
+// synthetic_session makes frames whose screens change a few cells each
+static unsigned char* synthetic_session(size_t* size)
+{
+  unsigned frames = 250;
+  unsigned char* data = malloc(frames * FRAME_BYTES);
+  unsigned char screen[SCREEN_SIZE];
+  memset(screen, ' ', SCREEN_SIZE);
+  for (unsigned f = 0; f < frames; f++)
+  {
+    for (unsigned c = 0; c < 20; c++)
+    {
+      screen[(f * 97 + c * 13) % SCREEN_SIZE] = (f + c) & 0x7F;
+    }
+    unsigned char* frame = data + f * FRAME_BYTES;
+    for (unsigned b = 0; b < 52; b++)
+    {
+      unsigned char* buffer = frame + b * 41;
+      memset(buffer, 0, 40);
+      if (b >= 1 && b <= 50)
+      {
+        memcpy(buffer, screen + (b - 1) * 40, 40);
+      }
+      else if (b == 51)
+      {
+        buffer[0] = 1;
+      }
+      buffer[40] = b;
+    }
+  }
+  *size = frames * FRAME_BYTES;
+  return data;
+}
+
+static unsigned char* load_file(const char* path, size_t* size)
+{
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL)
+  {
+    perror(path);
+    return NULL;
+  }
+  fseek(fp, 0, SEEK_END);
+  *size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  unsigned char* data = malloc(*size);
+  if (data == NULL || *size == 0 || fread(data, 1, *size, fp) != *size)
+  {
+    fprintf(stderr, "%s: can't read\n", path);
+    free(data);
+    fclose(fp);
+    return NULL;
+  }
+  fclose(fp);
+  return data;
+}
+
+static int benchmark(unsigned count, unsigned workers, double seconds, const char* session_file)
+{
+  static t_feed feeder;
+  feeder.seconds = seconds;
+  feeder.data = session_file != NULL ? load_file(session_file, &feeder.size) : synthetic_session(&feeder.size);
+  if (feeder.data == NULL)
+  {
+    return 1;
+  }
+  if (count > MAX_PORTS)
+  {
+    count = MAX_PORTS;
+  }
+  for (unsigned i = 0; i < count; i++)
+  {
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+      perror("pseudo terminal");
+      return 1;
+    }
+    feeder.masters[i] = master;
+    if (open_port(&ports[port_count], strdup(ptsname(master)), "cbmbench", i) < 0)
+    {
+      return 1;
+    }
+    port_count++;
+  }
+
+  pthread_t threads[MAX_WORKERS];
+  for (unsigned i = 0; i < workers; i++)
+  {
+    pthread_create(&threads[i], NULL, worker, NULL);
+  }
+  pthread_t feed_thread;
+  double start = now();
+  pthread_create(&feed_thread, NULL, feed, &feeder);
+  pthread_join(feed_thread, NULL);
+  usleep(100000); // let the workers drain the ports
+  double elapsed = now() - start;
+  double cpu = 0.0;
+  for (unsigned i = 0; i < workers; i++)
+  {
+    cpu += thread_cpu(threads[i]);
+  }
+  stop = 1;
+  for (unsigned i = 0; i < workers; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  uint64_t frames = 0;
+  for (unsigned i = 0; i < port_count; i++)
+  {
+    frames += ports[i].frames;
+    char name[64];
+    snprintf(name, sizeof(name), "/cbmbench%u", i);
+    screen_publisher_close(&ports[i].publisher);
+    shm_unlink(name);
+  }
+  double load = cpu / elapsed;
+  printf("%u ports, %u workers: %llu of %llu frames decoded, %llu bytes behind, "
+         "workers %.1f%% of a core, feed %.1f%%, %.0f ports per core\n",
+    port_count, workers, (unsigned long long)frames, (unsigned long long)(feeder.sent / FRAME_BYTES),
+    (unsigned long long)feeder.behind, load * 100.0, feeder.cpu / elapsed * 100.0,
+    load > 0.0 ? port_count / load : 0.0);
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned workers = cores > 0 ? cores : 1;
+  const char* prefix = "cbm";
+  const char* session_file = NULL;
+  unsigned bench_ports = 0;
+  double seconds = 10.0;
+  int print_stats = 0;
+  const char* devices[MAX_PORTS];
+  unsigned device_count = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+    {
+      workers = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+    {
+      prefix = argv[++i];
+    }
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+    {
+      bench_ports = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      seconds = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+    {
+      session_file = argv[++i];
+    }
+    else if (strcmp(argv[i], "-s") == 0)
+    {
+      print_stats = 1;
+    }
+    else if (device_count < MAX_PORTS)
+    {
+      devices[device_count++] = argv[i];
+    }
+  }
+  if (workers < 1)
+  {
+    workers = 1;
+  }
+  if (workers > MAX_WORKERS)
+  {
+    workers = MAX_WORKERS;
+  }
+  epoll_fd = epoll_create1(0);
+  if (epoll_fd < 0)
+  {
+    perror("epoll");
+    return 1;
+  }
+  if (bench_ports > 0)
+  {
+    return benchmark(bench_ports, workers, seconds, session_file);
+  }
+  if (device_count == 0)
+  {
+    fprintf(stderr, "usage: screend [-j workers] [-m prefix] [-s] device ...\n"
+                    "       screend -b ports [-j workers] [-t seconds] [-f session file]\n");
+    return 2;
+  }
+
+  for (unsigned i = 0; i < device_count; i++)
+  {
+    if (open_port(&ports[port_count], devices[i], prefix, i) == 0)
+    {
+      port_count++;
+    }
+  }
+  if (port_count == 0)
+  {
+    return 1;
+  }
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  pthread_t threads[MAX_WORKERS];
+  for (unsigned i = 0; i < workers; i++)
+  {
+    pthread_create(&threads[i], NULL, worker, NULL);
+  }
+  double start = now();
+  double last_stats = start;
+  while (!stop)
+  {
+    usleep(200000);
+    if (print_stats && now() - last_stats >= STATS_INTERVAL)
+    {
+      print_ports(now() - start);
+      last_stats = now();
+    }
+  }
+  for (unsigned i = 0; i < workers; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  print_ports(now() - start);
+  for (unsigned i = 0; i < port_count; i++)
+  {
+    close(ports[i].fd);
+    if (ports[i].publishing)
+    {
+      screen_publisher_close(&ports[i].publisher);
+    }
+  }
+  return 0;
+}
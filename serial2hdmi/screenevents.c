@@ -0,0 +1,201 @@
+// screenevents emits the per-cell changes of the received screens, see events.h
+//
+// usage: screenevents [-r ring [-n capacity]] [device | session file]
+//        screenevents -w ring
+//
+// Without -r, the events are written to stdout as a binary stream, e.g.
+//   screenevents | python3 monitor.py
+// With -r, they go to the shared memory ring of that name instead.
+// -w prints the events of a ring as text, as an example consumer.
+// A session file (see session.h) is decoded as fast as it can be read,
+// which also measures the diff cost; the rate goes to stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include "receiver.h"
+#include "events.h"
+
+#define DEFAULT_DEVICE "/dev/ttyUSB0"
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int watch(const char* name)
+{
+  t_event_reader reader;
+  static t_screen_event events[4096];
+  if (event_reader_open(&reader, name) < 0)
+  {
+    return 1;
+  }
+  for (;;)
+  {
+    uint64_t lost;
+    unsigned count = event_ring_read(&reader, events, 4096, &lost);
+    if (lost > 0)
+    {
+      printf("lost %llu events\n", (unsigned long long)lost);
+    }
+    for (unsigned i = 0; i < count; i++)
+    {
+      if (events[i].row == EVENT_GRAPHIC)
+      {
+        printf("%8u graphic %u -> %u\n", events[i].frame, events[i].old_code, events[i].new_code);
+      }
+      else
+      {
+        printf("%8u %2u,%2u %02x -> %02x\n", events[i].frame, events[i].row, events[i].col,
+          events[i].old_code, events[i].new_code);
+      }
+    }
+    fflush(stdout);
+    if (count == 0)
+    {
+      usleep(20000); // one frame at 50 Hz
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  const char* ring_name = NULL;
+  uint32_t capacity = EVENT_RING_DEFAULT;
+  const char* source = DEFAULT_DEVICE;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+    {
+      return watch(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      ring_name = argv[++i];
+    }
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      capacity = strtoul(argv[++i], NULL, 10);
+    }
+    else
+    {
+      source = argv[i];
+    }
+  }
+
+  static t_event_stream stream;
+  if (ring_name != NULL)
+  {
+    if (event_stream_open_ring(&stream, ring_name, capacity) < 0)
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    event_stream_open_fd(&stream, fileno(stdout));
+    // a consumer that went away fails the write instead of ending the process
+    signal(SIGPIPE, SIG_IGN);
+  }
+
+  static unsigned char screens[2][SCREEN_SIZE];
+  unsigned char graphics[2] = { 1, 1 };
+  memset(screens[0], ' ', SCREEN_SIZE);
+  memcpy(screens[1], screens[0], SCREEN_SIZE);
+  unsigned current = 1;
+
+  struct stat st;
+  int is_file = stat(source, &st) == 0 && S_ISREG(st.st_mode);
+  FILE* fp = NULL;
+  int uart = -1;
+  if (is_file)
+  {
+    fp = fopen(source, "rb");
+  }
+  else
+  {
+    uart = open_uart(source);
+  }
+  if (fp == NULL && uart < 0)
+  {
+    perror(source);
+    return 1;
+  }
+
+  t_receiver_context context;
+  init_receiver_context(&context);
+  context.screen_buffer = screens[current];
+  context.graphic = &graphics[current];
+
+  uint32_t frame = 0;
+  unsigned long events = 0;
+  double start = now();
+  for (;;)
+  {
+    int received;
+    if (is_file)
+    {
+      int byte = fgetc(fp);
+      if (byte == EOF)
+      {
+        break;
+      }
+      received = handle_received_byte(&context, (unsigned char)byte);
+    }
+    else
+    {
+      received = receive_screen(uart, &context, screens[current], &graphics[current]);
+      if (received < 0)
+      {
+        break;
+      }
+      if (received == 0)
+      {
+        struct pollfd fds = { uart, POLLIN, 0 };
+        poll(&fds, 1, -1);
+        continue;
+      }
+    }
+    if (received)
+    {
+      unsigned previous = current ^ 1;
+      int count = event_stream_frame(&stream, frame, screens[previous], screens[current],
+        graphics[previous], graphics[current]);
+      if (count < 0)
+      {
+        break; // consumer went away
+      }
+      events += count;
+      frame++;
+      // the next screen is received on top of a copy of this one,
+      // incomplete frames leave the previous content in place
+      memcpy(screens[previous], screens[current], SCREEN_SIZE);
+      graphics[previous] = graphics[current];
+      current = previous;
+      context.screen_buffer = screens[current];
+      context.graphic = &graphics[current];
+    }
+  }
+
+  if (is_file)
+  {
+    double elapsed = now() - start;
+    fprintf(stderr, "%u frames, %lu events, %.0f frames/s\n", frame, events, frame / elapsed);
+    fclose(fp);
+  }
+  else
+  {
+    close(uart);
+  }
+  event_stream_close(&stream);
+  return 0;
+}
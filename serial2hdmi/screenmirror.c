@@ -0,0 +1,246 @@
+// screenmirror publishes the received screens to shared memory and reads
+// them back, see sharedscreen.h
+//
+// usage: screenmirror -p name [device | session file [frames per second]]
+//        screenmirror name
+//        screenmirror -b name [seconds]
+//
+// -p decodes the device (or a raw session file, paced at the given frame
+// rate, default 50, 0 for as fast as possible) and publishes every screen
+// under name, as serial2hdmi -m does. Without -p the published screen is
+// shown as text in the terminal whenever it changes, an example reader.
+// -b reads snapshots as fast as possible and reports the read rate, the
+// reads that raced with the writer and the age of the screens read.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "receiver.h"
+#include "sharedscreen.h"
+
+#define DEFAULT_DEVICE "/dev/ttyUSB0"
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t realtime_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// text shows screen codes as ASCII, reverse video and graphic
+// characters as they are
+static char text(unsigned char code)
+{
+  code &= 0x7F;
+  if (code == 0)
+  {
+    return '@';
+  }
+  if (code <= 26)
+  {
+    return 'A' + code - 1;
+  }
+  if (code >= 32 && code < 64)
+  {
+    return code;
+  }
+  return '#';
+}
+
+static int show(const char* name)
+{
+  t_screen_subscriber subscriber;
+  static t_screen_snapshot snapshot;
+  if (screen_subscriber_open(&subscriber, name) < 0)
+  {
+    return 1;
+  }
+  for (;;)
+  {
+    if (screen_snapshot(&subscriber, &snapshot) > 0)
+    {
+      printf("\033[H\033[2Jframe %llu, graphic %u\n", (unsigned long long)snapshot.frame, snapshot.flags[0]);
+      for (unsigned row = 0; row < SCREEN_ROWS; row++)
+      {
+        char line[SCREEN_COLS + 1];
+        for (unsigned col = 0; col < SCREEN_COLS; col++)
+        {
+          line[col] = text(snapshot.screen[row * SCREEN_COLS + col]);
+        }
+        line[SCREEN_COLS] = 0;
+        puts(line);
+      }
+      fflush(stdout);
+    }
+    usleep(20000); // one frame at 50 Hz
+  }
+  return 0;
+}
+
+static int benchmark(const char* name, double seconds)
+{
+  t_screen_subscriber subscriber;
+  static t_screen_snapshot snapshot;
+  if (screen_subscriber_open(&subscriber, name) < 0)
+  {
+    return 1;
+  }
+  unsigned long reads = 0;
+  unsigned long screens = 0;
+  unsigned long stuck = 0;
+  double age_sum = 0.0;
+  double age_max = 0.0;
+  double start = now();
+  double elapsed;
+  do
+  {
+    for (unsigned i = 0; i < 1000; i++)
+    {
+      int result = screen_snapshot(&subscriber, &snapshot);
+      reads++;
+      if (result > 0)
+      {
+        double age = (realtime_ns() - snapshot.time) * 1e-9;
+        screens++;
+        age_sum += age;
+        age_max = age > age_max ? age : age_max;
+      }
+      else if (result < 0)
+      {
+        stuck++;
+      }
+    }
+    elapsed = now() - start;
+  } while (elapsed < seconds);
+
+  printf("%.0f reads/s, %lu new screens, %lu retries, %lu gave up\n",
+    reads / elapsed, screens, subscriber.retries, stuck);
+  if (screens > 0)
+  {
+    printf("screen age when read: mean %.1f us, max %.1f us\n", age_sum / screens * 1e6, age_max * 1e6);
+  }
+  screen_subscriber_close(&subscriber);
+  return 0;
+}
+
+static int publish(const char* name, const char* source, double frame_rate)
+{
+  t_screen_publisher publisher;
+  if (screen_publisher_open(&publisher, name) < 0)
+  {
+    return 1;
+  }
+
+  struct stat st;
+  int is_file = stat(source, &st) == 0 && S_ISREG(st.st_mode);
+  FILE* fp = NULL;
+  int uart = -1;
+  if (is_file)
+  {
+    fp = fopen(source, "rb");
+  }
+  else
+  {
+    uart = open_uart(source);
+  }
+  if (fp == NULL && uart < 0)
+  {
+    perror(source);
+    screen_publisher_close(&publisher);
+    return 1;
+  }
+
+  static unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic = 1;
+  t_receiver_context context;
+  init_receiver_context(&context);
+  context.screen_buffer = screen;
+  context.graphic = &graphic;
+
+  uint64_t frame = 0;
+  double start = now();
+  for (;;)
+  {
+    int received;
+    if (is_file)
+    {
+      int byte = fgetc(fp);
+      if (byte == EOF)
+      {
+        break;
+      }
+      received = handle_received_byte(&context, (unsigned char)byte);
+      if (received && frame_rate > 0.0)
+      {
+        double wait = start + frame / frame_rate - now();
+        if (wait > 0.0)
+        {
+          usleep((useconds_t)(wait * 1e6));
+        }
+      }
+    }
+    else
+    {
+      received = receive_screen(uart, &context, screen, &graphic);
+      if (received < 0)
+      {
+        break;
+      }
+      if (received == 0)
+      {
+        struct pollfd fds = { uart, POLLIN, 0 };
+        poll(&fds, 1, -1);
+        continue;
+      }
+    }
+    if (received)
+    {
+      // the receive buffer still holds the flags buffer, the last of the frame
+      screen_publish(&publisher, frame++, realtime_ns(), context.buffer, screen);
+    }
+  }
+
+  if (is_file)
+  {
+    double elapsed = now() - start;
+    fprintf(stderr, "%llu frames, %.0f frames/s\n", (unsigned long long)frame, frame / elapsed);
+    fclose(fp);
+  }
+  else
+  {
+    close(uart);
+  }
+  screen_publisher_close(&publisher);
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc >= 3 && strcmp(argv[1], "-p") == 0)
+  {
+    return publish(argv[2], argc > 3 ? argv[3] : DEFAULT_DEVICE, argc > 4 ? atof(argv[4]) : 50.0);
+  }
+  if (argc >= 3 && strcmp(argv[1], "-b") == 0)
+  {
+    return benchmark(argv[2], argc > 3 ? atof(argv[3]) : 5.0);
+  }
+  if (argc == 2 && argv[1][0] != '-')
+  {
+    return show(argv[1]);
+  }
+  fprintf(stderr, "usage: screenmirror -p name [device | session file [frames per second]]\n"
+                  "       screenmirror name\n"
+                  "       screenmirror -b name [seconds]\n");
+  return 2;
+}
@@ -0,0 +1,700 @@
+// screenstream sends the decoded screens to viewers on the network, see
+// stream.h for the protocol and streamclient.c for a viewer
+//
+// usage: screenstream [-p port] -m name
+//        screenstream [-p port] session file
+//        screenstream -b viewers [-u] [-t seconds] [-p port] session file
+//
+// -m follows the screens published in the shared memory segment name by
+// serial2hdmi -m or screend, so the server doesn't need the UART. A
+// session file (raw or recording, see session.h) is played at 50 frames
+// per second in a loop instead, for trying out viewers.
+//
+// Every change is encoded once. TCP viewers get it with one writev each,
+// together with the rest of a record their socket didn't take before;
+// UDP viewers get it with sendmmsg, one call for up to UDP_BATCH viewers.
+//
+// -b measures the server's cost per viewer on loopback: it connects the
+// given number of TCP (or with -u UDP) viewers to itself, drains them in
+// a second thread, checks that the first viewer's screen matches the
+// server's at the end and reports the CPU time of the server thread as
+// viewers per core.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include "recording.h"
+#include "session.h"
+#include "sharedscreen.h"
+#include "stream.h"
+
+#define MAX_TCP_VIEWERS 1024
+#define MAX_UDP_VIEWERS 1024
+#define UDP_BATCH 256
+#define MAX_SESSION_FRAMES 15000
+#define SESSION_TICK 0.020 // 50 frames per second
+#define SHARED_TICK 0.005  // poll of the shared screen
+
+typedef struct {
+  int fd;
+  unsigned char pending[RECORD_MAX]; // rest of a record the socket didn't take
+  unsigned pending_offset;
+  unsigned pending_length;
+  int need_keyframe;
+} t_tcp_viewer;
+
+typedef struct {
+  struct sockaddr_in address;
+  double last_seen;
+  int need_keyframe;
+} t_udp_viewer;
+
+// the source of the screens
+static int shared;
+static t_screen_subscriber subscriber;
+static t_screen_snapshot snapshot;
+static unsigned char (*session_screens)[SCREEN_SIZE];
+static unsigned char* session_graphics;
+static unsigned session_count;
+static unsigned session_next = 0;
+
+static int tcp_listener;
+static int udp_socket;
+static t_tcp_viewer tcp_viewers[MAX_TCP_VIEWERS];
+static unsigned tcp_count = 0;
+static t_udp_viewer udp_viewers[MAX_UDP_VIEWERS];
+static unsigned udp_count = 0;
+
+// the screen the synced viewers have
+static unsigned char sent_screen[SCREEN_SIZE];
+static unsigned char sent_graphic = 1;
+static uint32_t sequence = 0;
+static double start_time;
+static double last_udp_keyframe = 0.0;
+static volatile sig_atomic_t stop = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double thread_cpu()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void handle_signal(int signal)
+{
+  stop = 1;
+}
+
+static void put_le32(unsigned char* p, uint32_t value)
+{
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = value >> 24;
+}
+
+static int open_sockets(unsigned short port)
+{
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  int on = 1;
+  tcp_listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  udp_socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (tcp_listener < 0 || udp_socket < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+  setsockopt(tcp_listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(tcp_listener, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+      listen(tcp_listener, 128) < 0 ||
+      bind(udp_socket, (struct sockaddr*)&address, sizeof(address)) < 0)
+  {
+    perror("bind");
+    return -1;
+  }
+  return 0;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void accept_viewers()
+{
+  for (;;)
+  {
+    int fd = accept4(tcp_listener, NULL, NULL, SOCK_NONBLOCK);
+    if (fd < 0)
+    {
+      return;
+    }
+    if (tcp_count == MAX_TCP_VIEWERS)
+    {
+      close(fd);
+      continue;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    t_tcp_viewer* viewer = &tcp_viewers[tcp_count++];
+    viewer->fd = fd;
+    memcpy(viewer->pending, STREAM_MAGIC, 8);
+    viewer->pending_offset = 0;
+    viewer->pending_length = 8;
+    viewer->need_keyframe = 1;
+  }
+}
+
+static void receive_requests()
+{
+  char message[16];
+  struct sockaddr_in address;
+  socklen_t length = sizeof(address);
+  ssize_t size;
+  while ((size = recvfrom(udp_socket, message, sizeof(message) - 1, 0, (struct sockaddr*)&address, &length)) > 0)
+  {
+    message[size] = 0;
+    unsigned i;
+    for (i = 0; i < udp_count; i++)
+    {
+      if (udp_viewers[i].address.sin_addr.s_addr == address.sin_addr.s_addr &&
+          udp_viewers[i].address.sin_port == address.sin_port)
+      {
+        break;
+      }
+    }
+    if (i == udp_count)
+    {
+      if (udp_count == MAX_UDP_VIEWERS || strcmp(message, STREAM_SUBSCRIBE) != 0)
+      {
+        continue;
+      }
+      udp_count++;
+      udp_viewers[i].address = address;
+      udp_viewers[i].need_keyframe = 1;
+    }
+    udp_viewers[i].last_seen = now();
+    if (strcmp(message, STREAM_KEYFRAME) == 0)
+    {
+      udp_viewers[i].need_keyframe = 1;
+    }
+    length = sizeof(address);
+  }
+}
+
+static void expire_udp_viewers(double time)
+{
+  for (unsigned i = 0; i < udp_count; )
+  {
+    if ((time - udp_viewers[i].last_seen) * 1000.0 > STREAM_UDP_TIMEOUT_MS)
+    {
+      udp_viewers[i] = udp_viewers[--udp_count];
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+
+// send_tcp passes the rest of the viewer's pending record and then record
+// (if not NULL) with one writev, returns 0 or -1 if the viewer is gone
+static int send_tcp(t_tcp_viewer* viewer, const unsigned char* record, unsigned length)
+{
+  struct iovec iov[2];
+  unsigned count = 0;
+  unsigned pending = viewer->pending_length - viewer->pending_offset;
+  if (pending > 0)
+  {
+    iov[count].iov_base = viewer->pending + viewer->pending_offset;
+    iov[count].iov_len = pending;
+    count++;
+  }
+  if (record != NULL)
+  {
+    iov[count].iov_base = (void*)record;
+    iov[count].iov_len = length;
+    count++;
+  }
+  if (count == 0)
+  {
+    return 0;
+  }
+  ssize_t written = writev(viewer->fd, iov, count);
+  if (written < 0)
+  {
+    if (errno != EAGAIN && errno != EINTR)
+    {
+      return -1;
+    }
+    written = 0;
+  }
+  if ((size_t)written < pending)
+  {
+    viewer->pending_offset += written;
+    if (record != NULL)
+    {
+      viewer->need_keyframe = 1; // the record didn't go out at all
+    }
+    return 0;
+  }
+  written -= pending;
+  viewer->pending_offset = viewer->pending_length = 0;
+  if (record != NULL && (size_t)written < length)
+  {
+    memcpy(viewer->pending, record + written, length - written);
+    viewer->pending_length = length - written;
+  }
+  return 0;
+}
+
+static struct mmsghdr messages[UDP_BATCH];
+
+// send_batch sends the first count messages, a datagram that doesn't fit
+// into the socket buffer is lost like on the network and the viewer asks
+// for a keyframe
+static void send_batch(unsigned count)
+{
+  unsigned sent = 0;
+  while (sent < count)
+  {
+    int result = sendmmsg(udp_socket, messages + sent, count - sent, 0);
+    sent += result > 0 ? result : 1;
+  }
+}
+
+// broadcast sends the change from the sent screen to screen to the synced
+// viewers and a keyframe to those that need one
+static void broadcast(const unsigned char* screen, unsigned char graphic, int changed)
+{
+  static unsigned char delta[RECORD_MAX];
+  static unsigned char keyframe[RECORD_MAX];
+  double time = now();
+  uint32_t record_time = (uint32_t)((time - start_time) * 1000.0);
+  unsigned delta_length = changed ? record_encode(sent_screen, sent_graphic, screen, graphic, record_time, delta) : 0;
+  if (delta_length > 0)
+  {
+    memcpy(sent_screen, screen, SCREEN_SIZE);
+    sent_graphic = graphic;
+    sequence++;
+  }
+  // encoded once, when the first viewer needs it
+  unsigned keyframe_length = 0;
+
+  for (unsigned i = 0; i < tcp_count; )
+  {
+    t_tcp_viewer* viewer = &tcp_viewers[i];
+    int result = 0;
+    if (viewer->need_keyframe)
+    {
+      if (keyframe_length == 0)
+      {
+        keyframe_length = record_encode(NULL, 0, sent_screen, sent_graphic, record_time, keyframe);
+      }
+      viewer->need_keyframe = 0;
+      result = send_tcp(viewer, keyframe, keyframe_length);
+    }
+    else if (delta_length > 0)
+    {
+      result = send_tcp(viewer, delta, delta_length);
+    }
+    else if (viewer->pending_offset < viewer->pending_length)
+    {
+      result = send_tcp(viewer, NULL, 0);
+    }
+    if (result < 0)
+    {
+      close(viewer->fd);
+      *viewer = tcp_viewers[--tcp_count];
+      continue;
+    }
+    i++;
+  }
+
+  if (udp_count == 0)
+  {
+    return;
+  }
+  if ((time - last_udp_keyframe) * 1000.0 >= STREAM_UDP_KEYFRAME_MS)
+  {
+    for (unsigned i = 0; i < udp_count; i++)
+    {
+      udp_viewers[i].need_keyframe = 1;
+    }
+    last_udp_keyframe = time;
+  }
+  static struct iovec iovs[UDP_BATCH][2];
+  unsigned char header[4];
+  put_le32(header, sequence);
+  unsigned batch = 0;
+  for (unsigned i = 0; i < udp_count; i++)
+  {
+    t_udp_viewer* viewer = &udp_viewers[i];
+    if (viewer->need_keyframe && keyframe_length == 0)
+    {
+      keyframe_length = record_encode(NULL, 0, sent_screen, sent_graphic, record_time, keyframe);
+    }
+    const unsigned char* record = viewer->need_keyframe ? keyframe : delta;
+    unsigned length = viewer->need_keyframe ? keyframe_length : delta_length;
+    if (length == 0)
+    {
+      continue;
+    }
+    viewer->need_keyframe = 0;
+    iovs[batch][0].iov_base = header;
+    iovs[batch][0].iov_len = 4;
+    iovs[batch][1].iov_base = (void*)record;
+    iovs[batch][1].iov_len = length;
+    memset(&messages[batch].msg_hdr, 0, sizeof(struct msghdr));
+    messages[batch].msg_hdr.msg_name = &viewer->address;
+    messages[batch].msg_hdr.msg_namelen = sizeof(viewer->address);
+    messages[batch].msg_hdr.msg_iov = iovs[batch];
+    messages[batch].msg_hdr.msg_iovlen = 2;
+    batch++;
+    if (batch == UDP_BATCH)
+    {
+      send_batch(batch);
+      batch = 0;
+    }
+  }
+  send_batch(batch);
+}
+
+// next_screen gets the source's screen for this tick, returns 1 if it
+// changed, 0 if not and -1 if the source is gone
+static int next_screen(unsigned char* screen, unsigned char* graphic)
+{
+  if (shared)
+  {
+    int result = screen_snapshot(&subscriber, &snapshot);
+    if (result <= 0)
+    {
+      return 0;
+    }
+    memcpy(screen, snapshot.screen, SCREEN_SIZE);
+    *graphic = snapshot.flags[0];
+  }
+  else
+  {
+    memcpy(screen, session_screens[session_next], SCREEN_SIZE);
+    *graphic = session_graphics[session_next];
+    session_next = (session_next + 1) % session_count;
+  }
+  return *graphic != sent_graphic || !screen_equal(screen, sent_screen);
+}
+
+// serve runs the server until stop is set or the time is up (if > 0)
+static void serve(double seconds)
+{
+  static unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic;
+  double tick = shared ? SHARED_TICK : SESSION_TICK;
+  double next_tick = now();
+  double end = seconds > 0.0 ? now() + seconds : 0.0;
+  memset(sent_screen, ' ', SCREEN_SIZE);
+  while (!stop && (end == 0.0 || now() < end))
+  {
+    double wait = next_tick - now();
+    if (wait > 0.0)
+    {
+      struct pollfd fds[2] = { { tcp_listener, POLLIN, 0 }, { udp_socket, POLLIN, 0 } };
+      poll(fds, 2, (int)(wait * 1000.0) + 1);
+    }
+    accept_viewers();
+    receive_requests();
+    if (now() < next_tick)
+    {
+      continue;
+    }
+    next_tick += tick;
+    if (now() > next_tick + 1.0)
+    {
+      next_tick = now(); // don't catch up after a stall
+    }
+    int changed = next_screen(screen, &graphic);
+    expire_udp_viewers(now());
+    broadcast(screen, graphic, changed);
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// loopback benchmark
+
+typedef struct {
+  int udp;
+  int fds[MAX_TCP_VIEWERS];
+  unsigned count;
+  uint64_t bytes;
+  // the first viewer's stream is decoded to check it
+  unsigned char buffer[2 * RECORD_MAX];
+  unsigned buffered;
+  unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic;
+  int synced;
+  uint32_t expected;
+  unsigned long records;
+  unsigned long gaps;
+} t_sink;
+
+static t_sink sink;
+
+static void decode_tcp(const unsigned char* data, size_t size)
+{
+  while (size > 0)
+  {
+    size_t take = sizeof(sink.buffer) - sink.buffered < size ? sizeof(sink.buffer) - sink.buffered : size;
+    memcpy(sink.buffer + sink.buffered, data, take);
+    sink.buffered += take;
+    data += take;
+    size -= take;
+    unsigned offset = 0;
+    if (!sink.synced && sink.buffered >= 8)
+    {
+      sink.synced = memcmp(sink.buffer, STREAM_MAGIC, 8) == 0;
+      offset = 8;
+    }
+    while (sink.buffered - offset >= 8)
+    {
+      unsigned length = 8 + (sink.buffer[offset + 2] | (sink.buffer[offset + 3] << 8));
+      if (sink.buffered - offset < length)
+      {
+        break;
+      }
+      uint32_t time;
+      if (!record_decode(sink.buffer + offset, length, sink.screen, &sink.graphic, &time))
+      {
+        sink.gaps++;
+      }
+      sink.records++;
+      offset += length;
+    }
+    memmove(sink.buffer, sink.buffer + offset, sink.buffered - offset);
+    sink.buffered -= offset;
+  }
+}
+
+static void decode_udp(const unsigned char* data, size_t size)
+{
+  uint32_t time;
+  if (size < 12)
+  {
+    return;
+  }
+  uint32_t number = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+  if (data[4] == RECORD_KEYFRAME)
+  {
+    sink.synced = record_decode(data + 4, size - 4, sink.screen, &sink.graphic, &time);
+    sink.expected = number + 1;
+  }
+  else if (sink.synced && number == sink.expected)
+  {
+    sink.synced = record_decode(data + 4, size - 4, sink.screen, &sink.graphic, &time);
+    sink.expected++;
+  }
+  else if (sink.synced)
+  {
+    sink.synced = 0;
+    sink.gaps++;
+    send(sink.fds[0], STREAM_KEYFRAME, strlen(STREAM_KEYFRAME), 0);
+  }
+  sink.records++;
+}
+
+static void* drain(void* arg)
+{
+  static unsigned char data[65536];
+  int epoll_fd = epoll_create1(0);
+  for (unsigned i = 0; i < sink.count; i++)
+  {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = i;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sink.fds[i], &event);
+  }
+  double last_subscribe = now();
+  while (!stop)
+  {
+    struct epoll_event events[64];
+    int count = epoll_wait(epoll_fd, events, 64, 100);
+    for (int e = 0; e < count; e++)
+    {
+      unsigned i = events[e].data.u32;
+      ssize_t size;
+      while ((size = recv(sink.fds[i], data, sizeof(data), MSG_DONTWAIT)) > 0)
+      {
+        __atomic_add_fetch(&sink.bytes, size, __ATOMIC_RELAXED);
+        if (i == 0)
+        {
+          sink.udp ? decode_udp(data, size) : decode_tcp(data, size);
+        }
+      }
+    }
+    if (sink.udp && now() - last_subscribe > STREAM_UDP_TIMEOUT_MS / 2000.0)
+    {
+      for (unsigned i = 0; i < sink.count; i++)
+      {
+        send(sink.fds[i], STREAM_SUBSCRIBE, strlen(STREAM_SUBSCRIBE), 0);
+      }
+      last_subscribe = now();
+    }
+  }
+  close(epoll_fd);
+  return NULL;
+}
+
+static int benchmark(unsigned viewers, int udp, double seconds, unsigned short port)
+{
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  if (viewers > MAX_TCP_VIEWERS)
+  {
+    viewers = MAX_TCP_VIEWERS;
+  }
+  sink.udp = udp;
+  for (unsigned i = 0; i < viewers; i++)
+  {
+    int fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+      perror("viewer");
+      return 1;
+    }
+    if (udp)
+    {
+      send(fd, STREAM_SUBSCRIBE, strlen(STREAM_SUBSCRIBE), 0);
+      receive_requests();
+    }
+    else
+    {
+      accept_viewers(); // before the listen backlog fills up
+    }
+    sink.fds[sink.count++] = fd;
+  }
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, drain, NULL);
+  double cpu = thread_cpu();
+  double wall = now();
+  serve(seconds);
+  cpu = thread_cpu() - cpu;
+  wall = now() - wall;
+  // the last records may still be on their way
+  usleep(200000);
+  stop = 1;
+  pthread_join(thread, NULL);
+
+  double load = cpu / wall;
+  printf("%u %s viewers: %.0f KB/s per viewer, server %.1f%% of a core, %.0f viewers per core\n",
+    viewers, udp ? "UDP" : "TCP", sink.bytes / 1024.0 / wall / viewers, load * 100.0,
+    load > 0.0 ? viewers / load : 0.0);
+  int match = sink.graphic == sent_graphic && memcmp(sink.screen, sent_screen, SCREEN_SIZE) == 0;
+  printf("first viewer: %lu records, %lu resyncs, screen %s\n", sink.records, sink.gaps,
+    match ? "matches" : "differs");
+  return match ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned short port = STREAM_PORT;
+  const char* shared_name = NULL;
+  const char* session_file = NULL;
+  unsigned bench_viewers = 0;
+  int udp = 0;
+  double seconds = 10.0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+    {
+      port = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+    {
+      shared_name = argv[++i];
+    }
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+    {
+      bench_viewers = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      seconds = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-u") == 0)
+    {
+      udp = 1;
+    }
+    else
+    {
+      session_file = argv[i];
+    }
+  }
+  if ((shared_name == NULL) == (session_file == NULL) || (bench_viewers > 0 && session_file == NULL))
+  {
+    fprintf(stderr, "usage: screenstream [-p port] -m name\n"
+                    "       screenstream [-p port] session file\n"
+                    "       screenstream -b viewers [-u] [-t seconds] [-p port] session file\n");
+    return 2;
+  }
+
+  if (shared_name != NULL)
+  {
+    shared = 1;
+    if (screen_subscriber_open(&subscriber, shared_name) < 0)
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    session_screens = malloc(MAX_SESSION_FRAMES * SCREEN_SIZE);
+    session_graphics = malloc(MAX_SESSION_FRAMES);
+    session_count = session_screens != NULL && session_graphics != NULL
+      ? load_session(session_file, session_screens, session_graphics, MAX_SESSION_FRAMES) : 0;
+    if (session_count == 0)
+    {
+      fprintf(stderr, "%s: no screens\n", session_file);
+      return 1;
+    }
+  }
+  if (open_sockets(port) < 0)
+  {
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+  start_time = now();
+
+  if (bench_viewers > 0)
+  {
+    return benchmark(bench_viewers, udp, seconds, port);
+  }
+  serve(0.0);
+  return 0;
+}
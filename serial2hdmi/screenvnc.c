@@ -0,0 +1,1295 @@
+// screenvnc serves the decoded screen to stock VNC viewers (RFB 3.3 to 3.8,
+// no authentication, view only)
+//
+// usage: screenvnc [-p port] [-r updates per second] -m name
+//        screenvnc [-p port] [-r updates per second] session file
+//        screenvnc -b clients [-e raw|hextile] [-t seconds] [-p port] session file
+//
+// The screens come from a shared memory segment (serial2hdmi -m, screend)
+// or a session file played at 50 frames per second in a loop, like
+// screenstream. The framebuffer is 1280x600, the glyphs of the software
+// glyph atlas.
+//
+// RFB is pulled: a client asks for an update and gets the cells that
+// changed since the screen it has, as rectangles of whole 16x24 cells,
+// one per run of changed cells in a row (at most MAX_RECT_CELLS wide). A
+// client that asks slowly or drains its socket slowly gets fewer, larger
+// updates without holding up the others; -r caps the update rate of every
+// client (default 50). A scroll is sent as one CopyRect if the client
+// supports it. Raw and Hextile are encoded straight from the glyphs,
+// Hextile tiles of each glyph are prepared once. Rectangles are encoded
+// into a fixed output buffer as the socket takes them, so a client needs
+// sizeof(t_client) (~75 KB) however large its updates are.
+//
+// -b connects the given number of viewers to the server on loopback, half
+// of them asking for updates as fast as they arrive and half at most 10
+// times per second, and reports the server CPU time per client. The first
+// viewer decodes its updates and must show the server's screen at the end.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include "screen.h"
+#include "session.h"
+#include "sharedscreen.h"
+#include "softglyphs.h"
+
+#define VNC_PORT 5900
+#define FRAME_WIDTH (SCREEN_COLS * SOFT_GLYPH_WIDTH)
+#define FRAME_HEIGHT (SCREEN_ROWS * SOFT_GLYPH_HEIGHT)
+#define FOREGROUND 0xFF40E030
+#define BACKGROUND 0xFF000000
+
+#define MAX_CLIENTS 256
+#define MAX_RECT_CELLS 16
+#define MAX_RECT_BYTES (12 + MAX_RECT_CELLS * SOFT_GLYPH_WIDTH * SOFT_GLYPH_HEIGHT * 4)
+#define OUTPUT_SIZE 65536
+#define INPUT_SIZE 1024
+#define MAX_SESSION_FRAMES 15000
+#define SESSION_TICK 0.020 // 50 frames per second
+#define SHARED_TICK 0.005  // poll of the shared screen
+#define LISTENER MAX_CLIENTS
+
+#define ENCODING_RAW 0
+#define ENCODING_COPYRECT 1
+#define ENCODING_HEXTILE 5
+
+#define HEXTILE_BACKGROUND 2
+#define HEXTILE_FOREGROUND 4
+#define HEXTILE_SUBRECTS 8
+#define HEXTILE_MAX_SUBRECTS 128
+
+enum { STATE_VERSION, STATE_SECURITY, STATE_INIT, STATE_NORMAL };
+
+// 32 bits per pixel, little endian, true colour, 8 bits each for red,
+// green and blue at 16, 8 and 0: the atlas pixels as they are
+static const unsigned char native_format[16] = { 32, 24, 0, 1, 0, 255, 0, 255, 0, 255, 16, 8, 0, 0, 0, 0 };
+
+typedef struct {
+  uint16_t position;
+  unsigned char cells;
+} t_rect;
+
+typedef struct {
+  int fd;
+  unsigned slot;
+  int state;
+  int minor; // protocol version 3.minor
+  int want_write;
+  unsigned char input[INPUT_SIZE];
+  unsigned input_length;
+  uint32_t skip; // rest of a cut text to ignore
+  unsigned char output[OUTPUT_SIZE];
+  unsigned output_offset;
+  unsigned output_length;
+  // as asked for by the client, taken over at the start of an update
+  unsigned char format[16];
+  int want_hextile;
+  int want_copyrect;
+  int requested;
+  int full;
+  double last_update;
+  // the update being sent
+  int native;
+  unsigned bytes_per_pixel;
+  int big_endian;
+  uint32_t foreground;
+  uint32_t background;
+  int hextile;
+  unsigned char screen[SCREEN_SIZE]; // what the client has once the update is through
+  unsigned char graphic;
+  int has_screen;
+  t_rect rects[SCREEN_SIZE];
+  unsigned rect_count;
+  unsigned rect_next;
+} t_client;
+
+typedef struct {
+  unsigned char count;
+  unsigned char subrects[2 * HEXTILE_MAX_SUBRECTS];
+} t_hextile;
+
+// the top 16 and the bottom 8 rows of every glyph as Hextile subrects
+static t_hextile hextiles[GLYPH_BANKS][256][2];
+
+// the source of the screens
+static int shared;
+static t_screen_subscriber subscriber;
+static t_screen_snapshot snapshot;
+static unsigned char (*session_screens)[SCREEN_SIZE];
+static unsigned char* session_graphics;
+static unsigned session_count;
+static unsigned session_next = 0;
+
+static unsigned char current_screen[SCREEN_SIZE];
+static unsigned char current_graphic = 1;
+
+static int listener;
+static int epoll_fd;
+static t_client* clients[MAX_CLIENTS];
+static double min_interval = 1.0 / 50;
+static volatile sig_atomic_t stop = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double thread_cpu()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void handle_signal(int signal)
+{
+  stop = 1;
+}
+
+static void put_be16(unsigned char* p, unsigned value)
+{
+  p[0] = value >> 8;
+  p[1] = value & 0xFF;
+}
+
+static void put_be32(unsigned char* p, uint32_t value)
+{
+  p[0] = value >> 24;
+  p[1] = (value >> 16) & 0xFF;
+  p[2] = (value >> 8) & 0xFF;
+  p[3] = value & 0xFF;
+}
+
+static unsigned get_be16(const unsigned char* p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static uint32_t get_be32(const unsigned char* p)
+{
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+//----------------------------------------------------------------------------------------
+// glyphs
+
+// prepare_hextiles splits the atlas glyphs into Hextile subrects, a run of
+// foreground pixels in a row is one subrect, as high as the identical rows
+// below it (the doubled ROM rows)
+static void prepare_hextiles()
+{
+  for (unsigned bank = 0; bank < GLYPH_BANKS; bank++)
+  {
+    for (unsigned code = 0; code < 256; code++)
+    {
+      const uint32_t* glyph = soft_glyph(bank, code);
+      for (unsigned tile = 0; tile < 2; tile++)
+      {
+        t_hextile* hextile = &hextiles[bank][code][tile];
+        unsigned top = tile * 16;
+        unsigned bottom = tile == 0 ? 16 : SOFT_GLYPH_HEIGHT;
+        hextile->count = 0;
+        for (unsigned y = top; y < bottom; )
+        {
+          const uint32_t* row = glyph + y * SOFT_GLYPH_WIDTH;
+          unsigned height = 1;
+          while (y + height < bottom &&
+                 memcmp(row, row + height * SOFT_GLYPH_WIDTH, SOFT_GLYPH_WIDTH * sizeof(uint32_t)) == 0)
+          {
+            height++;
+          }
+          for (unsigned x = 0; x < SOFT_GLYPH_WIDTH; )
+          {
+            if (row[x] != FOREGROUND)
+            {
+              x++;
+              continue;
+            }
+            unsigned width = 1;
+            while (x + width < SOFT_GLYPH_WIDTH && row[x + width] == FOREGROUND)
+            {
+              width++;
+            }
+            unsigned char* subrect = hextile->subrects + 2 * hextile->count++;
+            subrect[0] = (x << 4) | (y - top);
+            subrect[1] = ((width - 1) << 4) | (height - 1);
+            x += width;
+          }
+          y += height;
+        }
+      }
+    }
+  }
+}
+
+// client_pixel converts a 0xRRGGBB colour to a true colour pixel value
+static uint32_t client_pixel(const unsigned char* format, uint32_t rgb)
+{
+  uint32_t pixel = 0;
+  for (unsigned i = 0; i < 3; i++)
+  {
+    unsigned max = get_be16(format + 4 + 2 * i);
+    unsigned value = (rgb >> (16 - 8 * i)) & 0xFF;
+    pixel |= ((value * max + 127) / 255) << format[10 + i];
+  }
+  return pixel;
+}
+
+static unsigned char* put_pixel(const t_client* client, unsigned char* p, uint32_t pixel)
+{
+  for (unsigned i = 0; i < client->bytes_per_pixel; i++)
+  {
+    unsigned shift = client->big_endian ? 8 * (client->bytes_per_pixel - 1 - i) : 8 * i;
+    *p++ = (pixel >> shift) & 0xFF;
+  }
+  return p;
+}
+
+//----------------------------------------------------------------------------------------
+// updates
+
+static int append_output(t_client* client, const void* data, unsigned length)
+{
+  if (client->output_length + length > OUTPUT_SIZE)
+  {
+    return -1;
+  }
+  memcpy(client->output + client->output_length, data, length);
+  client->output_length += length;
+  return 0;
+}
+
+// add_runs adds the runs of consecutive positions as rects
+static void add_runs(t_client* client, const unsigned short* positions, unsigned count)
+{
+  for (unsigned i = 0; i < count; )
+  {
+    unsigned position = positions[i];
+    unsigned cells = 1;
+    while (i + cells < count && positions[i + cells] == position + cells &&
+           (position + cells) % SCREEN_COLS != 0 && cells < MAX_RECT_CELLS)
+    {
+      cells++;
+    }
+    client->rects[client->rect_count].position = position;
+    client->rects[client->rect_count].cells = cells;
+    client->rect_count++;
+    i += cells;
+  }
+}
+
+// begin_update starts an update from the screen the client has to the
+// current one, returns 0 if there is nothing to send
+static int begin_update(t_client* client)
+{
+  static unsigned short positions[SCREEN_SIZE];
+  int everything = client->full || !client->has_screen || client->graphic != current_graphic;
+  if (!everything && screen_equal(client->screen, current_screen))
+  {
+    return 0;
+  }
+
+  // the format and encodings asked for apply from this update on
+  // (the depth doesn't matter)
+  client->native = client->format[0] == native_format[0] &&
+                   memcmp(client->format + 2, native_format + 2, 11) == 0;
+  client->bytes_per_pixel = client->format[0] / 8;
+  client->big_endian = client->format[2] != 0;
+  client->hextile = client->want_hextile;
+  if (client->format[3])
+  {
+    client->foreground = client_pixel(client->format, FOREGROUND & 0xFFFFFF);
+    client->background = client_pixel(client->format, BACKGROUND & 0xFFFFFF);
+  }
+  else
+  {
+    // colour map: entry 0 is the background, 1 the foreground
+    unsigned char message[6 + 12] = { 1, 0, 0, 0, 0, 2 };
+    for (unsigned i = 0; i < 3; i++)
+    {
+      put_be16(message + 6 + 2 * i, ((BACKGROUND >> (16 - 8 * i)) & 0xFF) * 257);
+      put_be16(message + 12 + 2 * i, ((FOREGROUND >> (16 - 8 * i)) & 0xFF) * 257);
+    }
+    append_output(client, message, sizeof(message));
+    client->background = 0;
+    client->foreground = 1;
+  }
+
+  client->rect_count = 0;
+  client->rect_next = 0;
+  int scroll = 0;
+  if (everything)
+  {
+    for (unsigned i = 0; i < SCREEN_SIZE; i++)
+    {
+      positions[i] = i;
+    }
+    add_runs(client, positions, SCREEN_SIZE);
+  }
+  else
+  {
+    if (client->want_copyrect)
+    {
+      scroll = screen_detect_scroll(client->screen, current_screen);
+      // the rows that scroll in keep what they showed, like on the client
+      screen_shift_rows(client->screen, scroll, client->screen);
+    }
+    add_runs(client, positions, screen_diff(client->screen, current_screen, positions));
+  }
+
+  unsigned char header[4] = { 0, 0 };
+  put_be16(header + 2, client->rect_count + (scroll != 0));
+  append_output(client, header, sizeof(header));
+  if (scroll != 0)
+  {
+    unsigned rows = SCREEN_ROWS - (scroll < 0 ? -scroll : scroll);
+    unsigned char rect[16];
+    put_be16(rect, 0);
+    put_be16(rect + 2, scroll > 0 ? 0 : -scroll * SOFT_GLYPH_HEIGHT);
+    put_be16(rect + 4, FRAME_WIDTH);
+    put_be16(rect + 6, rows * SOFT_GLYPH_HEIGHT);
+    put_be32(rect + 8, ENCODING_COPYRECT);
+    put_be16(rect + 12, 0);
+    put_be16(rect + 14, scroll > 0 ? scroll * SOFT_GLYPH_HEIGHT : 0);
+    append_output(client, rect, sizeof(rect));
+  }
+  memcpy(client->screen, current_screen, SCREEN_SIZE);
+  client->graphic = current_graphic;
+  client->has_screen = 1;
+  client->requested = 0;
+  client->full = 0;
+  return 1;
+}
+
+static unsigned char* encode_raw(t_client* client, unsigned char* p, const t_rect* rect, unsigned bank)
+{
+  const unsigned char* codes = client->screen + rect->position;
+  for (unsigned y = 0; y < SOFT_GLYPH_HEIGHT; y++)
+  {
+    for (unsigned cell = 0; cell < rect->cells; cell++)
+    {
+      const uint32_t* row = soft_glyph(bank, codes[cell]) + y * SOFT_GLYPH_WIDTH;
+      if (client->native)
+      {
+        memcpy(p, row, SOFT_GLYPH_WIDTH * sizeof(uint32_t));
+        p += SOFT_GLYPH_WIDTH * sizeof(uint32_t);
+        continue;
+      }
+      for (unsigned x = 0; x < SOFT_GLYPH_WIDTH; x++)
+      {
+        p = put_pixel(client, p, row[x] == FOREGROUND ? client->foreground : client->background);
+      }
+    }
+  }
+  return p;
+}
+
+// encode_hextile writes the tiles of a rect, one per glyph half, the
+// colours only with the first tile as they carry over
+static unsigned char* encode_hextile(t_client* client, unsigned char* p, const t_rect* rect, unsigned bank)
+{
+  const unsigned char* codes = client->screen + rect->position;
+  int first = 1;
+  for (unsigned tile = 0; tile < 2; tile++)
+  {
+    for (unsigned cell = 0; cell < rect->cells; cell++)
+    {
+      const t_hextile* hextile = &hextiles[bank][codes[cell]][tile];
+      *p++ = (first ? HEXTILE_BACKGROUND | HEXTILE_FOREGROUND : 0) | (hextile->count > 0 ? HEXTILE_SUBRECTS : 0);
+      if (first)
+      {
+        p = put_pixel(client, p, client->background);
+        p = put_pixel(client, p, client->foreground);
+        first = 0;
+      }
+      if (hextile->count > 0)
+      {
+        *p++ = hextile->count;
+        memcpy(p, hextile->subrects, 2 * hextile->count);
+        p += 2 * hextile->count;
+      }
+    }
+  }
+  return p;
+}
+
+// fill_output encodes the next rects of the update while they surely fit
+static void fill_output(t_client* client)
+{
+  if (client->output_offset > 0)
+  {
+    memmove(client->output, client->output + client->output_offset, client->output_length - client->output_offset);
+    client->output_length -= client->output_offset;
+    client->output_offset = 0;
+  }
+  unsigned bank = GLYPH_BANK(client->graphic);
+  while (client->rect_next < client->rect_count && OUTPUT_SIZE - client->output_length >= MAX_RECT_BYTES)
+  {
+    const t_rect* rect = &client->rects[client->rect_next++];
+    unsigned char* p = client->output + client->output_length;
+    put_be16(p, (rect->position % SCREEN_COLS) * SOFT_GLYPH_WIDTH);
+    put_be16(p + 2, (rect->position / SCREEN_COLS) * SOFT_GLYPH_HEIGHT);
+    put_be16(p + 4, rect->cells * SOFT_GLYPH_WIDTH);
+    put_be16(p + 6, SOFT_GLYPH_HEIGHT);
+    put_be32(p + 8, client->hextile ? ENCODING_HEXTILE : ENCODING_RAW);
+    p += 12;
+    p = client->hextile ? encode_hextile(client, p, rect, bank) : encode_raw(client, p, rect, bank);
+    client->output_length = p - client->output;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// clients
+
+static void drop_client(unsigned slot)
+{
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, clients[slot]->fd, NULL);
+  close(clients[slot]->fd);
+  free(clients[slot]);
+  clients[slot] = NULL;
+}
+
+// service sends what the client's socket takes and starts the next update
+// when the last one is through, returns -1 if the client is gone
+static int service(t_client* client, double time)
+{
+  int want_write = 0;
+  for (;;)
+  {
+    fill_output(client);
+    if (client->output_offset < client->output_length)
+    {
+      ssize_t written = send(client->fd, client->output + client->output_offset,
+        client->output_length - client->output_offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (written < 0)
+      {
+        if (errno != EAGAIN && errno != EINTR)
+        {
+          return -1;
+        }
+        want_write = 1;
+        break;
+      }
+      client->output_offset += written;
+      continue;
+    }
+    if (client->rect_next < client->rect_count)
+    {
+      continue;
+    }
+    if (client->state != STATE_NORMAL || !client->requested ||
+        time - client->last_update < min_interval || !begin_update(client))
+    {
+      break;
+    }
+    client->last_update = time;
+  }
+  if (want_write != client->want_write)
+  {
+    struct epoll_event event;
+    event.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    event.data.u32 = client->slot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+    client->want_write = want_write;
+  }
+  return 0;
+}
+
+static void send_server_init(t_client* client)
+{
+  static const char name[] = "PET";
+  unsigned char message[24 + sizeof(name) - 1];
+  put_be16(message, FRAME_WIDTH);
+  put_be16(message + 2, FRAME_HEIGHT);
+  memcpy(message + 4, native_format, 16);
+  put_be32(message + 20, sizeof(name) - 1);
+  memcpy(message + 24, name, sizeof(name) - 1);
+  append_output(client, message, sizeof(message));
+}
+
+// handle_message handles the message at the start of data, returns its
+// length, 0 if it isn't complete yet or -1 if the client must go
+static int handle_message(t_client* client, const unsigned char* data, unsigned length)
+{
+  switch (client->state)
+  {
+    case STATE_VERSION:
+    {
+      if (length < 12)
+      {
+        return 0;
+      }
+      if (memcmp(data, "RFB 003.", 8) != 0)
+      {
+        return -1;
+      }
+      client->minor = atoi((const char*)data + 8);
+      if (client->minor >= 7)
+      {
+        // security types: None
+        append_output(client, "\001\001", 2);
+        client->state = STATE_SECURITY;
+      }
+      else
+      {
+        unsigned char security[4];
+        put_be32(security, 1);
+        append_output(client, security, 4);
+        client->state = STATE_INIT;
+      }
+      return 12;
+    }
+    case STATE_SECURITY:
+    {
+      if (length < 1)
+      {
+        return 0;
+      }
+      if (data[0] != 1)
+      {
+        return -1;
+      }
+      if (client->minor >= 8)
+      {
+        append_output(client, "\0\0\0\0", 4);
+      }
+      client->state = STATE_INIT;
+      return 1;
+    }
+    case STATE_INIT:
+    {
+      if (length < 1)
+      {
+        return 0;
+      }
+      // the shared flag doesn't matter, every client sees the same screen
+      send_server_init(client);
+      client->state = STATE_NORMAL;
+      return 1;
+    }
+  }
+
+  if (length < 1)
+  {
+    return 0;
+  }
+  switch (data[0])
+  {
+    case 0: // SetPixelFormat
+    {
+      if (length < 20)
+      {
+        return 0;
+      }
+      unsigned bits = data[4];
+      if (bits != 8 && bits != 16 && bits != 32)
+      {
+        return -1;
+      }
+      // client_pixel shifts the colour values into a pixel of bits
+      for (unsigned i = 0; data[7] && i < 3; i++)
+      {
+        if (get_be16(data + 8 + 2 * i) == 0 || data[14 + i] >= bits)
+        {
+          return -1;
+        }
+      }
+      memcpy(client->format, data + 4, 16);
+      return 20;
+    }
+    case 2: // SetEncodings
+    {
+      if (length < 4)
+      {
+        return 0;
+      }
+      unsigned count = get_be16(data + 2);
+      if (4 + 4 * count > INPUT_SIZE)
+      {
+        return -1;
+      }
+      if (length < 4 + 4 * count)
+      {
+        return 0;
+      }
+      // the first of Raw and Hextile in the client's order of preference
+      int chosen = 0;
+      client->want_hextile = 0;
+      client->want_copyrect = 0;
+      for (unsigned i = 0; i < count; i++)
+      {
+        int32_t encoding = (int32_t)get_be32(data + 4 + 4 * i);
+        if (!chosen && (encoding == ENCODING_RAW || encoding == ENCODING_HEXTILE))
+        {
+          client->want_hextile = encoding == ENCODING_HEXTILE;
+          chosen = 1;
+        }
+        if (encoding == ENCODING_COPYRECT)
+        {
+          client->want_copyrect = 1;
+        }
+      }
+      return 4 + 4 * count;
+    }
+    case 3: // FramebufferUpdateRequest, always for the whole framebuffer
+    {
+      if (length < 10)
+      {
+        return 0;
+      }
+      client->requested = 1;
+      if (!data[1])
+      {
+        client->full = 1;
+      }
+      return 10;
+    }
+    case 4: // KeyEvent, the view is read only
+      return length < 8 ? 0 : 8;
+    case 5: // PointerEvent
+      return length < 6 ? 0 : 6;
+    case 6: // ClientCutText
+    {
+      if (length < 8)
+      {
+        return 0;
+      }
+      client->skip = get_be32(data + 4);
+      return 8;
+    }
+  }
+  return -1;
+}
+
+// read_input reads and handles the client's messages, returns -1 if the
+// client is gone
+static int read_input(t_client* client)
+{
+  for (;;)
+  {
+    ssize_t size = recv(client->fd, client->input + client->input_length,
+      INPUT_SIZE - client->input_length, MSG_DONTWAIT);
+    if (size == 0)
+    {
+      return -1;
+    }
+    if (size < 0)
+    {
+      return errno == EAGAIN || errno == EINTR ? 0 : -1;
+    }
+    client->input_length += size;
+    unsigned offset = 0;
+    for (;;)
+    {
+      if (client->skip > 0)
+      {
+        unsigned skip = client->input_length - offset < client->skip ? client->input_length - offset : client->skip;
+        client->skip -= skip;
+        offset += skip;
+      }
+      int used = handle_message(client, client->input + offset, client->input_length - offset);
+      if (used < 0)
+      {
+        return -1;
+      }
+      if (used == 0)
+      {
+        break;
+      }
+      offset += used;
+    }
+    memmove(client->input, client->input + offset, client->input_length - offset);
+    client->input_length -= offset;
+  }
+}
+
+static void accept_clients()
+{
+  for (;;)
+  {
+    int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+    if (fd < 0)
+    {
+      return;
+    }
+    unsigned slot = 0;
+    while (slot < MAX_CLIENTS && clients[slot] != NULL)
+    {
+      slot++;
+    }
+    t_client* client = slot < MAX_CLIENTS ? malloc(sizeof(t_client)) : NULL;
+    if (client == NULL)
+    {
+      close(fd);
+      continue;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    // the screen and the rects are large and written before they are read,
+    // the fields after them are not, the chunk may be a dropped client's
+    memset(client, 0, offsetof(t_client, screen));
+    client->graphic = 0;
+    client->has_screen = 0;
+    client->rect_count = 0;
+    client->rect_next = 0;
+    client->fd = fd;
+    client->slot = slot;
+    client->state = STATE_VERSION;
+    memcpy(client->format, native_format, 16);
+    append_output(client, "RFB 003.008\n", 12);
+    clients[slot] = client;
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = slot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    if (service(client, now()) < 0)
+    {
+      drop_client(slot);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// server
+
+static int open_listener(unsigned short port)
+{
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  int on = 1;
+  listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (listener < 0)
+  {
+    perror("socket");
+    return -1;
+  }
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 128) < 0)
+  {
+    perror("bind");
+    return -1;
+  }
+  epoll_fd = epoll_create1(0);
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u32 = LISTENER;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &event);
+  return 0;
+}
+
+// next_screen takes the source's screen for this tick into the current one
+static void next_screen()
+{
+  if (shared)
+  {
+    if (screen_snapshot(&subscriber, &snapshot) > 0)
+    {
+      memcpy(current_screen, snapshot.screen, SCREEN_SIZE);
+      current_graphic = snapshot.flags[0];
+    }
+  }
+  else
+  {
+    memcpy(current_screen, session_screens[session_next], SCREEN_SIZE);
+    current_graphic = session_graphics[session_next];
+    session_next = (session_next + 1) % session_count;
+  }
+}
+
+// serve runs the server until stop is set or the time is up (if > 0),
+// taking a new screen every tick unless frozen
+static void serve(double seconds, int frozen)
+{
+  double tick = shared ? SHARED_TICK : SESSION_TICK;
+  double next_tick = now();
+  double end = seconds > 0.0 ? now() + seconds : 0.0;
+  while (!stop && (end == 0.0 || now() < end))
+  {
+    struct epoll_event events[64];
+    double wait = next_tick - now();
+    int count = epoll_wait(epoll_fd, events, 64, wait > 0.0 ? (int)(wait * 1000.0) + 1 : 0);
+    double time = now();
+    for (int e = 0; e < count; e++)
+    {
+      unsigned slot = events[e].data.u32;
+      if (slot == LISTENER)
+      {
+        accept_clients();
+        continue;
+      }
+      if (clients[slot] == NULL)
+      {
+        continue;
+      }
+      if (((events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && read_input(clients[slot]) < 0) ||
+          service(clients[slot], time) < 0)
+      {
+        drop_client(slot);
+      }
+    }
+    if (time < next_tick)
+    {
+      continue;
+    }
+    next_tick += tick;
+    if (time > next_tick + 1.0)
+    {
+      next_tick = time; // don't catch up after a stall
+    }
+    if (!frozen)
+    {
+      next_screen();
+    }
+    // clients waiting for a change or for their next update slot
+    for (unsigned slot = 0; slot < MAX_CLIENTS; slot++)
+    {
+      if (clients[slot] != NULL && service(clients[slot], time) < 0)
+      {
+        drop_client(slot);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// loopback benchmark
+
+#define VIEWER_BUFFER (2 * MAX_RECT_BYTES)
+
+typedef struct {
+  int fd;
+  int slow;
+  unsigned char buffer[VIEWER_BUFFER];
+  unsigned length;
+  unsigned rects_left;
+  int in_update;
+  double request_at; // 0 if not due
+  unsigned long updates;
+} t_viewer;
+
+static t_viewer* viewers;
+static unsigned viewer_count;
+static int viewer_hextile;
+static uint64_t viewer_bytes = 0;
+static uint32_t* viewer_frame; // the first viewer's framebuffer
+
+static int recv_exact(int fd, void* data, size_t length)
+{
+  size_t done = 0;
+  while (done < length)
+  {
+    ssize_t size = recv(fd, (char*)data + done, length - done, 0);
+    if (size <= 0)
+    {
+      return -1;
+    }
+    done += size;
+  }
+  return 0;
+}
+
+static int viewer_handshake(t_viewer* viewer)
+{
+  unsigned char data[64];
+  if (recv_exact(viewer->fd, data, 12) < 0 || memcmp(data, "RFB 003.008\n", 12) != 0)
+  {
+    return -1;
+  }
+  send(viewer->fd, "RFB 003.008\n", 12, 0);
+  if (recv_exact(viewer->fd, data, 2) < 0 || data[0] != 1 || data[1] != 1)
+  {
+    return -1;
+  }
+  send(viewer->fd, "\001", 1, 0);
+  if (recv_exact(viewer->fd, data, 4) < 0 || get_be32(data) != 0)
+  {
+    return -1;
+  }
+  send(viewer->fd, "\001", 1, 0);
+  if (recv_exact(viewer->fd, data, 24) < 0 || get_be32(data + 20) > 40 ||
+      recv_exact(viewer->fd, data + 24, get_be32(data + 20)) < 0)
+  {
+    return -1;
+  }
+  unsigned char encodings[4 + 3 * 4] = { 2, 0, 0, 3 };
+  put_be32(encodings + 4, ENCODING_COPYRECT);
+  put_be32(encodings + 8, viewer_hextile ? ENCODING_HEXTILE : ENCODING_RAW);
+  put_be32(encodings + 12, ENCODING_RAW);
+  send(viewer->fd, encodings, sizeof(encodings), 0);
+  unsigned char request[10] = { 3, 0 };
+  put_be16(request + 6, FRAME_WIDTH);
+  put_be16(request + 8, FRAME_HEIGHT);
+  send(viewer->fd, request, sizeof(request), 0);
+  return 0;
+}
+
+static void fill_frame(int x, int y, int w, int h, uint32_t pixel)
+{
+  for (int row = y; row < y + h; row++)
+  {
+    for (int col = x; col < x + w; col++)
+    {
+      viewer_frame[row * FRAME_WIDTH + col] = pixel;
+    }
+  }
+}
+
+// decode_rect returns the length of the rect at data, 0 if it isn't
+// complete yet, and draws it into frame if not NULL
+static unsigned decode_rect(const unsigned char* data, unsigned length, uint32_t* frame)
+{
+  if (length < 12)
+  {
+    return 0;
+  }
+  unsigned x = get_be16(data), y = get_be16(data + 2), w = get_be16(data + 4), h = get_be16(data + 6);
+  int32_t encoding = (int32_t)get_be32(data + 8);
+  unsigned offset = 12;
+  if (encoding == ENCODING_COPYRECT)
+  {
+    if (length < 16)
+    {
+      return 0;
+    }
+    unsigned source_y = get_be16(data + 14);
+    if (frame != NULL)
+    {
+      memmove(frame + y * FRAME_WIDTH + x, frame + source_y * FRAME_WIDTH + get_be16(data + 12),
+        (h * FRAME_WIDTH - (FRAME_WIDTH - w)) * sizeof(uint32_t)); // whole rows
+    }
+    return 16;
+  }
+  if (encoding == ENCODING_RAW)
+  {
+    unsigned size = offset + w * h * 4;
+    if (length < size)
+    {
+      return 0;
+    }
+    for (unsigned row = 0; frame != NULL && row < h; row++)
+    {
+      memcpy(frame + (y + row) * FRAME_WIDTH + x, data + offset + row * w * 4, w * 4);
+    }
+    return size;
+  }
+  // Hextile
+  uint32_t background = 0, foreground = 0;
+  for (unsigned ty = 0; ty < h; ty += 16)
+  {
+    for (unsigned tx = 0; tx < w; tx += 16)
+    {
+      unsigned tw = w - tx < 16 ? w - tx : 16, th = h - ty < 16 ? h - ty : 16;
+      if (length < offset + 1)
+      {
+        return 0;
+      }
+      unsigned subencoding = data[offset++];
+      if (subencoding & HEXTILE_BACKGROUND)
+      {
+        if (length < offset + 4)
+        {
+          return 0;
+        }
+        memcpy(&background, data + offset, 4);
+        offset += 4;
+      }
+      if (subencoding & HEXTILE_FOREGROUND)
+      {
+        if (length < offset + 4)
+        {
+          return 0;
+        }
+        memcpy(&foreground, data + offset, 4);
+        offset += 4;
+      }
+      if (frame != NULL)
+      {
+        fill_frame(x + tx, y + ty, tw, th, background);
+      }
+      if (subencoding & HEXTILE_SUBRECTS)
+      {
+        if (length < offset + 1 || length < offset + 1 + 2 * data[offset])
+        {
+          return 0;
+        }
+        unsigned count = data[offset++];
+        for (unsigned i = 0; frame != NULL && i < count; i++)
+        {
+          const unsigned char* subrect = data + offset + 2 * i;
+          fill_frame(x + tx + (subrect[0] >> 4), y + ty + (subrect[0] & 15),
+            (subrect[1] >> 4) + 1, (subrect[1] & 15) + 1, foreground);
+        }
+        offset += 2 * count;
+      }
+    }
+  }
+  return offset;
+}
+
+static void request_update(t_viewer* viewer)
+{
+  unsigned char request[10] = { 3, 1 };
+  put_be16(request + 6, FRAME_WIDTH);
+  put_be16(request + 8, FRAME_HEIGHT);
+  send(viewer->fd, request, sizeof(request), MSG_NOSIGNAL);
+  viewer->request_at = 0.0;
+}
+
+static void viewer_receive(t_viewer* viewer, int first)
+{
+  for (;;)
+  {
+    ssize_t size = recv(viewer->fd, viewer->buffer + viewer->length, VIEWER_BUFFER - viewer->length, MSG_DONTWAIT);
+    if (size <= 0)
+    {
+      return;
+    }
+    __atomic_add_fetch(&viewer_bytes, size, __ATOMIC_RELAXED);
+    viewer->length += size;
+    unsigned offset = 0;
+    for (;;)
+    {
+      if (!viewer->in_update)
+      {
+        if (viewer->length - offset < 4)
+        {
+          break;
+        }
+        viewer->rects_left = get_be16(viewer->buffer + offset + 2);
+        viewer->in_update = 1;
+        offset += 4;
+      }
+      else if (viewer->rects_left > 0)
+      {
+        unsigned used = decode_rect(viewer->buffer + offset, viewer->length - offset, first ? viewer_frame : NULL);
+        if (used == 0)
+        {
+          break;
+        }
+        offset += used;
+        viewer->rects_left--;
+      }
+      if (viewer->in_update && viewer->rects_left == 0)
+      {
+        viewer->in_update = 0;
+        viewer->updates++;
+        if (viewer->slow)
+        {
+          viewer->request_at = now() + 0.1;
+        }
+        else
+        {
+          request_update(viewer);
+        }
+      }
+    }
+    memmove(viewer->buffer, viewer->buffer + offset, viewer->length - offset);
+    viewer->length -= offset;
+  }
+}
+
+static void* drive_viewers(void* arg)
+{
+  int viewer_epoll = epoll_create1(0);
+  for (unsigned i = 0; i < viewer_count; i++)
+  {
+    if (viewer_handshake(&viewers[i]) < 0)
+    {
+      fprintf(stderr, "viewer %u: handshake failed\n", i);
+      stop = 1;
+      return NULL;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = i;
+    epoll_ctl(viewer_epoll, EPOLL_CTL_ADD, viewers[i].fd, &event);
+  }
+  while (!stop)
+  {
+    struct epoll_event events[64];
+    int count = epoll_wait(viewer_epoll, events, 64, 10);
+    for (int e = 0; e < count; e++)
+    {
+      unsigned i = events[e].data.u32;
+      viewer_receive(&viewers[i], i == 0);
+    }
+    double time = now();
+    for (unsigned i = 0; i < viewer_count; i++)
+    {
+      if (viewers[i].request_at != 0.0 && time >= viewers[i].request_at)
+      {
+        request_update(&viewers[i]);
+      }
+    }
+  }
+  close(viewer_epoll);
+  return NULL;
+}
+
+static int benchmark(unsigned count, double seconds, unsigned short port)
+{
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  viewer_count = count < MAX_CLIENTS ? count : MAX_CLIENTS;
+  viewers = calloc(viewer_count, sizeof(t_viewer));
+  viewer_frame = calloc(FRAME_WIDTH * FRAME_HEIGHT, sizeof(uint32_t));
+  for (unsigned i = 0; i < viewer_count; i++)
+  {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+      perror("viewer");
+      return 1;
+    }
+    accept_clients();
+    viewers[i].fd = fd;
+    viewers[i].slow = i % 2;
+  }
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, drive_viewers, NULL);
+  double cpu = thread_cpu();
+  double wall = now();
+  serve(seconds, 0);
+  cpu = thread_cpu() - cpu;
+  wall = now() - wall;
+  // the last updates go out and the first viewer catches up
+  serve(0.5, 1);
+  stop = 1;
+  pthread_join(thread, NULL);
+
+  unsigned long fast = 0, slow = 0;
+  for (unsigned i = 0; i < viewer_count; i++)
+  {
+    *(viewers[i].slow ? &slow : &fast) += viewers[i].updates;
+  }
+  double load = cpu / wall;
+  printf("%u %s clients: %.0f KB/s per client, server %.1f%% of a core, %.0f clients per core, %u KB per client\n",
+    viewer_count, viewer_hextile ? "Hextile" : "Raw", viewer_bytes / 1024.0 / wall / viewer_count,
+    load * 100.0, load > 0.0 ? viewer_count / load : 0.0, (unsigned)(sizeof(t_client) / 1024));
+  printf("updates per second per client: %.1f fast, %.1f slow\n",
+    fast / wall / ((viewer_count + 1) / 2), viewer_count > 1 ? slow / wall / (viewer_count / 2) : 0.0);
+
+  uint32_t* expected = malloc(FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint32_t));
+  for (unsigned i = 0; i < SCREEN_SIZE; i++)
+  {
+    soft_glyphs_draw_cell(expected, FRAME_WIDTH, i / SCREEN_COLS, i % SCREEN_COLS,
+      GLYPH_BANK(current_graphic), current_screen[i]);
+  }
+  int match = 1;
+  for (unsigned i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++)
+  {
+    match &= (expected[i] & 0xFFFFFF) == (viewer_frame[i] & 0xFFFFFF);
+  }
+  printf("first viewer: %lu updates, framebuffer %s\n", viewers[0].updates, match ? "matches" : "differs");
+  return match ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned short port = VNC_PORT;
+  const char* shared_name = NULL;
+  const char* session_file = NULL;
+  unsigned bench_clients = 0;
+  double seconds = 10.0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+    {
+      port = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+    {
+      shared_name = argv[++i];
+    }
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      double rate = atof(argv[++i]);
+      min_interval = rate > 0.0 ? 1.0 / rate : 0.0;
+    }
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+    {
+      bench_clients = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+    {
+      viewer_hextile = strcmp(argv[++i], "hextile") == 0;
+    }
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      seconds = atof(argv[++i]);
+    }
+    else
+    {
+      session_file = argv[i];
+    }
+  }
+  if ((shared_name == NULL) == (session_file == NULL) || (bench_clients > 0 && session_file == NULL))
+  {
+    fprintf(stderr, "usage: screenvnc [-p port] [-r updates per second] -m name\n"
+                    "       screenvnc [-p port] [-r updates per second] session file\n"
+                    "       screenvnc -b clients [-e raw|hextile] [-t seconds] [-p port] session file\n");
+    return 2;
+  }
+
+  if (shared_name != NULL)
+  {
+    shared = 1;
+    if (screen_subscriber_open(&subscriber, shared_name) < 0)
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    session_screens = malloc(MAX_SESSION_FRAMES * SCREEN_SIZE);
+    session_graphics = malloc(MAX_SESSION_FRAMES);
+    session_count = session_screens != NULL && session_graphics != NULL
+      ? load_session(session_file, session_screens, session_graphics, MAX_SESSION_FRAMES) : 0;
+    if (session_count == 0)
+    {
+      fprintf(stderr, "%s: no screens\n", session_file);
+      return 1;
+    }
+  }
+  memset(current_screen, ' ', SCREEN_SIZE);
+  soft_glyphs_init(FOREGROUND, BACKGROUND);
+  prepare_hextiles();
+  if (open_listener(port) < 0)
+  {
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  if (bench_clients > 0)
+  {
+    return benchmark(bench_clients, seconds, port);
+  }
+  serve(0.0, 0);
+  return 0;
+}
@@ -0,0 +1,154 @@
+// scrollbench measures what the receive path of serial2hdmi draws for a
+// session, redrawing every changed screen or moving scrolled ones, on hosts
+// without OpenVG
+//
+// usage: scrollbench session file ...
+//
+// The session (see session.h) is presented like receiveLoop does: screens
+// equal to the previous one are not drawn. full draws all 2000 cells of
+// every drawn screen. scroll follows drawChangedScreen: if the screen
+// scrolled against the one drawn before with the same graphic flag (see
+// screen_detect_scroll), the frame is moved and the rows that scrolled in
+// plus the cells that differ otherwise are drawn, any other screen is drawn
+// in full. The cells are drawn with the software glyph atlas into a
+// 1280x600 frame in memory and the move is a memmove, standing in for
+// vgDrawImage and vgCopyPixels; the draw times are those of the CPU, the
+// cells per screen carry over to the GPU. displaytest measures the same
+// on the Pi. E.g. for the LIST session:
+//   recordtool generate list 30000 list.bin && scrollbench list.bin
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "softglyphs.h"
+#include "session.h"
+
+#define FRAME_WIDTH  (SCREEN_COLS * SOFT_GLYPH_WIDTH)
+#define FRAME_HEIGHT (SCREEN_ROWS * SOFT_GLYPH_HEIGHT)
+#define ROW_PIXELS   (FRAME_WIDTH * SOFT_GLYPH_HEIGHT)
+#define MAX_SCREENS  40000
+
+#define FOREGROUND 0xFF40E030
+#define BACKGROUND 0xFF000000
+
+static unsigned char (*screens)[SCREEN_SIZE];
+static unsigned char* graphics;
+static uint32_t* frame;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned draw_full(const unsigned char* screen, unsigned bank)
+{
+  for (unsigned i = 0; i < SCREEN_SIZE; i++)
+  {
+    soft_glyphs_draw_cell(frame, FRAME_WIDTH, i / SCREEN_COLS, i % SCREEN_COLS, bank, screen[i]);
+  }
+  return SCREEN_SIZE;
+}
+
+// draw_scrolled moves the frame by scroll rows and draws the cells that
+// differ from the moved previous screen, like drawScrolledGlyphs
+static unsigned draw_scrolled(const unsigned char* screen, const unsigned char* previous, int scroll, unsigned bank)
+{
+  static unsigned char shifted[SCREEN_SIZE];
+  unsigned scrolled = scroll < 0 ? -scroll : scroll;
+  size_t moved = (SCREEN_ROWS - scrolled) * ROW_PIXELS * sizeof(uint32_t);
+  if (scroll > 0)
+  {
+    memmove(frame, frame + scrolled * ROW_PIXELS, moved);
+  }
+  else
+  {
+    memmove(frame + scrolled * ROW_PIXELS, frame, moved);
+  }
+  screen_shift_rows(previous, scroll, shifted);
+  unsigned first = scroll > 0 ? SCREEN_ROWS - scrolled : 0;
+  for (unsigned i = first * SCREEN_COLS; i < (first + scrolled) * SCREEN_COLS; i++)
+  {
+    shifted[i] = (unsigned char)~screen[i];
+  }
+  unsigned cells = 0;
+  for (unsigned i = 0; i < SCREEN_SIZE; i++)
+  {
+    if (shifted[i] != screen[i])
+    {
+      soft_glyphs_draw_cell(frame, FRAME_WIDTH, i / SCREEN_COLS, i % SCREEN_COLS, bank, screen[i]);
+      cells++;
+    }
+  }
+  return cells;
+}
+
+static void run(const char* session, unsigned count, int scrolling)
+{
+  unsigned drawn = 0;
+  unsigned scrolls = 0;
+  unsigned long cells = 0;
+  double total = 0.0;
+  double max = 0.0;
+  int shown = -1; // the screen drawn last
+  for (unsigned i = 0; i < count; i++)
+  {
+    if (shown >= 0 && graphics[i] == graphics[shown] && screen_equal(screens[i], screens[shown]))
+    {
+      continue;
+    }
+    double start = now();
+    int scroll = scrolling && shown >= 0 && graphics[i] == graphics[shown]
+      ? screen_detect_scroll(screens[shown], screens[i]) : 0;
+    if (scroll != 0)
+    {
+      cells += draw_scrolled(screens[i], screens[shown], scroll, GLYPH_BANK(graphics[i]));
+      scrolls++;
+    }
+    else
+    {
+      cells += draw_full(screens[i], GLYPH_BANK(graphics[i]));
+    }
+    double elapsed = now() - start;
+    total += elapsed;
+    max = elapsed > max ? elapsed : max;
+    drawn++;
+    shown = i;
+  }
+  printf("%s,%s,%u,%u,%.0f,%.1f,%.1f\n", session, scrolling ? "scroll" : "full", drawn, scrolls,
+    drawn > 0 ? (double)cells / drawn : 0.0, drawn > 0 ? total / drawn * 1e6 : 0.0, max * 1e6);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: scrollbench session file ...\n");
+    return 2;
+  }
+  screens = malloc(MAX_SCREENS * SCREEN_SIZE);
+  graphics = malloc(MAX_SCREENS);
+  frame = calloc(FRAME_WIDTH * FRAME_HEIGHT, sizeof(uint32_t));
+  if (screens == NULL || graphics == NULL || frame == NULL)
+  {
+    perror("scrollbench");
+    return 1;
+  }
+  soft_glyphs_init(FOREGROUND, BACKGROUND);
+
+  printf("session,strategy,screens_drawn,scrolled,cells_per_screen,us_per_screen,max_us\n");
+  for (int i = 1; i < argc; i++)
+  {
+    unsigned count = load_session(argv[i], screens, graphics, MAX_SCREENS);
+    if (count == 0)
+    {
+      fprintf(stderr, "%s: no screens\n", argv[i]);
+      continue;
+    }
+    run(argv[i], count, 0);
+    run(argv[i], count, 1);
+  }
+  return 0;
+}
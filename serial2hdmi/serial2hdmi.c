@@ -3,52 +3,22 @@
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include "VG/openvg.h"
 #include "VG/vgu.h"
 #include "graphics.h"
+#include "glyphs.h"
+#include "receiver.h"
+#include "pacing.h"
+#include "recording.h"
+#include "archive.h"
+#include "sharedscreen.h"
+#include "tiles.h"
+#include "framepattern.h"
 
-#define PET_GLYPH_WIDTH  16
-#define PET_GLYPH_HEIGHT 24
-#define PET_IMAGE_WIDTH  (16 * PET_GLYPH_WIDTH)
-#define PET_IMAGE_HEIGHT (16 * PET_GLYPH_HEIGHT)
-
-// PETSCII image contains glyphs in ROM index order
-extern unsigned char petSciiImageData[(PET_IMAGE_WIDTH / 8) * PET_IMAGE_HEIGHT];
-
-VGImage makePetSciiImage() {
-  unsigned int dstride = PET_IMAGE_WIDTH / 8;
-  VGImage imgTemp = vgCreateImage(VG_sABGR_8888, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, VG_IMAGE_QUALITY_BETTER);
-  vgImageSubData(imgTemp, petSciiImageData, dstride, VG_BW_1, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT);
-  VGImage img = vgCreateImage(VG_sABGR_8888, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, VG_IMAGE_QUALITY_BETTER);
-  // if gaussian blur
-  // vgGaussianBlur(img, imgTemp, 0.6f, 0.6f, VG_TILE_PAD);
-  // else
-  vgCopyImage(img, 0, 0, imgTemp, 0, 0, PET_IMAGE_WIDTH, PET_IMAGE_HEIGHT, VG_FALSE);
-  // endif
-  vgDestroyImage(imgTemp);
-  return img;
-}
-
-VGImage glyphs[256];
-
-void prepareGlyphs(VGImage petSciiImage)
-{
-  for (unsigned int glyphRow = 0; glyphRow < 16; glyphRow++) {
-    for (unsigned int glyphCol = 0; glyphCol < 16; glyphCol++) {
-      unsigned int index = glyphRow * 16 + glyphCol;
-      VGint x = glyphCol * PET_GLYPH_WIDTH;
-      VGint y = PET_IMAGE_HEIGHT - ((glyphRow + 1) * PET_GLYPH_HEIGHT);
-      glyphs[index] = vgChildImage(petSciiImage, x, y, PET_GLYPH_WIDTH, PET_GLYPH_HEIGHT);
-    }
-  }
-}
-
-void destroyGlyphs()
-{
-  for (unsigned int index = 0; index < 256; index++) {
-    vgDestroyImage(glyphs[index]);
-  }
-}
+// serial device, the example screen is shown if it can't be opened
+#define DEFAULT_DEVICE "/dev/ttyUSB0"
 
 static unsigned char petsciiToRomIndex[256] = {
 //  0    1    2    3    4    5    6    7    8    9    A    B    C    D    E    F
@@ -99,76 +69,642 @@ static unsigned char exampleScreen[25 * 80 + 1] = "\
 24       .         .         .         .         .         .         .         .\
 25       .         .         .         .         .         .         .         .";
 
-static unsigned char screenContent[25 * 80]; // holds rom indices
+static unsigned char screenContent[SCREEN_SIZE]; // holds screen codes (== rom indices)
+static unsigned char graphic = 1;
 
-void imagetest(int screenW, int screenH) {
+static unsigned char receivedScreen[SCREEN_SIZE];
+static unsigned char receivedGraphic;
 
-  for (unsigned int i = 0; i < 25 * 80; i++) {
-    screenContent[i] = petsciiToRomIndex[exampleScreen[i]];
+// changed screens wait here for their presentation time
+#define PRESENT_QUEUE_SIZE 4
+// target latency from the arrival of a screen to its vsync:
+// one display period plus UART/USB jitter
+#define PRESENT_LATENCY 0.020
+
+typedef struct {
+  unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic;
+  double target;
+} t_queued_screen;
+
+static t_queued_screen presentQueue[PRESENT_QUEUE_SIZE];
+static unsigned queueFirst = 0;
+static unsigned queueCount = 0;
+
+static VGPaint paint;
+
+// capture of presented frames to PPM files, see CaptureEnd
+static const char* capturePattern = NULL; // -c, capture every presented frame
+static unsigned captureCount = 0;
+static unsigned screenshotCount = 0;
+static unsigned screenshotPending = 0; // [p] captures the next presented frame
+static int captureStarted = 0;
+
+// recording of the changed screens, see recording.h
+static t_recorder recorder;
+static int recording = 0;
+static double recordingStart;
+
+// archive of the distinct screens, see archive.h
+static t_archive archive;
+static int archiving = 0;
+
+// every received screen for local readers, see sharedscreen.h
+static t_screen_publisher publisher;
+static int publishing = 0;
+static uint64_t publishedFrames = 0;
+
+// one tile per device, see tiles.h
+static t_tile_layout layout;
+
+void prepareScreen() {
+  prepareGlyphBanks();
+  paint = vgCreatePaint();
+  VGfloat paintColor[4] = { 0.2f, 0.9f, 0.3f, 1.0f };
+  vgSetParameterfv(paint, VG_PAINT_COLOR, 4, paintColor);
+}
+
+void finishScreen() {
+  vgDestroyPaint(paint);
+  destroyGlyphBanks();
+}
+
+// startCapture starts the capture worker on the first -c or [p] only,
+// its buffers take a few frames of memory
+static void startCapture() {
+  if (!captureStarted) {
+    CaptureInit();
+    captureStarted = 1;
   }
+}
+
+// endFrame swaps the drawn frame, captured if requested
+static void endFrame() {
+  if (capturePattern != NULL || screenshotPending) {
+    char filename[256];
+    if (screenshotPending) {
+      snprintf(filename, sizeof(filename), "screenshot%03u.ppm", screenshotCount++);
+      screenshotPending = 0;
+    } else {
+      snprintf(filename, sizeof(filename), capturePattern, captureCount++);
+    }
+    CaptureEnd(filename);
+  } else {
+    End();
+  }
+}
+
+void drawScreen(const unsigned char* screen, int screenW, int screenH) {
 
   Start(screenW, screenH);
   Background(0, 0, 0);
-  VGPaint paint = vgCreatePaint();
-  VGfloat paintColor[4] = { 0.2f, 0.9f, 0.3f, 1.0f };
-  vgSetParameterfv(paint, VG_PAINT_COLOR, 4, paintColor);
   vgSetPaint(paint, VG_FILL_PATH);
-  VGImage img = makePetSciiImage();
-  prepareGlyphs(img);
 
-  vgSeti(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
   vgSeti(VG_IMAGE_MODE, VG_DRAW_IMAGE_MULTIPLY);
 
-  // if 1920 x 1080
-  VGfloat scaleX = 24.0f / 16.0f;
-  VGfloat scaleY = 36.0f / 24.0f;
-  // else if 1680 x 1050
-  // VGfloat scaleX = 20.0f / 16.0f;
-  // VGfloat scaleY = 30.0f / 24.0f;
-  // else unscaled
-  // VGfloat scaleX = 16.0f / 16.0f;
-  // VGfloat scaleY = 24.0f / 24.0f;
-  // endif
+  // the largest scale in 1/8 steps, 1.5 at 1920 x 1080, 1.25 at 1680 x 1050
+  drawGlyphs(screen, screenW, screenH, layout.scale, layout.scale);
+  endFrame();
+}
 
-  for (int row = 0; row < 25; row++) {
-    for (int col = 0; col < 80; col++) {
-      int index = row * 80 + col;
-      unsigned char cbmCode = screenContent[index];
-      vgLoadIdentity();
-      VGfloat dx = (VGfloat)screenW / 2.0f + scaleX * (VGfloat)(PET_GLYPH_WIDTH * (col - 40));
-      VGfloat dy = (VGfloat)screenH / 2.0f + scaleY * (VGfloat)(PET_GLYPH_HEIGHT * (12 - row));
-      vgTranslate(dx, dy);
-      vgScale(scaleX, scaleY);
-      vgDrawImage(glyphs[cbmCode]);
-    }
+void exampleScreenTest(int screenW, int screenH) {
+  for (unsigned int i = 0; i < SCREEN_SIZE; i++) {
+    screenContent[i] = petsciiToRomIndex[exampleScreen[i]];
   }
+  selectGlyphBank(graphic);
+  drawScreen(screenContent, screenW, screenH);
+}
 
-  destroyGlyphs();
-  vgDestroyImage(img);
-  End();
+// readKey returns the key pressed, or -1 if there is none; RawTerm makes
+// reads return at once, and getchar would keep the EOF of an empty read
+static int readKey() {
+  unsigned char c;
+  return read(STDIN_FILENO, &c, 1) == 1 ? c : -1;
 }
 
 // wait for a specific character
 void waituntil(int endchar) {
     int key;
+    struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
 
     for (;;) {
-        key = getchar();
+        poll(&fd, 1, -1);
+        key = readKey();
         if (key == endchar || key == '\n') {
             break;
         }
     }
 }
 
-// main initializes the system and shows the picture.
-// Exit and clean up when you hit [RETURN].
+//----------------------------------------------------------------------------------------
+// render statistics, printed with -s once per interval
+//
+// An interval without any swap counts as idle, the CPU time of the whole
+// process is the power draw proxy, the render CPU time covers drawing
+// only (eglSwapBuffers waiting for the GPU doesn't count as CPU time).
+
+#define STATS_INTERVAL_MS 5000
+
+typedef struct {
+  double wall_start;
+  double cpu_start;
+  double render_cpu;
+  unsigned screens;
+  unsigned swaps;
+  unsigned long scrolls; // swaps that moved the shown frame, all intervals
+  // totals over all intervals
+  double idle_wall, idle_cpu;
+  double active_wall, active_cpu, active_render_cpu;
+  unsigned long active_swaps;
+} t_render_stats;
+
+static double clock_seconds(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void init_render_stats(t_render_stats* stats) {
+  memset(stats, 0, sizeof(*stats));
+  stats->wall_start = clock_seconds(CLOCK_MONOTONIC);
+  stats->cpu_start = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+static void update_render_stats(t_render_stats* stats, int printing) {
+  double wall = clock_seconds(CLOCK_MONOTONIC) - stats->wall_start;
+  if (wall * 1000.0 < STATS_INTERVAL_MS) {
+    return;
+  }
+  double cpu = clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - stats->cpu_start;
+  if (stats->swaps == 0) {
+    stats->idle_wall += wall;
+    stats->idle_cpu += cpu;
+  } else {
+    stats->active_wall += wall;
+    stats->active_cpu += cpu;
+    stats->active_render_cpu += stats->render_cpu;
+    stats->active_swaps += stats->swaps;
+  }
+  if (printing) {
+    fprintf(stderr, "%s screens/s %5.1f swaps/s %5.1f render cpu %5.1f%% total cpu %5.1f%%\n",
+      stats->swaps == 0 ? "idle  " : "active",
+      stats->screens / wall, stats->swaps / wall,
+      100.0 * stats->render_cpu / wall, 100.0 * cpu / wall);
+  }
+  stats->wall_start += wall;
+  stats->cpu_start += cpu;
+  stats->render_cpu = 0.0;
+  stats->screens = 0;
+  stats->swaps = 0;
+}
+
+static void print_render_summary(t_render_stats* stats) {
+  if (stats->idle_wall > 0.0) {
+    fprintf(stderr, "idle   %7.1f s  swaps/s %5.1f  total cpu %5.1f%%\n",
+      stats->idle_wall, 0.0, 100.0 * stats->idle_cpu / stats->idle_wall);
+  }
+  if (stats->active_wall > 0.0) {
+    fprintf(stderr, "active %7.1f s  swaps/s %5.1f  total cpu %5.1f%%  render cpu %5.1f%%  scrolled %lu\n",
+      stats->active_wall, stats->active_swaps / stats->active_wall,
+      100.0 * stats->active_cpu / stats->active_wall,
+      100.0 * stats->active_render_cpu / stats->active_wall, stats->scrolls);
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+// queueScreen appends a changed screen with its target presentation time,
+// dropping the oldest one if presentation fell behind
+static void queueScreen(t_pacing* pacing, double target) {
+  if (queueCount == PRESENT_QUEUE_SIZE) {
+    queueFirst = (queueFirst + 1) % PRESENT_QUEUE_SIZE;
+    queueCount--;
+    pacing->superseded++;
+  }
+  t_queued_screen* entry = &presentQueue[(queueFirst + queueCount) % PRESENT_QUEUE_SIZE];
+  memcpy(entry->screen, receivedScreen, SCREEN_SIZE);
+  entry->graphic = receivedGraphic;
+  entry->target = target;
+  queueCount++;
+}
+
+// the screen on the preserved surface of receiveLoop
+static unsigned char shownScreen[SCREEN_SIZE];
+static unsigned char shownGraphic;
+static int shownValid = 0;
+
+// drawChangedScreen draws screen over the shown one. If the screen scrolled
+// (see screen_detect_scroll), the shown frame is moved with vgCopyPixels and
+// only the rows that scrolled in and the cells that differ otherwise are
+// drawn. The first frame, a changed character set and screens that didn't
+// scroll are redrawn in full. Returns 1 if the frame was scrolled.
+static int drawChangedScreen(const unsigned char* screen, unsigned char screenGraphic, int screenW, int screenH) {
+  int scroll = shownValid && screenGraphic == shownGraphic ? screen_detect_scroll(shownScreen, screen) : 0;
+  if (scroll != 0) {
+    Continue();
+    vgSetPaint(paint, VG_FILL_PATH);
+    vgSeti(VG_IMAGE_MODE, VG_DRAW_IMAGE_MULTIPLY);
+    drawScrolledGlyphs(screen, shownScreen, scroll, screenW, screenH, layout.scale, layout.scale);
+    endFrame();
+  } else {
+    drawScreen(screen, screenW, screenH);
+  }
+  memcpy(shownScreen, screen, SCREEN_SIZE);
+  shownGraphic = screenGraphic;
+  shownValid = 1;
+  return scroll != 0;
+}
+
+// presentScreen draws the newest queued screen that is due at the next vsync,
+// older due screens are superseded, returns the time to wait for the next
+// queued screen to become due (or -1 if the queue is empty)
+static int presentScreen(t_pacing* pacing, t_render_stats* stats, int screenW, int screenH) {
+  if (queueCount == 0) {
+    return -1;
+  }
+  double now = clock_seconds(CLOCK_MONOTONIC);
+  double vsync = pacing_next_vsync(pacing, now);
+  unsigned due = 0;
+  while (due < queueCount && presentQueue[(queueFirst + due) % PRESENT_QUEUE_SIZE].target <= vsync) {
+    due++;
+  }
+  if (due == 0) {
+    // wake up one display period before the vsync the first screen is due at
+    double wake = pacing_next_vsync(pacing, presentQueue[queueFirst].target) - pacing->display_period;
+    return wake > now ? (int)((wake - now) * 1000.0) + 1 : 1;
+  }
+
+  pacing->superseded += due - 1;
+  t_queued_screen* entry = &presentQueue[(queueFirst + due - 1) % PRESENT_QUEUE_SIZE];
+  queueFirst = (queueFirst + due) % PRESENT_QUEUE_SIZE;
+  queueCount -= due;
+
+  double start = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+  // a changed flag swaps the bank pointer only, the atlas stays as it is
+  selectGlyphBank(entry->graphic);
+  stats->scrolls += drawChangedScreen(entry->screen, entry->graphic, screenW, screenH);
+  stats->render_cpu += clock_seconds(CLOCK_THREAD_CPUTIME_ID) - start;
+  stats->swaps++;
+  // eglSwapBuffers returns when the previous frame is replaced at a vsync
+  pacing_swapped(pacing, clock_seconds(CLOCK_MONOTONIC), entry->target);
+  return 0;
+}
+
+// publishScreen passes every received screen to the shared memory readers
+static void publishScreen(t_receiver_context* context, const unsigned char* screen) {
+  if (publishing) {
+    // the receive buffer still holds the flags buffer, the last of the frame
+    uint64_t time = (uint64_t)(clock_seconds(CLOCK_REALTIME) * 1e9);
+    screen_publish(&publisher, publishedFrames++, time, context->buffer, screen);
+  }
+}
+
+// keepScreen records and archives a changed screen
+static void keepScreen(const unsigned char* screen, unsigned char screenGraphic) {
+  if (recording) {
+    uint32_t time = (uint32_t)((clock_seconds(CLOCK_MONOTONIC) - recordingStart) * 1000.0);
+    if (recorder_add(&recorder, time, screen, screenGraphic) < 0) {
+      perror("recording stopped");
+      recorder_close(&recorder);
+      recording = 0;
+    }
+  }
+  if (archiving) {
+    double time = clock_seconds(CLOCK_REALTIME) * 1000.0;
+    if (archive_add(&archive, (uint64_t)time, screen, screenGraphic) < 0) {
+      perror("archiving stopped");
+      archive_close(&archive);
+      archiving = 0;
+    }
+  }
+}
+
+// receiveLoop shows the screens received from the serial device,
+// the graphic flag of each screen selects the character set.
+// Identical screens are not drawn at all, the last swapped frame
+// simply stays on the display. The cursor blinks because the PET
+// writes it to the video memory, so each blink phase arrives as a
+// changed screen. Changed screens are presented paced to the
+// display refresh, see pacing.h. The surface is preserved, so a scrolled
+// screen moves the shown frame instead of redrawing it.
+void receiveLoop(int uart, int screenW, int screenH, int printStats) {
+  t_receiver_context context;
+  init_receiver_context(&context);
+
+  t_render_stats stats;
+  init_render_stats(&stats);
+
+  t_pacing pacing;
+  pacing_init(&pacing, PRESENT_LATENCY);
+
+  struct pollfd fds[2];
+  fds[0].fd = uart;
+  fds[0].events = POLLIN;
+  fds[1].fd = STDIN_FILENO;
+  fds[1].events = POLLIN;
+
+  unsigned repaint = 1;
+
+  SwapBehavior(1);
+  shownValid = 0;
+
+  for (;;) {
+    int received = receive_screen(uart, &context, receivedScreen, &receivedGraphic);
+    if (received < 0) {
+      break;
+    }
+    if (received > 0) {
+      stats.screens++;
+      publishScreen(&context, receivedScreen);
+      double target = pacing_source_frame(&pacing, clock_seconds(CLOCK_MONOTONIC));
+      if (repaint || receivedGraphic != graphic || !screen_equal(receivedScreen, screenContent)) {
+        // screenContent holds the newest accepted screen from here on
+        memcpy(screenContent, receivedScreen, SCREEN_SIZE);
+        graphic = receivedGraphic;
+        queueScreen(&pacing, target);
+        keepScreen(screenContent, graphic);
+        repaint = 0;
+      }
+    }
+    int wait = presentScreen(&pacing, &stats, screenW, screenH);
+    if (received == 0 && wait != 0) {
+      // sleep until more bytes or a key arrive, or a queued screen is due
+      poll(fds, 2, wait < 0 ? STATS_INTERVAL_MS : wait);
+    }
+    int key = readKey();
+    if (key == 0x1b || key == '\n') {
+      break;
+    }
+    if (key == 't') {
+      FrameTimes(stderr);
+    }
+    if (key == 'p') {
+      // the next screen is presented even if it is unchanged
+      startCapture();
+      screenshotPending = 1;
+      repaint = 1;
+    }
+    update_render_stats(&stats, printStats);
+  }
+
+  if (printStats) {
+    print_render_summary(&stats);
+    pacing_print_histogram(&pacing, stderr);
+    FrameTimes(stderr);
+    CaptureStats(stderr);
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// tiles: one PET per device, shown side by side, see tiles.h
+
+typedef struct {
+  int uart; // -1 once the device is gone, the tile keeps its last screen
+  t_receiver_context context;
+  unsigned char received[SCREEN_SIZE]; // being received
+  unsigned char screen[SCREEN_SIZE];   // newest complete screen
+  unsigned char graphic;
+  unsigned char shown[SCREEN_SIZE];    // drawn in the tile
+  unsigned char shownGraphic;
+  unsigned changed;
+  unsigned char kept[SCREEN_SIZE];     // passed to keepScreen last, tile 0 only
+  unsigned char keptGraphic;
+  int hasKept;
+} t_tile;
+
+static t_tile tiles[MAX_TILES];
+
+// drawTiles draws the changed tiles on top of the previous frame,
+// or all of them on a cleared surface
+static void drawTiles(int screenW, int screenH, int all) {
+  if (all) {
+    Start(screenW, screenH);
+    Background(0, 0, 0);
+  } else {
+    Continue();
+  }
+  vgSetPaint(paint, VG_FILL_PATH);
+  vgSeti(VG_IMAGE_MODE, VG_DRAW_IMAGE_MULTIPLY);
+  for (unsigned i = 0; i < layout.count; i++) {
+    t_tile* tile = &tiles[i];
+    if (!all && !tile->changed) {
+      continue;
+    }
+    int x, y;
+    tile_origin(&layout, i, screenH, &x, &y);
+    setGlyphOrigin(x, y);
+    // the bank is per tile, a tile whose flag changed is drawn whole
+    selectGlyphBank(tile->graphic);
+    if (all || tile->graphic != tile->shownGraphic) {
+      drawGlyphs(tile->screen, layout.tile_w, layout.tile_h, layout.scale, layout.scale);
+    } else {
+      drawDirtyGlyphs(tile->screen, tile->shown, layout.tile_w, layout.tile_h, layout.scale, layout.scale);
+    }
+    memcpy(tile->shown, tile->screen, SCREEN_SIZE);
+    tile->shownGraphic = tile->graphic;
+    tile->changed = 0;
+  }
+  setGlyphOrigin(0, 0);
+  endFrame();
+}
+
+// tiledLoop shows the screens of several devices in the tiles of the
+// layout. The surface is preserved and a frame redraws only the changed
+// cells of the tiles whose screen changed, nothing while all are
+// unchanged. Screens are drawn as they arrive, the swap waits for the
+// vsync, so a tile shows the newest screen at each swap instead of
+// following the pacing of a single source. -r, -a and -m follow the
+// first device.
+void tiledLoop(const int* uarts, int screenW, int screenH, int printStats) {
+  t_render_stats stats;
+  init_render_stats(&stats);
+
+  struct pollfd fds[MAX_TILES + 1];
+  for (unsigned i = 0; i < layout.count; i++) {
+    t_tile* tile = &tiles[i];
+    tile->uart = uarts[i];
+    init_receiver_context(&tile->context);
+    memset(tile->screen, ' ', SCREEN_SIZE);
+    tile->graphic = 1;
+    fds[i].fd = tile->uart;
+    fds[i].events = POLLIN;
+  }
+  fds[layout.count].fd = STDIN_FILENO;
+  fds[layout.count].events = POLLIN;
+
+  SwapBehavior(1);
+  drawTiles(screenW, screenH, 1);
+
+  for (;;) {
+    unsigned changed = 0;
+    for (unsigned i = 0; i < layout.count; i++) {
+      t_tile* tile = &tiles[i];
+      int received;
+      while (tile->uart >= 0 &&
+             (received = receive_screen(tile->uart, &tile->context, tile->received, &tile->graphic)) != 0) {
+        if (received < 0) {
+          close(tile->uart);
+          tile->uart = -1;
+          fds[i].fd = -1;
+          break;
+        }
+        stats.screens++;
+        memcpy(tile->screen, tile->received, SCREEN_SIZE);
+        if (i == 0) {
+          publishScreen(&tile->context, tile->screen);
+        }
+        if (tile->graphic != tile->shownGraphic || !screen_equal(tile->screen, tile->shown)) {
+          tile->changed = 1;
+        }
+        // against the screen kept last, several may arrive before a draw
+        if (i == 0 && (!tile->hasKept || tile->graphic != tile->keptGraphic ||
+                       !screen_equal(tile->screen, tile->kept))) {
+          keepScreen(tile->screen, tile->graphic);
+          memcpy(tile->kept, tile->screen, SCREEN_SIZE);
+          tile->keptGraphic = tile->graphic;
+          tile->hasKept = 1;
+        }
+      }
+      changed |= tile->changed;
+    }
+    if (changed) {
+      double start = clock_seconds(CLOCK_THREAD_CPUTIME_ID);
+      drawTiles(screenW, screenH, 0);
+      stats.render_cpu += clock_seconds(CLOCK_THREAD_CPUTIME_ID) - start;
+      stats.swaps++;
+    } else {
+      poll(fds, layout.count + 1, STATS_INTERVAL_MS);
+    }
+    int key = readKey();
+    if (key == 0x1b || key == '\n') {
+      break;
+    }
+    if (key == 't') {
+      FrameTimes(stderr);
+    }
+    if (key == 'p') {
+      startCapture();
+      screenshotPending = 1;
+      drawTiles(screenW, screenH, 0);
+    }
+    update_render_stats(&stats, printStats);
+  }
+
+  for (unsigned i = 0; i < layout.count; i++) {
+    if (tiles[i].uart >= 0) {
+      close(tiles[i].uart);
+    }
+  }
+  if (printStats) {
+    print_render_summary(&stats);
+    FrameTimes(stderr);
+    CaptureStats(stderr);
+  }
+}
+
+// main initializes the system and shows the received screens.
+// Exit and clean up when you hit [RETURN] or [ESC].
+// Shows an example screen if the serial device can't be opened.
+// Hit [t] to print the frame time summary of the last frames,
+// [p] to save the next presented frame as screenshotNNN.ppm.
+// usage: serial2hdmi [-s] [-t file] [-c pattern] [-r file] [-a directory] [-m name] [device ...]
+// With 2 to 4 devices, one per PET, the screens are shown side by side,
+// the layout and the glyph scale are chosen from their number, see tiles.h.
+//   -s          print render statistics, the pacing error histogram,
+//               frame times and capture counts to stderr
+//   -t file     write the timestamps of the last frames to file at exit
+//   -c pattern  capture every presented frame to a PPM file named by the
+//               printf pattern with one integer conversion of the
+//               frame number, e.g. frame%05u.ppm. Frames are dropped
+//               from the capture if the disk can't keep up. Compare the
+//               capture phase of the frame times with and without -c
+//               for the stall capturing adds to the render loop.
+//   -r file     record the changed screens to file, see recording.h
+//   -a dir      add the changed screens to the archive in dir, see archive.h
+//   -m name     publish every received screen in the shared memory segment
+//               name, see sharedscreen.h and screenmirror.c
 int main(int argc, char **argv) {
   int w, h;
+  int printStats = 0;
+  const char* frameTimesFile = NULL;
+  const char* recordingFile = NULL;
+  const char* archiveDirectory = NULL;
+  const char* sharedName = NULL;
+  const char* devices[MAX_TILES] = { DEFAULT_DEVICE };
+  unsigned deviceCount = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0) {
+      printStats = 1;
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      frameTimesFile = argv[++i];
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      capturePattern = argv[++i];
+      if (!frame_pattern_valid(capturePattern)) {
+        fprintf(stderr, "-c %s: the pattern needs exactly one integer conversion like %%05u\n", capturePattern);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      recordingFile = argv[++i];
+    } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+      archiveDirectory = argv[++i];
+    } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      sharedName = argv[++i];
+    } else if (deviceCount < MAX_TILES) {
+      devices[deviceCount++] = argv[i];
+    }
+  }
+  int uarts[MAX_TILES];
+  unsigned opened = 0;
+  for (unsigned i = 0; i < (deviceCount > 0 ? deviceCount : 1); i++) {
+    uarts[opened] = open_uart(devices[i]);
+    if (uarts[opened] >= 0) {
+      opened++;
+    }
+  }
+  int uart = opened > 0 ? uarts[0] : -1;
   SaveTerm();
   InitOpenVG(&w, &h);
   RawTerm();
-  imagetest(w, h);
-  waituntil(0x1b);
+  if (capturePattern != NULL) {
+    startCapture();
+  }
+  prepareScreen();
+  tile_layout(&layout, opened, w, h);
+  if (uart < 0) {
+    exampleScreenTest(w, h);
+    waituntil(0x1b);
+  } else {
+    if (recordingFile != NULL && recorder_open(&recorder, recordingFile) == 0) {
+      recording = 1;
+      recordingStart = clock_seconds(CLOCK_MONOTONIC);
+    }
+    if (archiveDirectory != NULL && archive_open(&archive, archiveDirectory) == 0) {
+      archiving = 1;
+    }
+    if (sharedName != NULL && screen_publisher_open(&publisher, sharedName) == 0) {
+      publishing = 1;
+    }
+    if (opened > 1) {
+      tiledLoop(uarts, w, h, printStats);
+    } else {
+      receiveLoop(uart, w, h, printStats);
+      close(uart);
+    }
+    if (recording) {
+      recorder_close(&recorder);
+    }
+    if (archiving) {
+      archive_close(&archive);
+    }
+    if (publishing) {
+      screen_publisher_close(&publisher);
+    }
+  }
+  if (frameTimesFile != NULL) {
+    SaveFrameTimes(frameTimesFile);
+  }
+  finishScreen();
+  CaptureFinish();
   RestoreTerm();
   FinishOpenVG();
   return 0;
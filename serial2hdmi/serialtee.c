@@ -0,0 +1,400 @@
+// serialtee fans the raw byte stream of the serial device out to several
+// consumers, e.g. a recorder, a link checker and the live decoder
+//
+// usage: serialtee [-n ring KB] [-r bytes per second] source {-d|-b} path ...
+//
+// Each path is a FIFO (mkfifo) or a regular file. Decoders read a FIFO
+// like the device itself, e.g.
+//   mkfifo /tmp/live /tmp/rec
+//   serialtee /dev/ttyUSB0 -d /tmp/live -b /tmp/rec &
+//   serial2hdmi /tmp/live & cat /tmp/rec > session.bin
+// A FIFO is attached whenever a reader has it open and gets the stream
+// from then on; regular files are appended to.
+//
+// The bytes are read from the device once, into a ring buffer, and passed
+// to the -b FIFOs with vmsplice, which hands the ring pages to the pipes
+// instead of copying them per consumer. The pipe keeps referencing the
+// pages until the consumer read them, so the ring is never refilled
+// closer than a pipe size behind the oldest of them. A -d consumer skips
+// ahead when its pipe is full, while the pipe still references the pages
+// before, and a stalled reader must not hold up the ring; -d FIFOs get
+// copies with write instead.
+//
+// -d: drop policy, when the consumer's pipe is full the bytes are dropped
+//     for it (the receiver resyncs at the next frame) and counted
+// -b: block policy, the consumer gets every byte, held back in the ring
+//     while its pipe is full. Only if it falls behind by the whole ring
+//     (-n, default 4096 KB, 14 s at 3 Mbit/s) the device is no longer read
+//     and the UART eventually overruns.
+// A source that is a regular file, e.g. a raw session, is read at -r bytes
+// per second (default 300000, the 3 Mbit/s of the observer) to try out
+// consumers. Statistics go to stderr at the end of the source or on ^C.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <linux/serial.h>
+#include "receiver.h"
+
+#define MAX_CONSUMERS 8
+#define PIPE_SIZE (1024 * 1024)
+#define REATTACH_MS 500
+
+typedef struct {
+  const char* path;
+  int block;
+  int fd;             // -1 while no reader has the FIFO open
+  int is_pipe;
+  int splice;         // vmsplice the ring pages, -b FIFOs only
+  size_t pipe_size;
+  uint64_t position;  // stream offset of the next byte to pass on
+  uint64_t delivered;
+  uint64_t dropped;
+  unsigned attached;
+} t_consumer;
+
+static t_consumer consumers[MAX_CONSUMERS];
+static unsigned consumer_count = 0;
+static unsigned char* ring;
+static size_t ring_size;
+static uint64_t head = 0; // bytes received from the source
+static volatile sig_atomic_t stop = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void handle_signal(int signal)
+{
+  stop = 1;
+}
+
+static void attach(t_consumer* consumer)
+{
+  struct stat st;
+  if (stat(consumer->path, &st) < 0)
+  {
+    return;
+  }
+  consumer->is_pipe = S_ISFIFO(st.st_mode);
+  if (consumer->is_pipe)
+  {
+    // fails with ENXIO while no reader has the FIFO open
+    consumer->fd = open(consumer->path, O_WRONLY | O_NONBLOCK);
+    if (consumer->fd < 0)
+    {
+      return;
+    }
+    fcntl(consumer->fd, F_SETPIPE_SZ, PIPE_SIZE);
+    int size = fcntl(consumer->fd, F_GETPIPE_SZ);
+    consumer->pipe_size = size > 0 ? size : PIPE_SIZE;
+    consumer->splice = consumer->block;
+  }
+  else
+  {
+    consumer->fd = open(consumer->path, O_WRONLY | O_APPEND);
+    if (consumer->fd < 0)
+    {
+      perror(consumer->path);
+      return;
+    }
+    consumer->pipe_size = 0;
+    consumer->splice = 0;
+  }
+  consumer->position = head;
+  consumer->attached++;
+}
+
+static void detach(t_consumer* consumer)
+{
+  close(consumer->fd);
+  consumer->fd = -1;
+}
+
+// deliver passes the pending bytes on as far as the consumer takes them
+static void deliver(t_consumer* consumer)
+{
+  while (consumer->fd >= 0 && consumer->position < head)
+  {
+    size_t offset = consumer->position % ring_size;
+    size_t length = head - consumer->position;
+    if (length > ring_size - offset)
+    {
+      length = ring_size - offset;
+    }
+    ssize_t passed;
+    if (consumer->splice)
+    {
+      struct iovec iov = { ring + offset, length };
+      passed = vmsplice(consumer->fd, &iov, 1, SPLICE_F_NONBLOCK);
+    }
+    else
+    {
+      passed = write(consumer->fd, ring + offset, length);
+    }
+    if (passed > 0)
+    {
+      consumer->position += passed;
+      consumer->delivered += passed;
+    }
+    else if (passed < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else if (passed < 0 && errno == EAGAIN)
+    {
+      if (!consumer->block)
+      {
+        consumer->dropped += head - consumer->position;
+        consumer->position = head;
+      }
+      return;
+    }
+    else
+    {
+      // the reader went away, the FIFO is attached again when it is back
+      detach(consumer);
+      return;
+    }
+  }
+}
+
+// ring_room returns how many bytes can be received without refilling ring
+// bytes a consumer hasn't got yet, or that a pipe may still reference. A -b
+// consumer's position is where its last vmsplice ended, the pipe holds at
+// most a pipe size before it.
+static size_t ring_room()
+{
+  uint64_t oldest = head;
+  for (unsigned i = 0; i < consumer_count; i++)
+  {
+    t_consumer* consumer = &consumers[i];
+    if (consumer->fd >= 0)
+    {
+      uint64_t referenced = consumer->position;
+      if (consumer->splice)
+      {
+        referenced = referenced > consumer->pipe_size ? referenced - consumer->pipe_size : 0;
+      }
+      if (referenced < oldest)
+      {
+        oldest = referenced;
+      }
+    }
+  }
+  uint64_t used = head - oldest;
+  return used < ring_size ? ring_size - used : 0;
+}
+
+static int all_delivered()
+{
+  for (unsigned i = 0; i < consumer_count; i++)
+  {
+    if (consumers[i].fd >= 0 && consumers[i].block && consumers[i].position < head)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void print_stats(int source, double elapsed, double blocked, struct serial_icounter_struct* start_count)
+{
+  fprintf(stderr, "%llu bytes in %.1f s, %.0f bytes/s, device not read for %.3f s\n",
+    (unsigned long long)head, elapsed, head / elapsed, blocked);
+  struct serial_icounter_struct count;
+  if (start_count != NULL && ioctl(source, TIOCGICOUNT, &count) == 0)
+  {
+    fprintf(stderr, "uart overruns %d, tty buffer overruns %d\n",
+      count.overrun - start_count->overrun, count.buf_overrun - start_count->buf_overrun);
+  }
+  for (unsigned i = 0; i < consumer_count; i++)
+  {
+    t_consumer* consumer = &consumers[i];
+    fprintf(stderr, "%s (%s): %llu bytes delivered, %llu dropped, %llu pending, attached %u times\n",
+      consumer->path, consumer->block ? "block" : "drop",
+      (unsigned long long)consumer->delivered, (unsigned long long)consumer->dropped,
+      (unsigned long long)(consumer->fd >= 0 ? head - consumer->position : 0), consumer->attached);
+  }
+}
+
+static void print_usage()
+{
+  fprintf(stderr, "usage: serialtee [-n ring KB] [-r bytes per second] source {-d|-b} path ...\n");
+}
+
+int main(int argc, char** argv)
+{
+  const char* source_path = NULL;
+  size_t ring_kb = 4096;
+  double file_rate = 300000.0;
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "-b") == 0) && i + 1 < argc)
+    {
+      if (consumer_count == MAX_CONSUMERS)
+      {
+        fprintf(stderr, "at most %d consumers\n", MAX_CONSUMERS);
+        print_usage();
+        return 2;
+      }
+      t_consumer* consumer = &consumers[consumer_count++];
+      memset(consumer, 0, sizeof(*consumer));
+      consumer->block = argv[i][1] == 'b';
+      consumer->path = argv[++i];
+      consumer->fd = -1;
+    }
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      ring_kb = strtoul(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      file_rate = atof(argv[++i]);
+    }
+    else if (argv[i][0] != '-')
+    {
+      source_path = argv[i];
+    }
+  }
+  if (source_path == NULL || consumer_count == 0)
+  {
+    print_usage();
+    return 2;
+  }
+
+  // the ring must hold a full pipe of every consumer besides new bytes
+  ring_size = ring_kb * 1024;
+  if (ring_size < 2 * PIPE_SIZE)
+  {
+    ring_size = 2 * PIPE_SIZE;
+  }
+  ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED)
+  {
+    perror("ring");
+    return 1;
+  }
+
+  struct stat st;
+  int is_file = stat(source_path, &st) == 0 && S_ISREG(st.st_mode);
+  int source = is_file ? open(source_path, O_RDONLY) : open_uart(source_path);
+  if (source < 0)
+  {
+    perror(source_path);
+    return 1;
+  }
+  struct serial_icounter_struct start_count;
+  int has_count = !is_file && ioctl(source, TIOCGICOUNT, &start_count) == 0;
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+
+  double start = now();
+  double last_attach = 0.0;
+  double blocked = 0.0;
+  int source_done = 0;
+  while (!stop && !(source_done && all_delivered()))
+  {
+    double time = now();
+    if (time - last_attach >= REATTACH_MS / 1000.0)
+    {
+      for (unsigned i = 0; i < consumer_count; i++)
+      {
+        if (consumers[i].fd < 0)
+        {
+          attach(&consumers[i]);
+        }
+      }
+      last_attach = time;
+    }
+
+    size_t room = source_done ? 0 : ring_room();
+    size_t wanted = room;
+    if (is_file)
+    {
+      // a file is paced like the device would send it
+      uint64_t due = (uint64_t)((time - start) * file_rate);
+      wanted = due > head ? (due - head < room ? due - head : room) : 0;
+    }
+
+    struct pollfd fds[MAX_CONSUMERS + 1];
+    unsigned fd_count = 0;
+    if (wanted > 0 && !is_file)
+    {
+      fds[fd_count].fd = source;
+      fds[fd_count].events = POLLIN;
+      fd_count++;
+    }
+    for (unsigned i = 0; i < consumer_count; i++)
+    {
+      if (consumers[i].fd >= 0 && consumers[i].is_pipe && consumers[i].position < head)
+      {
+        fds[fd_count].fd = consumers[i].fd;
+        fds[fd_count].events = POLLOUT;
+        fd_count++;
+      }
+    }
+    int timeout = is_file || room == 0 ? 1 : REATTACH_MS;
+    if (!(is_file && wanted > 0))
+    {
+      double wait_start = now();
+      poll(fds, fd_count, timeout);
+      if (room == 0 && !source_done)
+      {
+        blocked += now() - wait_start;
+      }
+    }
+
+    if (wanted > 0)
+    {
+      size_t offset = head % ring_size;
+      size_t length = wanted < ring_size - offset ? wanted : ring_size - offset;
+      ssize_t received = read(source, ring + offset, length);
+      if (received > 0)
+      {
+        head += received;
+      }
+      else if (received == 0 && is_file)
+      {
+        source_done = 1;
+      }
+      else if (received < 0 && errno != EAGAIN && errno != EINTR)
+      {
+        perror(source_path);
+        source_done = 1;
+      }
+    }
+    for (unsigned i = 0; i < consumer_count; i++)
+    {
+      deliver(&consumers[i]);
+    }
+  }
+
+  print_stats(source, now() - start, blocked, has_count ? &start_count : NULL);
+  for (unsigned i = 0; i < consumer_count; i++)
+  {
+    if (consumers[i].fd >= 0)
+    {
+      detach(&consumers[i]);
+    }
+  }
+  close(source);
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <string.h>
+#include "receiver.h"
+#include "recording.h"
+#include "session.h"
+
+// load_recording expands the screens of a recording, one per record
+static unsigned load_recording(const char* filename, unsigned char (*screens)[SCREEN_SIZE],
+  unsigned char* graphics, unsigned max_screens)
+{
+  t_player player;
+  if (player_open(&player, filename) < 0)
+  {
+    fprintf(stderr, "%s: not a readable recording\n", filename);
+    return 0;
+  }
+  unsigned count = 0;
+  do
+  {
+    memcpy(screens[count], player.screen, SCREEN_SIZE);
+    graphics[count] = player.graphic;
+    count++;
+  } while (count < max_screens && player_next(&player));
+  player_close(&player);
+  return count;
+}
+
+// load_session decodes up to max_screens complete screens from a session
+// file or recording, returns the number of screens, or 0 if the file can't be read
+unsigned load_session(const char* filename, unsigned char (*screens)[SCREEN_SIZE],
+  unsigned char* graphics, unsigned max_screens)
+{
+  if (is_recording(filename))
+  {
+    return load_recording(filename, screens, graphics, max_screens);
+  }
+
+  FILE* fp = fopen(filename, "rb");
+  if (fp == NULL)
+  {
+    perror(filename);
+    return 0;
+  }
+
+  t_receiver_context context;
+  init_receiver_context(&context);
+  context.screen_buffer = screens[0];
+  context.graphic = &graphics[0];
+
+  unsigned count = 0;
+  int byte;
+  while (count < max_screens && (byte = fgetc(fp)) != EOF)
+  {
+    if (handle_received_byte(&context, (unsigned char)byte))
+    {
+      count++;
+      if (count < max_screens)
+      {
+        // incomplete frames leave the previous content in place
+        memcpy(screens[count], screens[count - 1], SCREEN_SIZE);
+        graphics[count] = graphics[count - 1];
+        context.screen_buffer = screens[count];
+        context.graphic = &graphics[count];
+      }
+    }
+  }
+  fclose(fp);
+  return count;
+}
@@ -0,0 +1,8 @@
+// sessions are raw byte streams from the serial device, recorded e.g. with
+//   stty -F /dev/ttyUSB0 3000000 raw && cat /dev/ttyUSB0 > session.bin
+// or recordings of changed screens (see recording.h), e.g. from serial2hdmi -r
+
+#include "screen.h"
+
+extern unsigned load_session(const char* filename, unsigned char (*screens)[SCREEN_SIZE],
+  unsigned char* graphics, unsigned max_screens);
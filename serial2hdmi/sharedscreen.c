@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sharedscreen.h"
+
+#define SHARED_MAGIC "CBMSHM01"
+
+// a writer that died between its two sequence stores leaves the sequence
+// odd, readers give up after this many attempts instead of spinning
+#define MAX_READ_ATTEMPTS 1000
+
+static void shm_path(char* path, size_t size, const char* name)
+{
+  snprintf(path, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+// screen_publisher_open creates or reuses the shared memory segment name,
+// returns 0 or -1
+int screen_publisher_open(t_screen_publisher* publisher, const char* name)
+{
+  char path[256];
+  shm_path(path, sizeof(path), name);
+  publisher->shared = NULL;
+  int fd = shm_open(path, O_CREAT | O_RDWR, 0644);
+  if (fd < 0)
+  {
+    perror(path);
+    return -1;
+  }
+  if (ftruncate(fd, sizeof(t_shared_screen)) < 0)
+  {
+    perror(path);
+    close(fd);
+    return -1;
+  }
+  void* shared = mmap(NULL, sizeof(t_shared_screen), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shared == MAP_FAILED)
+  {
+    perror(path);
+    return -1;
+  }
+  publisher->shared = shared;
+  // the sequence continues from a previous writer, so readers of the old
+  // segment can't mistake a new screen for the one they started with
+  uint32_t sequence = publisher->shared->sequence;
+  __atomic_store_n(&publisher->shared->sequence, (sequence + 1) & ~1u, __ATOMIC_RELEASE);
+  memcpy(publisher->shared->magic, SHARED_MAGIC, 8);
+  return 0;
+}
+
+void screen_publish(t_screen_publisher* publisher, uint64_t frame, uint64_t time,
+  const unsigned char* flags, const unsigned char* screen)
+{
+  t_shared_screen* shared = publisher->shared;
+  uint32_t sequence = shared->sequence;
+  __atomic_store_n(&shared->sequence, sequence + 1, __ATOMIC_RELAXED);
+  // the odd sequence must be visible before any of the new content
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  shared->frame = frame;
+  shared->time = time;
+  memcpy(shared->flags, flags, SHARED_FLAGS_SIZE);
+  memcpy(shared->screen, screen, SCREEN_SIZE);
+  __atomic_store_n(&shared->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void screen_publisher_close(t_screen_publisher* publisher)
+{
+  if (publisher->shared != NULL)
+  {
+    munmap(publisher->shared, sizeof(t_shared_screen));
+    publisher->shared = NULL;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+// screen_subscriber_open maps the segment name read only
+int screen_subscriber_open(t_screen_subscriber* subscriber, const char* name)
+{
+  char path[256];
+  shm_path(path, sizeof(path), name);
+  subscriber->shared = NULL;
+  subscriber->sequence = 0;
+  subscriber->retries = 0;
+  int fd = shm_open(path, O_RDONLY, 0);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0)
+  {
+    perror(path);
+    return -1;
+  }
+  if ((size_t)st.st_size < sizeof(t_shared_screen))
+  {
+    fprintf(stderr, "%s: not a shared screen\n", path);
+    close(fd);
+    return -1;
+  }
+  void* shared = mmap(NULL, sizeof(t_shared_screen), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shared == MAP_FAILED)
+  {
+    perror(path);
+    return -1;
+  }
+  subscriber->shared = shared;
+  if (memcmp(subscriber->shared->magic, SHARED_MAGIC, 8) != 0)
+  {
+    fprintf(stderr, "%s: not a shared screen\n", path);
+    screen_subscriber_close(subscriber);
+    return -1;
+  }
+  return 0;
+}
+
+// screen_read_begin and screen_read_valid bracket a read of the shared
+// screen in place, e.g.
+//   do { s = screen_read_begin(sub); ...use sub->shared... } while (!screen_read_valid(sub, s));
+// Nothing read in between may be trusted before screen_read_valid returns 1.
+uint32_t screen_read_begin(const t_screen_subscriber* subscriber)
+{
+  return __atomic_load_n(&subscriber->shared->sequence, __ATOMIC_ACQUIRE);
+}
+
+int screen_read_valid(const t_screen_subscriber* subscriber, uint32_t sequence)
+{
+  // the content loads must complete before the sequence is checked again
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return (sequence & 1) == 0 && __atomic_load_n(&subscriber->shared->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+// screen_snapshot copies a consistent screen, returns 1 if it is newer than
+// the previous snapshot, 0 if nothing new was published and -1 if the
+// writer seems stuck in the middle of a screen
+int screen_snapshot(t_screen_subscriber* subscriber, t_screen_snapshot* snapshot)
+{
+  const t_shared_screen* shared = subscriber->shared;
+  for (unsigned attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++)
+  {
+    uint32_t sequence = screen_read_begin(subscriber);
+    if (sequence == 0)
+    {
+      return 0; // nothing published yet
+    }
+    if (sequence == subscriber->sequence)
+    {
+      return 0;
+    }
+    snapshot->frame = shared->frame;
+    snapshot->time = shared->time;
+    memcpy(snapshot->flags, shared->flags, SHARED_FLAGS_SIZE);
+    memcpy(snapshot->screen, shared->screen, SCREEN_SIZE);
+    if (screen_read_valid(subscriber, sequence))
+    {
+      subscriber->sequence = sequence;
+      return 1;
+    }
+    subscriber->retries++;
+  }
+  return -1;
+}
+
+void screen_subscriber_close(t_screen_subscriber* subscriber)
+{
+  if (subscriber->shared != NULL)
+  {
+    munmap((void*)subscriber->shared, sizeof(t_shared_screen));
+    subscriber->shared = NULL;
+  }
+}
@@ -0,0 +1,63 @@
+// the latest complete screen in shared memory, so local tools can follow
+// the screen while the decoder owns the UART
+//
+// The decoder publishes every received screen into a POSIX shared memory
+// segment, native endian as readers run on the same machine:
+//
+//   "CBMSHM01", u32 sequence, u32 reserved, u64 frame,
+//   u64 time (CLOCK_REALTIME ns when the screen was complete),
+//   40 bytes flags buffer (graphic state in byte 0), 2000 screen codes
+//
+// The sequence is a seqlock: the writer makes it odd, stores the screen
+// and makes it even again (release). A reader loads the sequence
+// (acquire), reads the screen in place or copies it, and loads the
+// sequence again; if it changed or was odd the read is retried. Readers
+// never make a syscall after opening and the writer never waits for them.
+
+#ifndef __sharedscreen_h__
+#define __sharedscreen_h__
+
+#include <stdint.h>
+#include "screen.h"
+
+#define SHARED_FLAGS_SIZE 40
+
+typedef struct {
+  char magic[8];
+  uint32_t sequence;
+  uint32_t reserved;
+  uint64_t frame;
+  uint64_t time;
+  unsigned char flags[SHARED_FLAGS_SIZE];
+  unsigned char screen[SCREEN_SIZE];
+} t_shared_screen;
+
+typedef struct {
+  uint64_t frame;
+  uint64_t time;
+  unsigned char flags[SHARED_FLAGS_SIZE];
+  unsigned char screen[SCREEN_SIZE];
+} t_screen_snapshot;
+
+typedef struct {
+  t_shared_screen* shared;
+} t_screen_publisher;
+
+typedef struct {
+  const t_shared_screen* shared;
+  uint32_t sequence;      // of the last snapshot
+  unsigned long retries;  // reads that raced with the writer
+} t_screen_subscriber;
+
+extern int screen_publisher_open(t_screen_publisher* publisher, const char* name);
+extern void screen_publish(t_screen_publisher* publisher, uint64_t frame, uint64_t time,
+  const unsigned char* flags, const unsigned char* screen);
+extern void screen_publisher_close(t_screen_publisher* publisher);
+
+extern int screen_subscriber_open(t_screen_subscriber* subscriber, const char* name);
+extern uint32_t screen_read_begin(const t_screen_subscriber* subscriber);
+extern int screen_read_valid(const t_screen_subscriber* subscriber, uint32_t sequence);
+extern int screen_snapshot(t_screen_subscriber* subscriber, t_screen_snapshot* snapshot);
+extern void screen_subscriber_close(t_screen_subscriber* subscriber);
+
+#endif
@@ -0,0 +1,69 @@
+#include <string.h>
+#include "softglyphs.h"
+
+// 256 characters of 8x8 pixels, graphic set followed by text set,
+// each set has 128 characters, the PET generates reverse video itself
+extern unsigned char cbmCharRomData[2048];
+
+// glyphs of both banks, each 24 rows of 16 pixels, top row first
+static uint32_t soft_glyphs[GLYPH_BANKS][256][SOFT_GLYPH_HEIGHT * SOFT_GLYPH_WIDTH];
+
+// glyph_row_bits returns pixel row y of a glyph, the leftmost pixel in bit 0
+//
+// ROM pixels are doubled in width, and each ROM row is preceded by a dark
+// scanline. Screen codes 128..255 show the same characters in reverse video,
+// the scanlines stay dark there like on the PET screen.
+unsigned glyph_row_bits(unsigned bank, unsigned char code, unsigned y)
+{
+  const unsigned char* romChar = cbmCharRomData + (bank * 128 + (code & 0x7F)) * 8;
+  unsigned char invert = (code & 0x80) ? 0xFF : 0x00;
+  unsigned char romRow = (y % 3 == 0) ? 0 : (romChar[y / 3] ^ invert);
+  unsigned bits = 0;
+  for (unsigned x = 0; x < 8; x++)
+  {
+    if (romRow & (0x80 >> x))
+    {
+      bits |= 3 << (2 * x);
+    }
+  }
+  return bits;
+}
+
+void soft_glyphs_init(uint32_t foreground, uint32_t background)
+{
+  for (unsigned bank = 0; bank < GLYPH_BANKS; bank++)
+  {
+    for (unsigned code = 0; code < 256; code++)
+    {
+      uint32_t* pixel = soft_glyphs[bank][code];
+      for (unsigned y = 0; y < SOFT_GLYPH_HEIGHT; y++)
+      {
+        unsigned bits = glyph_row_bits(bank, (unsigned char)code, y);
+        for (unsigned x = 0; x < SOFT_GLYPH_WIDTH; x++)
+        {
+          *pixel++ = (bits & (1 << x)) ? foreground : background;
+        }
+      }
+    }
+  }
+}
+
+const uint32_t* soft_glyph(unsigned bank, unsigned char code)
+{
+  return soft_glyphs[bank][code];
+}
+
+// soft_glyphs_draw_cell copies a glyph to the cell at row, col of a frame,
+// stride is in pixels and may be negative for bottom-up frames
+void soft_glyphs_draw_cell(uint32_t* frame, int stride, unsigned row, unsigned col,
+  unsigned bank, unsigned char code)
+{
+  const uint32_t* src = soft_glyphs[bank][code];
+  uint32_t* dst = frame + (int)(row * SOFT_GLYPH_HEIGHT) * stride + col * SOFT_GLYPH_WIDTH;
+  for (unsigned y = 0; y < SOFT_GLYPH_HEIGHT; y++)
+  {
+    memcpy(dst, src, SOFT_GLYPH_WIDTH * sizeof(uint32_t));
+    src += SOFT_GLYPH_WIDTH;
+    dst += stride;
+  }
+}
@@ -0,0 +1,24 @@
+// software glyph atlas: the glyphs of glyphs.c as plain 32 bit pixels,
+// for rendering without OpenVG (CPU blits, offline rendering, remote viewing)
+
+#ifndef __softglyphs_h__
+#define __softglyphs_h__
+
+#include <stdint.h>
+
+#define SOFT_GLYPH_WIDTH  16
+#define SOFT_GLYPH_HEIGHT 24
+
+#define GLYPH_BANK_GRAPHIC 0
+#define GLYPH_BANK_TEXT    1
+#define GLYPH_BANKS        2
+
+#define GLYPH_BANK(graphic) ((graphic) ? GLYPH_BANK_GRAPHIC : GLYPH_BANK_TEXT)
+
+extern unsigned glyph_row_bits(unsigned bank, unsigned char code, unsigned y);
+extern void soft_glyphs_init(uint32_t foreground, uint32_t background);
+extern const uint32_t* soft_glyph(unsigned bank, unsigned char code);
+extern void soft_glyphs_draw_cell(uint32_t* frame, int stride, unsigned row, unsigned col,
+  unsigned bank, unsigned char code);
+
+#endif
@@ -0,0 +1,29 @@
+// network stream of decoded screens, see screenstream.c and streamclient.c
+//
+// The stream carries the records of recordings (see recording.h): a
+// keyframe when a viewer joins or lost track, then a delta (or scroll)
+// per changed screen. A delta is encoded once and the same bytes go to
+// every viewer, the record time is ms since the server started.
+//
+// TCP: the server sends "CBMSTR01", then records back to back. A viewer
+// that can't take a record in full gets the rest of it before anything
+// else and then a keyframe instead of the deltas it missed.
+//
+// UDP: a viewer sends STREAM_SUBSCRIBE to the server port at least every
+// STREAM_UDP_TIMEOUT_MS / 2 and gets datagrams of u32 sequence number
+// (little endian) followed by one record. After a gap in the sequence it
+// sends STREAM_KEYFRAME and ignores deltas until the next keyframe. All
+// UDP viewers also get a keyframe every STREAM_UDP_KEYFRAME_MS. A
+// keyframe datagram (2012 bytes) is fragmented on a 1500 byte MTU.
+
+#ifndef __stream_h__
+#define __stream_h__
+
+#define STREAM_PORT 6464
+#define STREAM_MAGIC "CBMSTR01"
+#define STREAM_SUBSCRIBE "SUB"
+#define STREAM_KEYFRAME "KEY"
+#define STREAM_UDP_TIMEOUT_MS 10000
+#define STREAM_UDP_KEYFRAME_MS 1000
+
+#endif
@@ -0,0 +1,270 @@
+// streamclient is a reference viewer for screenstream, see stream.h
+//
+// usage: streamclient [-u] [-q] host [port]
+//
+// Connects over TCP (or with -u subscribes over UDP) and shows the screen
+// as text in the terminal whenever it changes. -q shows nothing and
+// prints the records, resyncs and bytes received once per second instead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include "recording.h"
+#include "stream.h"
+
+static unsigned char screen[SCREEN_SIZE];
+static unsigned char graphic = 1;
+static int quiet = 0;
+static unsigned long records = 0;
+static unsigned long resyncs = 0;
+static unsigned long long bytes = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// text shows screen codes as ASCII, reverse video and graphic
+// characters as they are
+static char text(unsigned char code)
+{
+  code &= 0x7F;
+  if (code == 0)
+  {
+    return '@';
+  }
+  if (code <= 26)
+  {
+    return 'A' + code - 1;
+  }
+  if (code >= 32 && code < 64)
+  {
+    return code;
+  }
+  return '#';
+}
+
+static void show(uint32_t time)
+{
+  if (quiet)
+  {
+    return;
+  }
+  printf("\033[H\033[2Jtime %.3f s, graphic %u\n", time / 1000.0, graphic);
+  for (unsigned row = 0; row < SCREEN_ROWS; row++)
+  {
+    char line[SCREEN_COLS + 1];
+    for (unsigned col = 0; col < SCREEN_COLS; col++)
+    {
+      line[col] = text(screen[row * SCREEN_COLS + col]);
+    }
+    line[SCREEN_COLS] = 0;
+    puts(line);
+  }
+  fflush(stdout);
+}
+
+static void report(double* last_report)
+{
+  if (quiet && now() - *last_report >= 1.0)
+  {
+    printf("%lu records, %lu resyncs, %llu bytes\n", records, resyncs, bytes);
+    fflush(stdout);
+    *last_report = now();
+  }
+}
+
+static int connect_to(const char* host, const char* port, int type)
+{
+  struct addrinfo hints, *addresses;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = type;
+  int error = getaddrinfo(host, port, &hints, &addresses);
+  if (error != 0)
+  {
+    fprintf(stderr, "%s: %s\n", host, gai_strerror(error));
+    return -1;
+  }
+  int fd = -1;
+  for (struct addrinfo* address = addresses; address != NULL && fd < 0; address = address->ai_next)
+  {
+    fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) < 0)
+    {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0)
+  {
+    perror(host);
+  }
+  return fd;
+}
+
+static int view_tcp(int fd)
+{
+  static unsigned char buffer[2 * RECORD_MAX];
+  unsigned buffered = 0;
+  int started = 0;
+  double last_report = now();
+  for (;;)
+  {
+    ssize_t size = recv(fd, buffer + buffered, sizeof(buffer) - buffered, 0);
+    if (size <= 0)
+    {
+      fprintf(stderr, "connection closed\n");
+      return 1;
+    }
+    bytes += size;
+    buffered += size;
+    unsigned offset = 0;
+    if (!started && buffered >= 8)
+    {
+      if (memcmp(buffer, STREAM_MAGIC, 8) != 0)
+      {
+        fprintf(stderr, "not a screen stream\n");
+        return 1;
+      }
+      started = 1;
+      offset = 8;
+    }
+    while (started && buffered - offset >= 8)
+    {
+      unsigned length = 8 + (buffer[offset + 2] | (buffer[offset + 3] << 8));
+      if (buffered - offset < length)
+      {
+        break;
+      }
+      uint32_t time;
+      if (!record_decode(buffer + offset, length, screen, &graphic, &time))
+      {
+        fprintf(stderr, "bad record\n");
+        return 1;
+      }
+      records++;
+      offset += length;
+      show(time);
+    }
+    memmove(buffer, buffer + offset, buffered - offset);
+    buffered -= offset;
+    report(&last_report);
+  }
+}
+
+static int view_udp(int fd)
+{
+  static unsigned char datagram[65536];
+  int synced = 0;
+  uint32_t expected = 0;
+  double last_subscribe = 0.0;
+  double last_report = now();
+  for (;;)
+  {
+    if (now() - last_subscribe > STREAM_UDP_TIMEOUT_MS / 4000.0)
+    {
+      send(fd, STREAM_SUBSCRIBE, strlen(STREAM_SUBSCRIBE), 0);
+      last_subscribe = now();
+    }
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, 500) <= 0)
+    {
+      report(&last_report);
+      continue;
+    }
+    ssize_t size = recv(fd, datagram, sizeof(datagram), 0);
+    if (size < 0)
+    {
+      perror("recv"); // the server is gone
+      return 1;
+    }
+    if (size < 12)
+    {
+      continue;
+    }
+    bytes += size;
+    records++;
+    uint32_t number = datagram[0] | (datagram[1] << 8) | (datagram[2] << 16) | ((uint32_t)datagram[3] << 24);
+    uint32_t time;
+    if (datagram[4] == RECORD_KEYFRAME)
+    {
+      synced = record_decode(datagram + 4, size - 4, screen, &graphic, &time);
+      expected = number + 1;
+      if (synced)
+      {
+        show(time);
+      }
+    }
+    else if (synced && number == expected)
+    {
+      synced = record_decode(datagram + 4, size - 4, screen, &graphic, &time);
+      expected++;
+      if (synced)
+      {
+        show(time);
+      }
+    }
+    else if (synced)
+    {
+      // a delta went missing, the screen stays until the next keyframe
+      synced = 0;
+      resyncs++;
+      send(fd, STREAM_KEYFRAME, strlen(STREAM_KEYFRAME), 0);
+    }
+    report(&last_report);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  int udp = 0;
+  const char* host = NULL;
+  const char* port = NULL;
+  char default_port[8];
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-u") == 0)
+    {
+      udp = 1;
+    }
+    else if (strcmp(argv[i], "-q") == 0)
+    {
+      quiet = 1;
+    }
+    else if (host == NULL)
+    {
+      host = argv[i];
+    }
+    else
+    {
+      port = argv[i];
+    }
+  }
+  if (host == NULL)
+  {
+    fprintf(stderr, "usage: streamclient [-u] [-q] host [port]\n");
+    return 2;
+  }
+  if (port == NULL)
+  {
+    snprintf(default_port, sizeof(default_port), "%u", STREAM_PORT);
+    port = default_port;
+  }
+  memset(screen, ' ', SCREEN_SIZE);
+  int fd = connect_to(host, port, udp ? SOCK_DGRAM : SOCK_STREAM);
+  if (fd < 0)
+  {
+    return 1;
+  }
+  return udp ? view_udp(fd) : view_tcp(fd);
+}
@@ -0,0 +1,243 @@
+// teecheck checks what a consumer of serialtee gets, with a reader that stalls
+//
+// usage: teecheck -w bytes file
+//        teecheck [-s stall seconds] [-n ring KB] path
+//
+// -w writes a source of the given size: big endian 32 bit words counting
+// up from 0, so the stream offset of any 8 bytes follows from their value.
+// Otherwise the path (a FIFO attached to serialtee, or a file it wrote) is
+// read up to its first bytes, then after a stall of -s seconds (default 6), and
+// checked to be in-order segments of that source. A -d consumer may miss
+// bytes, but every byte it gets must be the source byte at its offset; a
+// byte that isn't is counted as corrupted.
+// The bytes a FIFO held during the stall were passed on by serialtee at
+// its start, so they are less than its ring (-n, as given to serialtee)
+// after the bytes read before. Later ones are the bytes of a ring page
+// that was refilled while the pipe still referenced it; they look like a
+// gap in the source, but are counted as corrupted too, e.g.
+//   teecheck -w 20000000 /tmp/count.bin && mkfifo /tmp/slow
+//   serialtee -n 2048 -r 8000000 /tmp/count.bin -d /tmp/slow &
+//   teecheck -s 6 -n 2048 /tmp/slow
+// A -b consumer has to get the whole source in one segment.
+// Exits with 1 if bytes were corrupted.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#define CHUNK (64 * 1024)
+#define RESYNC 16 // bytes that must match the source to find the offset again
+
+static unsigned char source_byte(uint64_t offset)
+{
+  uint32_t word = (uint32_t)(offset / 4);
+  return (unsigned char)(word >> (8 * (3 - offset % 4)));
+}
+
+static int matches(const unsigned char* bytes, size_t length, uint64_t offset)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    if (bytes[i] != source_byte(offset + i))
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// resync returns the source offset of bytes, which follow a gap after
+// expected, or -1 if they aren't RESYNC bytes of the source after it
+static int64_t resync(const unsigned char* bytes, uint64_t expected)
+{
+  for (unsigned phase = 0; phase < 4; phase++)
+  {
+    // the first whole word of bytes if they start at a source offset with this phase
+    unsigned first = (4 - phase) % 4;
+    uint32_t word = (uint32_t)bytes[first] << 24 | bytes[first + 1] << 16 | bytes[first + 2] << 8 | bytes[first + 3];
+    uint64_t offset = (uint64_t)word * 4;
+    if (offset < first)
+    {
+      continue;
+    }
+    offset -= first;
+    if (offset > expected && matches(bytes, RESYNC, offset))
+    {
+      return (int64_t)offset;
+    }
+  }
+  return -1;
+}
+
+static int write_source(const char* path, uint64_t size)
+{
+  FILE* file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    perror(path);
+    return 1;
+  }
+  for (uint64_t offset = 0; offset < size; offset++)
+  {
+    fputc(source_byte(offset), file);
+  }
+  if (fclose(file) != 0)
+  {
+    perror(path);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  const char* path = NULL;
+  double stall = 6.0;
+  uint64_t ring_size = 4096 * 1024;
+  uint64_t write_size = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+    {
+      stall = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+    {
+      ring_size = strtoull(argv[++i], NULL, 10) * 1024;
+    }
+    else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+    {
+      write_size = strtoull(argv[++i], NULL, 10);
+    }
+    else if (argv[i][0] != '-')
+    {
+      path = argv[i];
+    }
+  }
+  if (path == NULL)
+  {
+    fprintf(stderr, "usage: teecheck -w bytes file | teecheck [-s stall seconds] [-n ring KB] path\n");
+    return 2;
+  }
+  if (write_size > 0)
+  {
+    return write_source(path, write_size);
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    perror(path);
+    return 1;
+  }
+  struct stat st;
+  int is_fifo = fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+
+  // the bytes not checked yet, a resync needs RESYNC of them at once
+  static unsigned char buffer[CHUNK + RESYNC];
+  size_t buffered = 0;
+  uint64_t expected = 0; // source offset of the next byte
+  uint64_t received = 0;
+  uint64_t corrupted = 0;
+  uint64_t missed = 0;
+  size_t unchecked = 0;
+  unsigned segments = 0;
+  int synced = 0;
+  int stalled = 0;
+  // the bytes the FIFO held during the stall, by their index in what was received
+  uint64_t held_first = 0;
+  uint64_t held_end = 0;
+  uint64_t stall_offset = 0; // source offset of the next byte at the stall
+  for (;;)
+  {
+    ssize_t length = read(fd, buffer + buffered, CHUNK);
+    if (length < 0)
+    {
+      perror(path);
+      return 1;
+    }
+    int done = length == 0;
+    received += length;
+    buffered += length;
+
+    size_t checked = 0;
+    while (checked < buffered)
+    {
+      if (synced && buffer[checked] == source_byte(expected))
+      {
+        uint64_t index = received - buffered + checked;
+        if (index >= held_first && index < held_end && expected >= stall_offset + ring_size)
+        {
+          corrupted++; // from a ring page refilled after it was passed on
+        }
+        checked++;
+        expected++;
+        continue;
+      }
+      if (buffered - checked < RESYNC)
+      {
+        if (!done)
+        {
+          break; // wait for more bytes to find the offset
+        }
+        // too few bytes after a gap at the end to tell where they are from
+        unchecked = buffered - checked;
+        checked = buffered;
+        continue;
+      }
+      int64_t offset = resync(buffer + checked, synced ? expected : 0);
+      if (offset < 0 && !synced && matches(buffer + checked, RESYNC, 0))
+      {
+        offset = 0;
+      }
+      if (offset < 0)
+      {
+        // neither the next source byte nor a later part of the source
+        corrupted++;
+        checked++;
+        if (synced)
+        {
+          expected++;
+        }
+        continue;
+      }
+      if (synced)
+      {
+        missed += (uint64_t)offset - expected;
+      }
+      expected = (uint64_t)offset;
+      synced = 1;
+      segments++;
+    }
+    memmove(buffer, buffer + checked, buffered - checked);
+    buffered -= checked;
+
+    if (done)
+    {
+      break;
+    }
+    if (!stalled && synced)
+    {
+      // a reader that stops for a while, e.g. a decoder stopped in a debugger
+      usleep((useconds_t)(stall * 1e6));
+      stalled = 1;
+      int held;
+      if (is_fifo && ioctl(fd, FIONREAD, &held) == 0)
+      {
+        held_first = received;
+        held_end = received + held;
+        stall_offset = expected;
+      }
+    }
+  }
+  close(fd);
+
+  printf("%llu bytes received, %u segments, %llu bytes missed between them, %llu corrupted, %zu unchecked at the end\n",
+    (unsigned long long)received, segments, (unsigned long long)missed, (unsigned long long)corrupted, unchecked);
+  return corrupted > 0 ? 1 : 0;
+}
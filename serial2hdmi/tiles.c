@@ -0,0 +1,53 @@
+#include "tiles.h"
+
+#define SCREEN_PIXELS_W (80 * 16)
+#define SCREEN_PIXELS_H (25 * 24)
+
+// tile_scale returns the largest multiple of 1/8 that fits a screen into
+// a tile, at least 1/8
+static float tile_scale(int tile_w, int tile_h)
+{
+  int eighths_w = tile_w * 8 / SCREEN_PIXELS_W;
+  int eighths_h = tile_h * 8 / SCREEN_PIXELS_H;
+  int eighths = eighths_w < eighths_h ? eighths_w : eighths_h;
+  return (eighths > 0 ? eighths : 1) / 8.0f;
+}
+
+// tile_layout picks the grid for count screens (1 to MAX_TILES) with the
+// largest glyph scale, preferring fewer columns on a tie
+void tile_layout(t_tile_layout* layout, unsigned count, int screen_w, int screen_h)
+{
+  if (count < 1)
+  {
+    count = 1;
+  }
+  if (count > MAX_TILES)
+  {
+    count = MAX_TILES;
+  }
+  layout->count = count;
+  layout->scale = 0.0f;
+  for (unsigned columns = 1; columns <= count; columns++)
+  {
+    unsigned rows = (count + columns - 1) / columns;
+    float scale = tile_scale(screen_w / columns, screen_h / rows);
+    if (scale > layout->scale)
+    {
+      layout->columns = columns;
+      layout->rows = rows;
+      layout->tile_w = screen_w / columns;
+      layout->tile_h = screen_h / rows;
+      layout->scale = scale;
+    }
+  }
+}
+
+// tile_origin returns the bottom left corner of a tile in surface
+// coordinates, which start at the bottom of the display
+void tile_origin(const t_tile_layout* layout, unsigned tile, int screen_h, int* x, int* y)
+{
+  unsigned column = tile % layout->columns;
+  unsigned row = tile / layout->columns;
+  *x = column * layout->tile_w;
+  *y = screen_h - (row + 1) * layout->tile_h;
+}
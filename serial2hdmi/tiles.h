@@ -0,0 +1,26 @@
+// layout of several 80x25 screens as tiles on one display
+//
+// The layout is a grid of columns x rows tiles, chosen for the number of
+// screens so the glyphs get the largest scale. The scale is a multiple of
+// 1/8, which makes a 16x24 glyph cover whole pixels (2k x 3k), so scaled
+// glyphs stay as crisp as the atlas allows and tiles don't shimmer at
+// their edges. Tiles are numbered left to right, top to bottom.
+
+#ifndef __tiles_h__
+#define __tiles_h__
+
+#define MAX_TILES 4
+
+typedef struct {
+  unsigned count;
+  unsigned columns;
+  unsigned rows;
+  int tile_w;
+  int tile_h;
+  float scale;
+} t_tile_layout;
+
+extern void tile_layout(t_tile_layout* layout, unsigned count, int screen_w, int screen_h);
+extern void tile_origin(const t_tile_layout* layout, unsigned tile, int screen_h, int* x, int* y);
+
+#endif
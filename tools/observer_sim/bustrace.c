@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <string.h>
+#include "bustrace.h"
+
+#define TRACE_MAGIC "CBMBUS01"
+#define TRACE_BUFFER (1 << 20)
+
+static void put_u32(unsigned char* p, uint32_t value)
+{
+  p[0] = value;
+  p[1] = value >> 8;
+  p[2] = value >> 16;
+  p[3] = value >> 24;
+}
+
+int trace_writer_open(t_trace_writer* writer, const char* filename)
+{
+  writer->fp = fopen(filename, "wb");
+  if (writer->fp == NULL)
+  {
+    perror(filename);
+    return -1;
+  }
+  setvbuf(writer->fp, NULL, _IOFBF, TRACE_BUFFER);
+  unsigned char header[12];
+  memcpy(header, TRACE_MAGIC, 8);
+  put_u32(header + 8, BUSTRACE_TICKS_PER_SECOND);
+  if (fwrite(header, 1, sizeof(header), writer->fp) != sizeof(header))
+  {
+    perror(filename);
+    fclose(writer->fp);
+    return -1;
+  }
+  writer->time = 0;
+  writer->next_address = 0x10000;
+  writer->events = 0;
+  return 0;
+}
+
+// trace_write appends an event, events must come in the order of their times
+int trace_write(t_trace_writer* writer, const t_bus_event* event)
+{
+  if (event->time < writer->time)
+  {
+    fprintf(stderr, "bus trace event at %llu before the previous one at %llu\n",
+      (unsigned long long)event->time, (unsigned long long)writer->time);
+    return -1;
+  }
+  unsigned char record[16];
+  unsigned length = 0;
+  uint64_t delta = event->time - writer->time;
+  do
+  {
+    record[length++] = (delta & 0x7F) | (delta > 0x7F ? 0x80 : 0);
+    delta >>= 7;
+  } while (delta != 0);
+
+  switch (event->type)
+  {
+  case BUS_WRITE:
+    if (event->address == writer->next_address)
+    {
+      record[length++] = 'N';
+    }
+    else
+    {
+      record[length++] = 'W';
+      record[length++] = event->address;
+      record[length++] = event->address >> 8;
+    }
+    record[length++] = event->data;
+    writer->next_address = event->address + 1;
+    break;
+
+  case BUS_GRAPHIC:
+    record[length++] = 'G';
+    record[length++] = event->data;
+    break;
+
+  case BUS_SYNC:
+    record[length++] = 'F';
+    break;
+
+  default:
+    fprintf(stderr, "unknown bus trace event %c\n", event->type);
+    return -1;
+  }
+  writer->time = event->time;
+  writer->events++;
+  return fwrite(record, 1, length, writer->fp) == length ? 0 : -1;
+}
+
+int trace_writer_close(t_trace_writer* writer)
+{
+  return fclose(writer->fp) == 0 ? 0 : -1;
+}
+
+//----------------------------------------------------------------------------------------
+
+int trace_reader_open(t_trace_reader* reader, const char* filename)
+{
+  reader->fp = fopen(filename, "rb");
+  if (reader->fp == NULL)
+  {
+    perror(filename);
+    return -1;
+  }
+  setvbuf(reader->fp, NULL, _IOFBF, TRACE_BUFFER);
+  unsigned char header[12];
+  if (fread(header, 1, sizeof(header), reader->fp) != sizeof(header) || memcmp(header, TRACE_MAGIC, 8) != 0)
+  {
+    fprintf(stderr, "%s: not a bus trace\n", filename);
+    fclose(reader->fp);
+    return -1;
+  }
+  uint32_t rate = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t)header[11] << 24);
+  if (rate != BUSTRACE_TICKS_PER_SECOND)
+  {
+    fprintf(stderr, "%s: timestamps in %u ticks per second are not supported\n", filename, rate);
+    fclose(reader->fp);
+    return -1;
+  }
+  reader->time = 0;
+  reader->next_address = 0x10000;
+  reader->events = 0;
+  return 0;
+}
+
+// trace_read returns 1 with the next event, 0 at the end of the trace and
+// -1 if the trace is damaged or cut off in the middle of an event
+int trace_read(t_trace_reader* reader, t_bus_event* event)
+{
+  FILE* fp = reader->fp;
+  int c = getc(fp);
+  if (c == EOF)
+  {
+    return 0;
+  }
+  uint64_t delta = 0;
+  unsigned shift = 0;
+  while (c & 0x80)
+  {
+    delta |= (uint64_t)(c & 0x7F) << shift;
+    shift += 7;
+    c = getc(fp);
+    if (c == EOF || shift > 56)
+    {
+      return -1;
+    }
+  }
+  delta |= (uint64_t)c << shift;
+  reader->time += delta;
+  event->time = reader->time;
+
+  int type = getc(fp);
+  int low, high, data;
+  switch (type)
+  {
+  case 'W':
+    low = getc(fp);
+    high = getc(fp);
+    data = getc(fp);
+    if (data == EOF)
+    {
+      return -1;
+    }
+    event->type = BUS_WRITE;
+    event->address = low | (high << 8);
+    event->data = data;
+    reader->next_address = event->address + 1;
+    break;
+
+  case 'N':
+    data = getc(fp);
+    if (data == EOF || reader->next_address > 0xFFFF)
+    {
+      return -1;
+    }
+    event->type = BUS_WRITE;
+    event->address = reader->next_address;
+    event->data = data;
+    reader->next_address = event->address + 1;
+    break;
+
+  case 'G':
+    data = getc(fp);
+    if (data == EOF)
+    {
+      return -1;
+    }
+    event->type = BUS_GRAPHIC;
+    event->data = data;
+    break;
+
+  case 'F':
+    event->type = BUS_SYNC;
+    break;
+
+  default:
+    return -1;
+  }
+  reader->events++;
+  return 1;
+}
+
+void trace_reader_close(t_trace_reader* reader)
+{
+  fclose(reader->fp);
+}
@@ -0,0 +1,63 @@
+// bus traces are what the observer sees of a CBM: writes to the screen
+// memory, the graphic pin and the frame sync, with their times
+//
+// File layout, all numbers little endian:
+//
+//   header   "CBMBUS01", u32 ticks per second of the timestamps (100000000,
+//            the XMOS reference clock)
+//   events   varint ticks since the previous event (7 bits per byte, low
+//            bits first, high bit set if more follow), then u8 type:
+//            'W' write: u16 CPU address, u8 data
+//            'N' write to the address after the previous write: u8 data
+//            'G' graphic pin: u8 level
+//            'F' frame sync
+//
+// A burst of screen writes in ascending order, like a scroll or a printed
+// line, takes 3 or 4 bytes per write, an hour of a busy 50 Hz screen a few
+// 100 MB. The addresses are those on the CPU bus, the decoding to the
+// observer's 0x8000..0x87CF window is left to the consumer.
+
+#ifndef __bustrace_h__
+#define __bustrace_h__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define BUSTRACE_TICKS_PER_SECOND 100000000
+
+#define BUS_WRITE   'W'
+#define BUS_GRAPHIC 'G'
+#define BUS_SYNC    'F'
+
+#define BUS_SCREEN_ADDRESS 0x8000
+
+typedef struct {
+  uint64_t time; // in ticks since the start of the trace
+  unsigned char type;
+  uint16_t address; // BUS_WRITE
+  unsigned char data; // BUS_WRITE data, BUS_GRAPHIC level
+} t_bus_event;
+
+typedef struct {
+  FILE* fp;
+  uint64_t time;
+  uint32_t next_address; // after the previous write, or > 0xFFFF
+  uint64_t events;
+} t_trace_writer;
+
+typedef struct {
+  FILE* fp;
+  uint64_t time;
+  uint32_t next_address;
+  uint64_t events;
+} t_trace_reader;
+
+extern int trace_writer_open(t_trace_writer* writer, const char* filename);
+extern int trace_write(t_trace_writer* writer, const t_bus_event* event);
+extern int trace_writer_close(t_trace_writer* writer);
+
+extern int trace_reader_open(t_trace_reader* reader, const char* filename);
+extern int trace_read(t_trace_reader* reader, t_bus_event* event);
+extern void trace_reader_close(t_trace_reader* reader);
+
+#endif
@@ -0,0 +1,29 @@
+// time the firmware's threads take for their steps, in ticks of 10 ns
+//
+// Estimates for threads running at 62.5 MIPS (the startKIT's 500 MHz
+// shared by up to 8 threads) from the instruction counts of the loops and
+// the measurements noted in nbsp.xc and app_fast_cbm_video_observer.xc.
+// Relative numbers (skips, utilisation, which setting is better) hold up
+// well, absolute latencies should be checked against the hardware.
+
+#ifndef __costs_h__
+#define __costs_h__
+
+#define SELECT_COST           23 // enter the select and take the ready case (TIME_TO_LOOP in nbsp.xc)
+#define CHANNEL_LATENCY        4 // a token through the switch on the same tile
+#define NBSP_SEND_COST        16 // nbsp_send straight to the channel: outct DATA, out
+#define NBSP_QUEUE_COST       13 // nbsp_send into the buffer: queue_in
+#define NBSP_HANDLE_COST      19 // nbsp_handle_msg: outct END, or outct PAUSE and queue_out
+#define NBSP_BURST_WORD_COST   3 // nbsp_udnw_*: an out or in per word of a burst
+#define NBSP_CHANNEL_WORDS     2 // words the receiving channel end buffers
+#define RENDER_BYTE_COST      16 // renderer: index arithmetic and video_memory_read_from_copy (in tx_word)
+#define COPY_START_COST       35 // timer wake up to the first byte copied (250..350 ns)
+#define COPY_LINE_COST       270 // the rest of video_memory_copy_line_to (80 bytes at > 30 MB/s)
+#define COPY_FLAGS_COST      150 // video_memory_copy_flags_to
+#define FRAME_TIMING_COST     80 // frame_timing_sync, divisions included
+#define MEMORY_OBSERVER_DELAY 70 // trigger to sampling the address and data ports
+#define MEMORY_WRITE_COST     30 // decoding the address and video_memory_write_data
+#define UART_START_COST       12 // from taking the data to the start bit
+#define UART_LOOP_COST         8 // from the end of the stop bit back to the select
+
+#endif
@@ -0,0 +1,123 @@
+#include "nbsp_model.h"
+#include "costs.h"
+
+void t_nbsp_model::send_data(unsigned word)
+{
+  owner.spend(NBSP_SEND_COST);
+  peer->owner.deliver(owner.when() + CHANNEL_LATENCY, peer->input, word);
+  control_tokens += 1;
+  data_tokens += 4;
+  words_sent += 1;
+}
+
+unsigned t_nbsp_model::send(unsigned word)
+{
+  if (words_to_be_acknowledged == 0)
+  {
+    // buffer must be empty, we can immediately send, no need for buffering
+    send_data(word);
+    words_to_be_acknowledged = 1;
+    return 1;
+  }
+  // busy sending, must buffer the data, the buffer holds one word less
+  // than its size
+  owner.spend(NBSP_QUEUE_COST);
+  if (queue.size() + 1 >= buffer_size)
+  {
+    return 0;
+  }
+  queue.push_back(word);
+  return 1;
+}
+
+unsigned t_nbsp_model::handle_msg(uint64_t message)
+{
+  owner.spend(NBSP_HANDLE_COST);
+  control_tokens += 1;
+  if (message & NBSP_MESSAGE_ACK)
+  {
+    // PAUSE closes the route, then the next word if there is one
+    if (!queue.empty())
+    {
+      unsigned word = queue.front();
+      queue.pop_front();
+      send_data(word);
+    }
+    else
+    {
+      words_to_be_acknowledged = 0;
+    }
+    return 0;
+  }
+  data = (unsigned)message;
+  peer->owner.deliver(owner.when() + CHANNEL_LATENCY, peer->input, NBSP_MESSAGE_ACK);
+  return 1;
+}
+
+//----------------------------------------------------------------------------------------
+
+void t_nbsp_model::send_burst(const unsigned* words, unsigned n)
+{
+  owner.spend(NBSP_BURST_WORD_COST * n);
+  for (unsigned i = 0; i < n; i++)
+  {
+    peer->incoming.push_back(words[i]);
+  }
+  if (n > NBSP_CHANNEL_WORDS)
+  {
+    // the outs beyond the channel end's buffer wait for the receiver
+    owner.busy_until(peer->owner.free_time());
+  }
+  peer->owner.deliver(owner.when() + CHANNEL_LATENCY, peer->input, NBSP_MESSAGE_BURST);
+  data_tokens += 4 * n;
+  words_sent += n;
+}
+
+unsigned t_nbsp_model::burst_send(const unsigned* words, unsigned n)
+{
+  burst_words = n;
+  if (words_to_be_acknowledged == 0)
+  {
+    send_burst(words, n);
+    words_to_be_acknowledged = n;
+    return 1;
+  }
+  owner.spend(NBSP_QUEUE_COST * n);
+  if (queue.size() + n >= buffer_size)
+  {
+    return 0;
+  }
+  queue.insert(queue.end(), words, words + n);
+  return 1;
+}
+
+void t_nbsp_model::burst_handle_ack()
+{
+  owner.spend(NBSP_HANDLE_COST);
+  if (queue.size() >= burst_words)
+  {
+    unsigned words[NBSP_MAX_BURST];
+    for (unsigned i = 0; i < burst_words; i++)
+    {
+      words[i] = queue.front();
+      queue.pop_front();
+    }
+    send_burst(words, burst_words);
+  }
+  else
+  {
+    words_to_be_acknowledged = 0;
+  }
+}
+
+void t_nbsp_model::burst_receive(unsigned* words, unsigned n)
+{
+  owner.spend(NBSP_BURST_WORD_COST * n);
+  for (unsigned i = 0; i < n; i++)
+  {
+    words[i] = incoming.front();
+    incoming.pop_front();
+  }
+  control_tokens += 1;
+  peer->owner.deliver(owner.when() + CHANNEL_LATENCY, peer->input, NBSP_MESSAGE_ACK);
+}
@@ -0,0 +1,71 @@
+// model of one end of an nbsp channel (ws/module_nbsp), following nbsp.xc
+//
+// The end belongs to a t_task, the peer's messages arrive there as input
+// `input` with the data in the lower 32 bits of the argument and
+// NBSP_MESSAGE_ACK set for an acknowledgement. The task passes them to
+// handle_msg() just like the firmware calls nbsp_handle_msg() after
+// NBSP_RECEIVE_MSG. The tokens on the channel are counted:
+//
+//   data word: DATA control token, 4 data tokens, PAUSE control token
+//   ack:       END control token
+//
+// The burst variant (nbsp_udnw_*) sends n data words without control
+// tokens, announced to the receiver as input with NBSP_MESSAGE_BURST, and
+// acknowledged with one END token. Bursts of more words than the receiving
+// channel end buffers block the sender until the receiver is back in its
+// select.
+
+#ifndef __nbsp_model_h__
+#define __nbsp_model_h__
+
+#include <deque>
+#include "scheduler.h"
+
+#define NBSP_MESSAGE_ACK   (1ULL << 32)
+#define NBSP_MESSAGE_BURST (1ULL << 33)
+
+#define NBSP_MAX_BURST 16 // words
+
+class t_nbsp_model
+{
+public:
+  // buffer_size as given to NBSP_INIT_WITH_BUFFER, 0 for NBSP_INIT_NO_BUFFER
+  t_nbsp_model(t_task& owner, int input, unsigned buffer_size)
+    : owner(owner), input(input), buffer_size(buffer_size) {}
+
+  void connect(t_nbsp_model& other)
+  {
+    peer = &other;
+    other.peer = this;
+  }
+
+  unsigned send(unsigned data);                // nbsp_send
+  unsigned handle_msg(uint64_t message);       // nbsp_handle_msg
+  unsigned received_data() const { return data; }
+  unsigned pending_words_to_send() const { return queue.size() + words_to_be_acknowledged; }
+
+  unsigned burst_send(const unsigned* words, unsigned n); // nbsp_udnw_send
+  void burst_handle_ack();                               // nbsp_udnw_handle_ack
+  void burst_receive(unsigned* words, unsigned n);       // nbsp_udnw_receive
+
+  // tokens this end put on the channel
+  uint64_t control_tokens = 0;
+  uint64_t data_tokens = 0;
+  uint64_t words_sent = 0;
+
+private:
+  t_task& owner;
+  int input;
+  unsigned buffer_size;
+  t_nbsp_model* peer = nullptr;
+  std::deque<unsigned> queue;
+  unsigned words_to_be_acknowledged = 0;
+  unsigned data = 0;
+  unsigned burst_words = 0;
+  std::deque<unsigned> incoming; // burst words in the channel
+
+  void send_data(unsigned word);
+  void send_burst(const unsigned* words, unsigned n);
+};
+
+#endif
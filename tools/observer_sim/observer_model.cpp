@@ -0,0 +1,1015 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <deque>
+#include <random>
+#include "observer_model.h"
+#include "nbsp_model.h"
+#include "costs.h"
+
+extern "C" {
+#include "video_memory.h"
+#include "frame_timing.h"
+#include "receiver.h"
+#include "bustrace.h"
+}
+
+#define FRAME_RING 64 // frames of CRT screens and sync times kept for comparing
+
+// as in app_fast_cbm_video_observer.xc
+#define LINES_COPIED_ALL 26
+
+// when the CRT latches its first line after the frame sync, what
+// frame_timing assumes at 50 and 60 Hz
+static unsigned first_line_latch(unsigned fps)
+{
+  return fps == 60 ? 370000 : 520000;
+}
+
+// inputs, in the case order of the firmware's selects
+enum
+{
+  PET_SYNC, PET_LATCH, PET_WRITE, PET_GRAPHIC,
+  OBSERVER_TRIGGER = 0, OBSERVER_GRAPHIC, OBSERVER_APPLY,
+  FRAME_SYNC = 0, FRAME_COPY_LINE, FRAME_COPY_FLAGS, FRAME_OBSERVER_MSG,
+  RENDER_OBSERVER_MSG = 0, RENDER_TX_MSG, RENDER_LINE, RENDER_WIRE,
+  UART_TX_MSG = 0
+};
+
+struct t_frame_truth
+{
+  unsigned long frame;
+  t_time sync_time;
+  unsigned char screen[SCREEN_SIZE]; // what the CRT showed
+};
+
+struct t_byte_meta
+{
+  unsigned long frame; // the PET frame the renderer's buffer was copied in
+};
+
+class t_pipeline;
+
+//----------------------------------------------------------------------------------------
+// the PET: frame sync, CRT and bus writes
+
+class t_pet : public t_task
+{
+public:
+  t_pet(t_scheduler& scheduler, t_pipeline& pipeline) : t_task(scheduler, 0), pipeline(pipeline) {}
+
+  unsigned char ram[SCREEN_SIZE];
+  t_frame_truth frames[FRAME_RING];
+  bool finished = false; // the trace is over
+  t_time finish_time = 0;
+
+  int start(t_time time);
+  void handle(int what, uint64_t arg) override;
+
+private:
+  t_pipeline& pipeline;
+  t_trace_reader reader;
+  bool replaying = false;
+  t_time trace_start = 0;
+  unsigned long frame = 0;
+  unsigned graphic = 0;
+  void synthetic_frame(t_time now);
+  void replay_frame();
+  t_time line_scan[SCREEN_ROWS] = {}; // when the CRT started latching each line
+  unsigned long line_frame[SCREEN_ROWS] = {};
+};
+
+//----------------------------------------------------------------------------------------
+// the firmware's threads
+
+class t_memory_observer : public t_task
+{
+public:
+  t_memory_observer(t_scheduler& scheduler, t_pipeline& pipeline) : t_task(scheduler, SELECT_COST), pipeline(pipeline) {}
+  void handle(int what, uint64_t arg) override;
+
+private:
+  t_pipeline& pipeline;
+};
+
+class t_frame_observer : public t_task
+{
+public:
+  t_frame_observer(t_scheduler& scheduler, t_pipeline& pipeline);
+  t_nbsp_model observer_state;
+  unsigned long buffer_frame[MAX_BUF_COPIES]; // which PET frame each copy holds
+  void handle(int what, uint64_t arg) override;
+
+private:
+  t_pipeline& pipeline;
+  unsigned buf_num = 0;
+  unsigned line = 0;
+  unsigned time = 0;
+  void wait_for_timer(unsigned time, int what);
+};
+
+// t_send_order picks the copy the renderer sends, for t_renderer and
+// t_fast_link: the one being sent gets the lines copied since, with
+// send_newest the newest copy that came meanwhile follows once the frame
+// is out, and the copies not sent are counted in the flags
+class t_send_order
+{
+public:
+  t_send_order(t_pipeline& pipeline);
+  unsigned sending = 0;
+  unsigned buf_num;          // the copy sent last
+  unsigned lines_copied = 0;
+
+  // message takes a message of frame_observer
+  void message(unsigned copied);
+  // start goes on with the next copy when the frame is out, returns false
+  // if there is none
+  bool start();
+
+private:
+  t_pipeline& pipeline;
+  bool next = false;
+  unsigned next_buf_num = 0;
+  unsigned next_lines_copied = 0;
+  unsigned skipped = 0;
+  unsigned superseded = 0;
+};
+
+class t_renderer : public t_task
+{
+public:
+  t_renderer(t_scheduler& scheduler, t_pipeline& pipeline);
+  t_nbsp_model observer_state;
+  t_nbsp_model tx_state;
+  void handle(int what, uint64_t arg) override;
+
+  // sending_from reports whether the renderer still reads from buffer
+  bool sending_from(unsigned buffer) const
+  {
+    return order.sending && order.buf_num == buffer;
+  }
+
+private:
+  t_pipeline& pipeline;
+  t_send_order order;
+  unsigned line = 0;
+  int ch_index = 0;
+  unsigned tx_word(unsigned& next_line, int& next_ch_index);
+  bool next_ready() const;
+  bool send_next();
+};
+
+// t_fast_link stands in for renderer and uart_tx with fast_wire: it takes
+// the copies like the renderer, but reads a whole line at once and computes
+// the times the bytes leave the wire from the nbsp buffer and the bit rate.
+// The host gets the bytes when the time comes, so that it compares with the
+// CRT lines latched by then.
+class t_fast_link : public t_task
+{
+public:
+  t_fast_link(t_scheduler& scheduler, t_pipeline& pipeline);
+  t_nbsp_model observer_state;
+  void handle(int what, uint64_t arg) override;
+
+  bool sending_from(unsigned buffer) const
+  {
+    return order.sending && order.buf_num == buffer;
+  }
+
+private:
+  t_pipeline& pipeline;
+  t_send_order order;
+  unsigned line = 0;
+  bool waiting = false; // for the next line to be copied
+  t_time wire_free = 0;
+  uint64_t bytes = 0;
+  std::vector<t_time> sent_at; // when byte n left the wire, at n % buffer size
+  struct t_wire_byte
+  {
+    t_time time;
+    unsigned char byte;
+    t_byte_meta meta;
+  };
+  std::deque<t_wire_byte> on_wire;
+  void read_line();
+};
+
+class t_uart_tx : public t_task
+{
+public:
+  t_uart_tx(t_scheduler& scheduler, t_pipeline& pipeline);
+  t_nbsp_model tx_state;
+  void handle(int what, uint64_t arg) override;
+
+private:
+  t_pipeline& pipeline;
+  t_time line_free = 0; // end of the last stop bit
+};
+
+//----------------------------------------------------------------------------------------
+// the host
+
+class t_host
+{
+public:
+  t_host(t_pipeline& pipeline);
+  void receive(t_time time, unsigned char byte, const t_byte_meta& meta);
+
+private:
+  t_pipeline& pipeline;
+  t_receiver_context context;
+  unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic = 0;
+  unsigned long first_frame = 0; // of the bytes of the screen being received
+  bool mixed = false;
+  bool presenting = false;        // a screen compared with the CRT is shown
+  t_time presented_at = 0;        // since then
+  t_time presented_sync = 0;      // the frame sync of that screen
+  unsigned char flagged_skipped = 0;
+  unsigned char flagged_superseded = 0;
+};
+
+//----------------------------------------------------------------------------------------
+
+class t_pipeline
+{
+public:
+  t_pipeline(const t_sim_config& config, t_sim_stats& stats)
+    : config(config), stats(stats), random(config.seed),
+      pet(scheduler, *this), memory_observer(scheduler, *this), frame_observer(scheduler, *this),
+      renderer(scheduler, *this), uart_tx(scheduler, *this), fast_link(scheduler, *this), host(*this)
+  {
+    if (config.fast_wire)
+    {
+      frame_observer.observer_state.connect(fast_link.observer_state);
+    }
+    else
+    {
+      frame_observer.observer_state.connect(renderer.observer_state);
+      renderer.tx_state.connect(uart_tx.tx_state);
+    }
+    ticks_per_bit = (TICKS_PER_SECOND + config.baud / 2) / config.baud;
+    frame_period = TICKS_PER_SECOND / config.fps;
+  }
+
+  const t_sim_config& config;
+  t_sim_stats& stats;
+  t_scheduler scheduler;
+  std::mt19937 random;
+  unsigned ticks_per_bit;
+  t_time frame_period;
+  std::deque<t_byte_meta> wire_meta; // one per byte in the renderer to uart_tx channel
+
+  t_pet pet;
+  t_memory_observer memory_observer;
+  t_frame_observer frame_observer;
+  t_renderer renderer;
+  t_uart_tx uart_tx;
+  t_fast_link fast_link;
+  t_host host;
+
+  // sending reports whether the renderer still reads from buffer
+  bool sending(unsigned buffer) const
+  {
+    return config.fast_wire ? fast_link.sending_from(buffer) : renderer.sending_from(buffer);
+  }
+};
+
+//----------------------------------------------------------------------------------------
+
+int t_pet::start(t_time time)
+{
+  // the observer only learns about cells that get written, so the
+  // comparison starts from the same zeroed screen as video_memory_init
+  memset(ram, 0, sizeof(ram));
+  if (pipeline.config.trace != nullptr)
+  {
+    if (trace_reader_open(&reader, pipeline.config.trace) < 0)
+    {
+      return -1;
+    }
+    replaying = true;
+    trace_start = time;
+    replay_frame();
+    return 0;
+  }
+  deliver(time, PET_SYNC, 0);
+  return 0;
+}
+
+// synthetic_frame makes random writes anywhere in the frame
+void t_pet::synthetic_frame(t_time now)
+{
+  std::uniform_int_distribution<t_time> offset(0, pipeline.frame_period - 1);
+  std::uniform_int_distribution<unsigned> position(0, SCREEN_SIZE - 1);
+  std::uniform_int_distribution<unsigned> code(0, 255);
+  for (unsigned i = 0; i < pipeline.config.writes_per_frame; i++)
+  {
+    unsigned address = BUS_SCREEN_ADDRESS + position(pipeline.random);
+    deliver(now + offset(pipeline.random), PET_WRITE, (address << 8) | code(pipeline.random));
+  }
+
+  t_time next = now + pipeline.frame_period;
+  if (pipeline.config.jitter > 0)
+  {
+    std::uniform_int_distribution<int> jitter(-(int)pipeline.config.jitter, pipeline.config.jitter);
+    next += jitter(pipeline.random);
+  }
+  deliver(next, PET_SYNC, 0);
+}
+
+// replay_frame takes the events of the trace up to the next frame sync
+void t_pet::replay_frame()
+{
+  t_bus_event event;
+  int result;
+  while ((result = trace_read(&reader, &event)) == 1)
+  {
+    t_time time = trace_start + event.time;
+    switch (event.type)
+    {
+    case BUS_WRITE:
+      deliver(time, PET_WRITE, ((uint64_t)event.address << 8) | event.data);
+      break;
+    case BUS_GRAPHIC:
+      deliver(time, PET_GRAPHIC, event.data);
+      break;
+    case BUS_SYNC:
+      deliver(time, PET_SYNC, 0);
+      return;
+    }
+  }
+  if (result < 0)
+  {
+    fprintf(stderr, "%s: damaged after %llu events\n", pipeline.config.trace, (unsigned long long)reader.events);
+  }
+  trace_reader_close(&reader);
+  finished = true;
+  finish_time = trace_start + reader.time;
+}
+
+void t_pet::handle(int what, uint64_t arg)
+{
+  switch (what)
+  {
+  case PET_SYNC:
+  {
+    t_time now = when();
+    t_frame_truth& truth = frames[frame % FRAME_RING];
+    truth.frame = frame;
+    truth.sync_time = now;
+    pipeline.stats.frames_synced++;
+    // the observer may see the edge late or not at all
+    const t_sim_config& config = pipeline.config;
+    if (config.sync_loss > 0 && std::uniform_int_distribution<unsigned>(0, 999)(pipeline.random) < config.sync_loss)
+    {
+      pipeline.stats.syncs_lost++;
+    }
+    else if (config.sync_noise > 0)
+    {
+      t_time late = std::uniform_int_distribution<unsigned>(0, config.sync_noise)(pipeline.random);
+      pipeline.frame_observer.deliver(now + late, FRAME_SYNC, frame);
+    }
+    else
+    {
+      pipeline.frame_observer.deliver(now, FRAME_SYNC, frame);
+    }
+
+    // the CRT latches the lines just after the firmware's copies are due
+    unsigned first = first_line_latch(config.fps);
+    for (unsigned row = 0; row < SCREEN_ROWS; row++)
+    {
+      deliver(now + first + pipeline.config.crt_margin + row * 40000, PET_LATCH, (frame << 8) | row);
+    }
+    frame++;
+    if (replaying)
+    {
+      replay_frame();
+    }
+    else
+    {
+      synthetic_frame(now);
+    }
+    break;
+  }
+
+  case PET_LATCH:
+  {
+    unsigned long latched_frame = arg >> 8;
+    unsigned row = arg & 0xFF;
+    t_frame_truth& truth = frames[latched_frame % FRAME_RING];
+    memcpy(truth.screen + row * SCREEN_COLS, ram + row * SCREEN_COLS, SCREEN_COLS);
+    line_scan[row] = when();
+    line_frame[row] = latched_frame;
+    break;
+  }
+
+  case PET_WRITE:
+  {
+    pipeline.memory_observer.deliver(when(), OBSERVER_TRIGGER, arg);
+    unsigned position = (arg >> 8) - BUS_SCREEN_ADDRESS;
+    if (position >= SCREEN_SIZE)
+    {
+      break;
+    }
+    unsigned char data = arg & 0xFF;
+    ram[position] = data;
+    // a write to a line the CRT is scanning shows from the next character on
+    unsigned row = position / SCREEN_COLS;
+    unsigned col = position % SCREEN_COLS;
+    if (when() < line_scan[row] + col * 50) // 0.5 us per character at 80 columns
+    {
+      frames[line_frame[row] % FRAME_RING].screen[position] = data;
+    }
+    break;
+  }
+
+  case PET_GRAPHIC:
+    if (arg != graphic)
+    {
+      graphic = arg;
+      pipeline.memory_observer.deliver(when(), OBSERVER_GRAPHIC, arg);
+    }
+    break;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void t_memory_observer::handle(int what, uint64_t arg)
+{
+  switch (what)
+  {
+  case OBSERVER_TRIGGER:
+    // t :> time; time += 70; t when timerafter(time) :> void;
+    wait_until(when() + MEMORY_OBSERVER_DELAY, OBSERVER_APPLY, arg);
+    break;
+
+  case OBSERVER_APPLY:
+  {
+    // the address port sees bit 15 low for 0x8000..0x8FFF and the lower
+    // 11 address bits, decoded as in the firmware
+    unsigned bus_address = arg >> 8;
+    unsigned address = ((bus_address & 0xF000) == 0x8000 ? 0 : 0x8000) | (bus_address & 0x07FF);
+    spend(MEMORY_WRITE_COST);
+    pipeline.stats.writes++;
+    if ((address & 0x8000) == 0)
+    {
+      unsigned video_buffer_address = address & 0x07FF;
+      if (video_buffer_address < 2000)
+      {
+        video_memory_write_data(video_buffer_address, arg & 0xFF, (unsigned)when());
+      }
+    }
+    break;
+  }
+
+  case OBSERVER_GRAPHIC:
+    spend(MEMORY_WRITE_COST);
+    video_memory_write_graphic(arg);
+    break;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+t_frame_observer::t_frame_observer(t_scheduler& scheduler, t_pipeline& pipeline)
+  : t_task(scheduler, SELECT_COST), observer_state(*this, FRAME_OBSERVER_MSG, 8), pipeline(pipeline)
+{
+}
+
+// wait_for_timer is "t when timerafter(time) :> void" on the 32 bit timer,
+// with STREAM_LINES in a select with the acks of the lines sent
+void t_frame_observer::wait_for_timer(unsigned time, int what)
+{
+  int ahead = (int)(time - (unsigned)when());
+  wait_until_select(ahead > 0 ? when() + ahead : when(), what, 0,
+    pipeline.config.stream_lines ? FRAME_OBSERVER_MSG : INT_MAX);
+}
+
+void t_frame_observer::handle(int what, uint64_t arg)
+{
+  switch (what)
+  {
+  case FRAME_SYNC:
+  {
+    time = (unsigned)when(); // the 32 bit timer
+    spend(FRAME_TIMING_COST);
+    if (!frame_timing_sync(time))
+    {
+      break;
+    }
+    t_sim_stats& stats = pipeline.stats;
+    int drift = frame_timing_drift();
+    stats.sync_drift_sum += drift < 0 ? -drift : drift;
+    stats.sync_drift_max = std::max(stats.sync_drift_max, (t_time)(drift < 0 ? -drift : drift));
+    // how far the first copy is due from the CRT's first latch
+    t_time latch = pipeline.pet.frames[arg % FRAME_RING].sync_time + first_line_latch(pipeline.config.fps);
+    int off = (int)(frame_timing_line_due(0) - (unsigned)latch);
+    stats.copy_off_sum += off < 0 ? -off : off;
+    stats.copy_off_max = std::max(stats.copy_off_max, (t_time)(off < 0 ? -off : off));
+    stats.copy_late += off > (int)pipeline.config.crt_margin;
+    stats.frames_timed++;
+    if (pipeline.sending(buf_num))
+    {
+      pipeline.stats.ring_overruns++;
+    }
+    buffer_frame[buf_num] = arg;
+    line = 0;
+    time = frame_timing_line_due(0);
+    wait_for_timer(time, FRAME_COPY_LINE);
+    break;
+  }
+
+  case FRAME_COPY_LINE:
+    spend(COPY_START_COST);
+    video_memory_copy_line_to(buf_num, line, time);
+    spend(COPY_LINE_COST);
+    line++;
+    if (pipeline.config.stream_lines)
+    {
+      observer_state.send((buf_num << 8) | line);
+    }
+    if (line < SCREEN_ROWS)
+    {
+      time = frame_timing_line_due(line);
+      wait_for_timer(time, FRAME_COPY_LINE);
+      break;
+    }
+    // the tears of the last line go with the flags
+    time += TEAR_WINDOW;
+    wait_for_timer(time, FRAME_COPY_FLAGS);
+    break;
+
+  case FRAME_COPY_FLAGS:
+    video_memory_write_sync(frame_timing_missed_syncs(), frame_timing_drift());
+    video_memory_copy_flags_to(buf_num);
+    spend(COPY_FLAGS_COST);
+    observer_state.send((buf_num << 8) | LINES_COPIED_ALL);
+    pipeline.stats.frames_copied++;
+    buf_num += 1;
+    if (buf_num == pipeline.config.copies)
+    {
+      buf_num = 0;
+    }
+    break;
+
+  case FRAME_OBSERVER_MSG:
+    observer_state.handle_msg(arg);
+    break;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+t_send_order::t_send_order(t_pipeline& pipeline) : buf_num(pipeline.config.copies - 1), pipeline(pipeline)
+{
+}
+
+void t_send_order::message(unsigned copied)
+{
+  if (sending && (copied >> 8) == buf_num)
+  {
+    lines_copied = copied & 0xFF;
+    if (lines_copied == LINES_COPIED_ALL)
+    {
+      video_memory_write_skipped_to(buf_num, skipped, superseded);
+    }
+    return;
+  }
+  if (sending && !pipeline.config.send_newest)
+  {
+    return; // could not send out frame until next arrived
+  }
+  if (next && next_buf_num != (copied >> 8))
+  {
+    superseded++;
+    pipeline.stats.frames_superseded++;
+  }
+  next = true;
+  next_buf_num = copied >> 8;
+  next_lines_copied = copied & 0xFF;
+}
+
+bool t_send_order::start()
+{
+  if (sending || !next)
+  {
+    return false;
+  }
+  // the copies between the one sent last and this one are not sent
+  unsigned copies = pipeline.config.copies;
+  unsigned not_sent = (next_buf_num + copies - buf_num - 1) % copies;
+  skipped += not_sent;
+  pipeline.stats.frames_skipped += not_sent;
+  buf_num = next_buf_num;
+  lines_copied = next_lines_copied;
+  sending = 1;
+  next = false;
+  pipeline.stats.frames_sent++;
+  if (lines_copied == LINES_COPIED_ALL)
+  {
+    video_memory_write_skipped_to(buf_num, skipped, superseded);
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------
+
+t_renderer::t_renderer(t_scheduler& scheduler, t_pipeline& pipeline)
+  : t_task(scheduler, SELECT_COST), observer_state(*this, RENDER_OBSERVER_MSG, 0),
+    tx_state(*this, RENDER_TX_MSG, pipeline.config.tx_buffer), pipeline(pipeline), order(pipeline)
+{
+}
+
+// tx_word reads the next bytes of the frame from next_line and
+// next_ch_index on, the first one in the lowest bits, and advances them.
+// The last burst of a frame is filled up with 51, which the host's
+// receiver skips while it looks for the next sync, like the 51 ending a
+// frame.
+unsigned t_renderer::tx_word(unsigned& next_line, int& next_ch_index)
+{
+  unsigned word = 0;
+  for (unsigned shift = 0; shift < 8 * pipeline.config.tx_bytes_per_word; shift += 8)
+  {
+    spend(RENDER_BYTE_COST);
+    unsigned byte_to_send = 51;
+    if (next_line < 52)
+    {
+      byte_to_send = (next_ch_index == 40) ? next_line : video_memory_read_from_copy(order.buf_num, next_line * 40 + next_ch_index);
+    }
+    word |= byte_to_send << shift;
+    next_ch_index += 1;
+    if (next_ch_index == 41)
+    {
+      next_line += 1;
+      next_ch_index = 0;
+    }
+  }
+  return word;
+}
+
+// lines_ready tells whether wire buffer `line` was copied: buffer 0 is the
+// sync, buffers 1 and 2 hold screen line 0 and so on, buffer 51 the flags,
+// the padding after it goes with the flags
+static bool lines_ready(unsigned line, unsigned lines_copied)
+{
+  if (line == 0)
+  {
+    return true;
+  }
+  if (line <= 50)
+  {
+    return (line + 1) / 2 <= lines_copied;
+  }
+  return lines_copied == LINES_COPIED_ALL;
+}
+
+// next_ready tells whether all bytes of the next word or burst were copied
+bool t_renderer::next_ready() const
+{
+  unsigned words = pipeline.config.tx_burst > 0 ? pipeline.config.tx_burst : 1;
+  unsigned last = ch_index + words * pipeline.config.tx_bytes_per_word - 1;
+  return lines_ready(line + last / 41, order.lines_copied);
+}
+
+// send_next sends the next word, or burst of words, returns false if the
+// nbsp buffer has no room for it
+bool t_renderer::send_next()
+{
+  unsigned next_line = line;
+  int next_ch_index = ch_index;
+  unsigned words = pipeline.config.tx_burst;
+  if (words == 0)
+  {
+    words = 1;
+    if (!tx_state.send(tx_word(next_line, next_ch_index)))
+    {
+      return false;
+    }
+  }
+  else
+  {
+    unsigned burst[NBSP_MAX_BURST];
+    for (unsigned i = 0; i < words; i++)
+    {
+      burst[i] = tx_word(next_line, next_ch_index);
+    }
+    if (!tx_state.burst_send(burst, words))
+    {
+      return false;
+    }
+  }
+  // which frame the bytes in the channel belong to
+  t_byte_meta meta{ pipeline.frame_observer.buffer_frame[order.buf_num] };
+  pipeline.wire_meta.insert(pipeline.wire_meta.end(), words * pipeline.config.tx_bytes_per_word, meta);
+  line = next_line;
+  ch_index = next_ch_index;
+  return true;
+}
+
+void t_renderer::handle(int what, uint64_t arg)
+{
+  switch (what)
+  {
+  case RENDER_OBSERVER_MSG:
+    if (observer_state.handle_msg(arg))
+    {
+      order.message(observer_state.received_data());
+    }
+    break;
+
+  case RENDER_TX_MSG:
+    // ack received from uart_tx - tx buffer might have more room
+    if (pipeline.config.tx_burst > 0)
+    {
+      tx_state.burst_handle_ack();
+    }
+    else
+    {
+      tx_state.handle_msg(arg);
+    }
+    break;
+  }
+
+  while (true)
+  {
+    if (order.start())
+    {
+      line = 0;
+      ch_index = 0;
+    }
+    if (!order.sending)
+    {
+      return;
+    }
+    while (next_ready())
+    {
+      if (!send_next())
+      {
+        return; // buffer full, continue with the acks
+      }
+      if (line >= 52)
+      {
+        break;
+      }
+    }
+    if (line < 52)
+    {
+      return;
+    }
+    order.sending = 0;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+t_uart_tx::t_uart_tx(t_scheduler& scheduler, t_pipeline& pipeline)
+  : t_task(scheduler, SELECT_COST), tx_state(*this, UART_TX_MSG, 0), pipeline(pipeline)
+{
+}
+
+void t_uart_tx::handle(int what, uint64_t arg)
+{
+  unsigned words[NBSP_MAX_BURST];
+  unsigned count = pipeline.config.tx_burst;
+  if (count > 0)
+  {
+    tx_state.burst_receive(words, count);
+  }
+  else
+  {
+    if (!tx_state.handle_msg(arg))
+    {
+      return;
+    }
+    words[0] = tx_state.received_data();
+    count = 1;
+  }
+  spend(UART_START_COST);
+  // p <: 0 @ t waits for the stop bit of the last byte to finish, the
+  // further bytes follow back to back
+  t_time start = when() > line_free ? when() : line_free;
+  t_time byte_time = 10 * pipeline.ticks_per_bit;
+  for (unsigned i = 0; i < count; i++)
+  {
+    unsigned word = words[i];
+    for (unsigned byte = 0; byte < pipeline.config.tx_bytes_per_word; byte++)
+    {
+      line_free = (line_free > start ? line_free : start) + byte_time;
+      pipeline.stats.wire_busy += byte_time;
+      pipeline.stats.bytes_sent++;
+      t_byte_meta meta = pipeline.wire_meta.front();
+      pipeline.wire_meta.pop_front();
+      pipeline.host.receive(line_free, word & 0xFF, meta);
+      word >>= 8;
+    }
+  }
+  // the thread gets back to its select once the last stop bit is out, the
+  // final "p @ t <: 1" is buffered by the port
+  busy_until(line_free - pipeline.ticks_per_bit + UART_LOOP_COST);
+}
+
+//----------------------------------------------------------------------------------------
+
+t_fast_link::t_fast_link(t_scheduler& scheduler, t_pipeline& pipeline)
+  : t_task(scheduler, SELECT_COST), observer_state(*this, RENDER_OBSERVER_MSG, 0), pipeline(pipeline), order(pipeline),
+    sent_at(pipeline.config.tx_buffer * pipeline.config.tx_bytes_per_word, 0)
+{
+}
+
+void t_fast_link::handle(int what, uint64_t arg)
+{
+  switch (what)
+  {
+  case RENDER_OBSERVER_MSG:
+    if (observer_state.handle_msg(arg))
+    {
+      order.message(observer_state.received_data());
+      if (order.start())
+      {
+        line = 0;
+        read_line();
+      }
+      else if (waiting)
+      {
+        waiting = false;
+        read_line();
+      }
+    }
+    break;
+
+  case RENDER_LINE:
+    read_line();
+    break;
+
+  case RENDER_WIRE:
+    while (!on_wire.empty() && on_wire.front().time <= when())
+    {
+      pipeline.host.receive(on_wire.front().time, on_wire.front().byte, on_wire.front().meta);
+      on_wire.pop_front();
+    }
+    break;
+  }
+}
+
+// read_line queues the 41 bytes of a line, each as soon as the nbsp buffer
+// (which holds a word less than its size, plus the one uart_tx sends) has
+// room, and sends them on as fast as the wire takes them
+void t_fast_link::read_line()
+{
+  if (!lines_ready(line, order.lines_copied))
+  {
+    waiting = true; // the next observer message goes on
+    return;
+  }
+  t_time byte_time = 10 * pipeline.ticks_per_bit;
+  unsigned size = sent_at.size();
+  t_byte_meta meta{ pipeline.frame_observer.buffer_frame[order.buf_num] };
+  for (unsigned ch_index = 0; ch_index < 41; ch_index++)
+  {
+    spend(RENDER_BYTE_COST);
+    unsigned char byte = (ch_index == 40) ? line : video_memory_read_from_copy(order.buf_num, line * 40 + ch_index);
+    t_time queued = when();
+    t_time& slot = sent_at[bytes % size];
+    if (slot > queued)
+    {
+      queued = slot;
+    }
+    t_time start = queued + CHANNEL_LATENCY + SELECT_COST + UART_START_COST;
+    if (start < wire_free)
+    {
+      start = wire_free;
+    }
+    wire_free = start + byte_time;
+    slot = wire_free;
+    bytes++;
+    pipeline.stats.wire_busy += byte_time;
+    pipeline.stats.bytes_sent++;
+    on_wire.push_back(t_wire_byte{ wire_free, byte, meta });
+  }
+  deliver(wire_free, RENDER_WIRE, 0);
+  line++;
+  if (line == 52)
+  {
+    order.sending = 0;
+    if (!order.start())
+    {
+      return;
+    }
+    line = 0;
+  }
+  // the next line's first byte goes when the buffer has room for it
+  t_time next = sent_at[bytes % size];
+  deliver(next > when() ? next : when(), RENDER_LINE, 0);
+}
+
+//----------------------------------------------------------------------------------------
+
+t_host::t_host(t_pipeline& pipeline) : pipeline(pipeline)
+{
+  init_receiver_context(&context);
+  context.screen_buffer = screen;
+  context.graphic = &graphic;
+}
+
+void t_host::receive(t_time time, unsigned char byte, const t_byte_meta& meta)
+{
+  if (context.state == STATE_COUNTING_ZEROS && context.count == 0)
+  {
+    first_frame = meta.frame;
+    mixed = false;
+  }
+  mixed |= meta.frame != first_frame;
+  if (!handle_received_byte(&context, byte))
+  {
+    return;
+  }
+  t_sim_stats& stats = pipeline.stats;
+  stats.frames_presented++;
+  // the renderer finishes the copy it started, lines of a newer copy
+  // would mean it switched buf_num in the middle of a screen
+  if (mixed)
+  {
+    stats.frames_mixed++;
+  }
+  stats.skipped_flagged += (unsigned char)(context.flags[FLAGS_SKIPPED] - flagged_skipped);
+  stats.superseded_flagged += (unsigned char)(context.flags[FLAGS_SUPERSEDED] - flagged_superseded);
+  flagged_skipped = context.flags[FLAGS_SKIPPED];
+  flagged_superseded = context.flags[FLAGS_SUPERSEDED];
+  const t_frame_truth& truth = pipeline.pet.frames[meta.frame % FRAME_RING];
+  if (truth.frame != meta.frame)
+  {
+    return; // too old to compare
+  }
+  stats.latencies.push_back(time - truth.sync_time);
+  // the age of the screen shown, from its frame sync on, grows until the
+  // next one replaces it
+  if (presenting)
+  {
+    t_time shown = time - presented_at;
+    stats.age_sum += shown * ((presented_at + time) / 2.0 - presented_sync);
+    stats.age_time += shown;
+    stats.age_max = std::max(stats.age_max, time - presented_sync);
+  }
+  presenting = true;
+  presented_at = time;
+  presented_sync = truth.sync_time;
+  unsigned torn = 0;
+  for (unsigned i = 0; i < SCREEN_SIZE; i++)
+  {
+    torn += screen[i] != truth.screen[i];
+  }
+  if (torn > 0)
+  {
+    stats.frames_torn++;
+    stats.cells_torn += torn;
+  }
+  unsigned tears = context.flags[FLAGS_TEARS];
+  if (tears > 0)
+  {
+    stats.frames_tears_flagged++;
+    stats.tears_flagged += tears;
+    if (torn > 0)
+    {
+      stats.frames_torn_flagged++;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+int simulate(const t_sim_config& config, t_sim_stats& stats)
+{
+  video_memory_init();
+  frame_timing_init();
+  t_pipeline* pipeline = new t_pipeline(config, stats);
+  // the first frame starts a bit in, so the 32 bit timer isn't zero
+  if (pipeline->pet.start(1000) < 0)
+  {
+    delete pipeline;
+    return -1;
+  }
+  t_time end = (t_time)(config.seconds * TICKS_PER_SECOND);
+  if (end == 0)
+  {
+    // to the end of the trace, and the last frame through the wire
+    while (!pipeline->pet.finished)
+    {
+      pipeline->scheduler.run_until(pipeline->scheduler.now + TICKS_PER_SECOND);
+    }
+    end = pipeline->pet.finish_time + TICKS_PER_SECOND / 10;
+  }
+  pipeline->scheduler.run_until(end);
+  stats.duration = end;
+  stats.missed_syncs = frame_timing_missed_syncs();
+  stats.off_syncs = frame_timing_off_syncs();
+  stats.period = frame_timing_period();
+  stats.events = pipeline->scheduler.event_count;
+  stats.control_tokens = pipeline->renderer.tx_state.control_tokens + pipeline->uart_tx.tx_state.control_tokens;
+  stats.data_tokens = pipeline->renderer.tx_state.data_tokens + pipeline->uart_tx.tx_state.data_tokens;
+  stats.renderer_cycles = pipeline->renderer.cycles;
+  stats.uart_cycles = pipeline->uart_tx.cycles;
+  delete pipeline;
+  return 0;
+}
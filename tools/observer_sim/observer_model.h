@@ -0,0 +1,94 @@
+// simulation of the observer pipeline of app_fast_cbm_video_observer
+//
+// The PET side writes to its screen memory and its CRT latches the lines
+// of every frame, which gives the screens it actually showed. The XMOS
+// side runs models of memory_observer, frame_observer, renderer and
+// uart_tx, connected by nbsp channel models, on top of the firmware's own
+// video_memory.c. The host side decodes the UART stream with serial2hdmi's
+// receiver.c, and every screen it completes is compared with what the CRT
+// showed in that frame.
+//
+// The bus traffic is either synthetic, random writes all over the frame,
+// or replayed from a bus trace (see bustrace.h). With fast_wire the
+// renderer and uart_tx are replaced by a model that reads a line of the
+// copy at a time and works out when its bytes leave the wire, instead of
+// running the nbsp handshake for every byte, which makes hours of traffic
+// a matter of seconds. The renderer's reads are then a line late at
+// worst, and the nbsp tokens between renderer and uart_tx aren't counted.
+
+#ifndef __observer_model_h__
+#define __observer_model_h__
+
+#include <vector>
+#include "scheduler.h"
+
+#define MAX_BUF_COPIES 16 // the simulation builds video_memory.c with this many copies
+
+struct t_sim_config
+{
+  unsigned fps = 50;               // PET frame rate, 50 or 60
+  unsigned baud = 1562500;         // UART, TICKS_PER_BIT is 100 MHz / baud
+  unsigned copies = 4;             // VIDEO_BUF_COPIES, up to MAX_BUF_COPIES
+  unsigned tx_buffer = 128;        // renderer's nbsp buffer towards uart_tx, in words
+  unsigned tx_bytes_per_word = 4;  // TX_BYTES_PER_WORD, 1, 2 or 4
+  unsigned tx_burst = 0;           // words per nbsp_udnw burst to uart_tx, 0 for plain nbsp
+  double seconds = 10.0;           // simulated time
+  unsigned writes_per_frame = 100; // random screen writes of the synthetic bus traffic
+  unsigned jitter = 0;             // frame sync jitter, +- ticks
+  unsigned sync_noise = 0;         // the observer sees a sync edge up to this many ticks late
+  unsigned sync_loss = 0;          // sync edges lost on the way to the observer, per mille
+  unsigned crt_margin = 2000;      // the CRT latches a line this long after its copy is due
+  unsigned seed = 1;
+  const char* trace = nullptr;     // bus trace to replay instead of the synthetic traffic
+  bool fast_wire = false;          // line level model of renderer and uart_tx
+  bool stream_lines = true;        // STREAM_LINES, send each line as soon as it is copied
+  bool send_newest = false;        // SEND_NEWEST, go on with the newest copy once a frame is out
+};
+
+struct t_sim_stats
+{
+  t_time duration = 0;
+  uint64_t events = 0;
+  uint64_t writes = 0;                // bus writes seen by memory_observer
+  unsigned long frames_synced = 0;
+  unsigned long frames_copied = 0;
+  unsigned long frames_sent = 0;
+  unsigned long frames_skipped = 0;   // copies the renderer did not send
+  unsigned long frames_superseded = 0; // of them, waiting for the UART when a newer copy came
+  unsigned long skipped_flagged = 0;  // the counts in the flags of the frames presented
+  unsigned long superseded_flagged = 0;
+  unsigned long frames_presented = 0; // completed by the host's receiver
+  unsigned long frames_torn = 0;      // presented screen differs from what the CRT showed
+  unsigned long frames_mixed = 0;     // presented screen has lines of two different copies
+  unsigned long cells_torn = 0;
+  unsigned long frames_tears_flagged = 0; // the flags report tears (FLAGS_TEARS)
+  unsigned long tears_flagged = 0;
+  unsigned long frames_torn_flagged = 0;  // torn and flagged
+  unsigned long syncs_lost = 0;       // by sync_loss
+  unsigned long frames_timed = 0;     // syncs frame_timing took for a frame
+  uint64_t sync_drift_sum = 0;        // frame_timing_drift, absolute
+  t_time sync_drift_max = 0;
+  uint64_t copy_off_sum = 0;          // first copy due to the CRT latching the first line, absolute
+  t_time copy_off_max = 0;
+  unsigned long copy_late = 0;        // first copy due after the CRT latched the line
+  unsigned missed_syncs = 0;          // frame_timing's counts at the end
+  unsigned off_syncs = 0;
+  unsigned period = 0;
+  unsigned long ring_overruns = 0;    // a copy went into the buffer the renderer was still sending
+  uint64_t wire_busy = 0;             // ticks with a byte on the UART line
+  uint64_t bytes_sent = 0;
+  uint64_t control_tokens = 0;        // on the renderer to uart_tx channel, both directions
+  uint64_t data_tokens = 0;
+  uint64_t renderer_cycles = 0;       // ticks renderer and uart_tx spend executing
+  uint64_t uart_cycles = 0;
+  std::vector<t_time> latencies;      // frame sync to the host completing that frame's screen
+  double age_sum = 0.0;               // the age of the screen the host shows, integrated over time
+  t_time age_time = 0;
+  t_time age_max = 0;
+};
+
+// simulate runs config.seconds, or with a trace until its end if seconds
+// is 0, returns -1 if the trace can't be read
+extern int simulate(const t_sim_config& config, t_sim_stats& stats);
+
+#endif
@@ -0,0 +1,223 @@
+// observer_sim: discrete event simulation of the XMOS observer pipeline
+// (ws/app_fast_cbm_video_observer) on a Linux box
+//
+// usage: observer_sim [options]
+//        observer_sim -x [options]   sweep baud rates and buffer counts
+//
+//   -t trace      replay a bus trace (see bustrace.h, made with tracetool)
+//                 instead of the synthetic writes, to its end unless -s
+//   -F            fast wire: line level renderer and uart_tx, for long traces
+//   -f fps        PET frame rate, 50 or 60 (50)
+//   -b baud       UART bit rate (1562500), TICKS_PER_BIT is 100 MHz / baud
+//   -c copies     VIDEO_BUF_COPIES (4), up to 16
+//   -q words      renderer's nbsp buffer towards uart_tx (128)
+//   -p bytes      bytes per nbsp word to uart_tx, TX_BYTES_PER_WORD (4)
+//   -n words      send bursts of this many words with nbsp_udnw (0: plain nbsp)
+//   -l 0|1        STREAM_LINES, send each line once it is copied (1)
+//   -o 0|1        SEND_NEWEST, go on with the newest copy once a frame is out (0)
+//   -s seconds    simulated time (10, the whole trace with -t)
+//   -w writes     random screen writes per frame (100)
+//   -j ticks      frame sync jitter, +- ticks of 10 ns (0)
+//   -e ticks      the observer sees a frame sync edge up to this late (0)
+//   -d permille   frame sync edges the observer doesn't see (0)
+//   -m ticks      CRT latches a line this long after its copy is due (2000)
+//   -r seed       random seed (1)
+//
+// Reports the frames synced, copied, sent, skipped by the renderer (busy
+// with an older copy), of them superseded by a newer copy while waiting, and
+// completed by the host, frames whose screen differs
+// from what the CRT showed (torn) or holds lines of two copies (mixed),
+// copies into a buffer the renderer was still sending (ring overruns), the
+// frames whose flags report tears (video_memory.h) against the torn ones,
+// the UART wire utilisation, the nbsp tokens between renderer and uart_tx,
+// the frame syncs lost, missed and off for frame_timing, how far they were
+// off its prediction (drift), how far the first line's copy was due from its
+// time after the PET's actual sync, the latency from frame sync to the host having
+// the frame's screen, and the age of the screen the host shows, from its
+// frame sync on, averaged over time.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "observer_model.h"
+#include "nbsp_model.h"
+
+static double ms(t_time ticks)
+{
+  return ticks / 100000.0;
+}
+
+static t_time percentile(std::vector<t_time>& values, double p)
+{
+  if (values.empty())
+  {
+    return 0;
+  }
+  size_t index = (size_t)(p * (values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+static void report(const t_sim_config& config, t_sim_stats& stats, double cpu)
+{
+  unsigned ticks_per_bit = (100000000 + config.baud / 2) / config.baud;
+  double seconds = (double)stats.duration / TICKS_PER_SECOND;
+  printf("%u Hz, %u bit/s (%u ticks per bit), %u copies, %.1f s simulated in %.2f s (%.0fx real time), %llu events\n",
+    config.fps, config.baud, ticks_per_bit, config.copies, seconds, cpu, seconds / cpu,
+    (unsigned long long)stats.events);
+  printf("frames: %lu synced, %lu copied, %lu sent, %lu skipped (%lu superseded), %lu presented, %lu torn (%lu cells), %lu mixed, %lu ring overruns\n",
+    stats.frames_synced, stats.frames_copied, stats.frames_sent, stats.frames_skipped, stats.frames_superseded,
+    stats.frames_presented, stats.frames_torn, stats.cells_torn, stats.frames_mixed, stats.ring_overruns);
+  printf("tears: %lu frames flagged (%lu writes), %lu of the %lu torn frames flagged, %lu flagged but not torn\n",
+    stats.frames_tears_flagged, stats.tears_flagged, stats.frames_torn_flagged, stats.frames_torn,
+    stats.frames_tears_flagged - stats.frames_torn_flagged);
+  printf("skipped: the flags count %lu frames skipped, %lu superseded\n", stats.skipped_flagged, stats.superseded_flagged);
+  unsigned long timed = std::max(stats.frames_timed, 1UL);
+  printf("sync: %lu lost, %u missed, %u off for frame_timing, period %.2f us, drift avg %.2f max %.2f us; "
+    "first copy avg %.2f max %.2f us off its time from the PET's sync, %lu times after the CRT latched the line\n",
+    stats.syncs_lost, stats.missed_syncs, stats.off_syncs, stats.period / 100.0,
+    stats.sync_drift_sum / 100.0 / timed, stats.sync_drift_max / 100.0,
+    stats.copy_off_sum / 100.0 / timed, stats.copy_off_max / 100.0, stats.copy_late);
+  printf("bus: %llu writes; wire: %.1f%% busy, %llu bytes", (unsigned long long)stats.writes,
+    100.0 * stats.wire_busy / stats.duration, (unsigned long long)stats.bytes_sent);
+  if (!config.fast_wire)
+  {
+    printf("; nbsp renderer to uart_tx: %.1f control and %.1f data tokens per frame",
+      stats.frames_sent ? (double)stats.control_tokens / stats.frames_sent : 0.0,
+      stats.frames_sent ? (double)stats.data_tokens / stats.frames_sent : 0.0);
+  }
+  printf("\n");
+  if (!config.fast_wire)
+  {
+    printf("threads: renderer executing %.1f%% of the time, uart_tx %.1f%%\n",
+      100.0 * stats.renderer_cycles / stats.duration, 100.0 * stats.uart_cycles / stats.duration);
+  }
+  double sum = 0.0;
+  for (t_time latency : stats.latencies)
+  {
+    sum += latency;
+  }
+  size_t count = stats.latencies.size();
+  printf("latency sync to host: avg %.2f ms, min %.2f, p50 %.2f, p99 %.2f, max %.2f\n",
+    count ? ms(sum / count) : 0.0,
+    ms(percentile(stats.latencies, 0.0)), ms(percentile(stats.latencies, 0.5)),
+    ms(percentile(stats.latencies, 0.99)), ms(percentile(stats.latencies, 1.0)));
+  printf("screen age on the host: avg %.2f ms, max %.2f\n",
+    stats.age_time ? ms(stats.age_sum / stats.age_time) : 0.0, ms(stats.age_max));
+}
+
+static int sweep(t_sim_config config)
+{
+  static const unsigned bauds[] = { 1562500, 2000000, 3000000 };
+  static const unsigned copies[] = { 2, 3, 4, 8 };
+  printf("fps  baud     copies  wire%%  skipped  presented  torn  mixed  overruns  latency avg/p99 ms  age avg ms\n");
+  for (unsigned fps : { 50u, 60u })
+  {
+    for (unsigned baud : bauds)
+    {
+      for (unsigned count : copies)
+      {
+        config.fps = fps;
+        config.baud = baud;
+        config.copies = count;
+        t_sim_stats stats;
+        if (simulate(config, stats) < 0)
+        {
+          return 1;
+        }
+        double sum = 0.0;
+        for (t_time latency : stats.latencies)
+        {
+          sum += latency;
+        }
+        size_t n = stats.latencies.size();
+        printf("%-4u %-8u %-7u %5.1f  %7lu  %9lu  %4lu  %5lu  %8lu  %6.2f / %-6.2f    %6.2f\n",
+          fps, baud, count, 100.0 * stats.wire_busy / stats.duration, stats.frames_skipped,
+          stats.frames_presented, stats.frames_torn, stats.frames_mixed, stats.ring_overruns,
+          n ? ms(sum / n) : 0.0, ms(percentile(stats.latencies, 0.99)),
+          stats.age_time ? ms(stats.age_sum / stats.age_time) : 0.0);
+      }
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  t_sim_config config;
+  bool do_sweep = false;
+  bool seconds_given = false;
+  for (int i = 1; i < argc; i++)
+  {
+    const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (strcmp(argv[i], "-x") == 0)
+    {
+      do_sweep = true;
+      continue;
+    }
+    if (strcmp(argv[i], "-F") == 0)
+    {
+      config.fast_wire = true;
+      continue;
+    }
+    if (value == NULL || argv[i][0] != '-' || strlen(argv[i]) != 2)
+    {
+      fprintf(stderr, "usage: observer_sim [-x] [-t trace] [-F] [-f fps] [-b baud] [-c copies] [-q words]\n"
+                      "                    [-p bytes] [-n words] [-l 0|1] [-o 0|1] [-s seconds] [-w writes] [-j ticks] [-e ticks] [-d permille] [-m ticks] [-r seed]\n");
+      return 2;
+    }
+    switch (argv[i][1])
+    {
+    case 'f': config.fps = atoi(value); break;
+    case 'b': config.baud = atoi(value); break;
+    case 'c': config.copies = atoi(value); break;
+    case 'q': config.tx_buffer = atoi(value); break;
+    case 'p': config.tx_bytes_per_word = atoi(value); break;
+    case 'n': config.tx_burst = atoi(value); break;
+    case 'l': config.stream_lines = atoi(value) != 0; break;
+    case 'o': config.send_newest = atoi(value) != 0; break;
+    case 's': config.seconds = atof(value); seconds_given = true; break;
+    case 't': config.trace = value; break;
+    case 'w': config.writes_per_frame = atoi(value); break;
+    case 'j': config.jitter = atoi(value); break;
+    case 'e': config.sync_noise = atoi(value); break;
+    case 'd': config.sync_loss = atoi(value); break;
+    case 'm': config.crt_margin = atoi(value); break;
+    case 'r': config.seed = atoi(value); break;
+    default:
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+    i++;
+  }
+  if ((config.fps != 50 && config.fps != 60) || config.copies < 1 || config.copies > MAX_BUF_COPIES ||
+      config.baud == 0 || config.tx_buffer < 2 || (config.tx_buffer & (config.tx_buffer - 1)) != 0 ||
+      (config.tx_bytes_per_word != 1 && config.tx_bytes_per_word != 2 && config.tx_bytes_per_word != 4) ||
+      config.tx_burst > NBSP_MAX_BURST || config.tx_burst >= config.tx_buffer)
+  {
+    fprintf(stderr, "fps must be 50 or 60, copies 1 to %u, the buffer a power of 2, bytes per word 1, 2 or 4,\n"
+                    "bursts up to %u words and less than the buffer\n", MAX_BUF_COPIES, NBSP_MAX_BURST);
+    return 2;
+  }
+
+  if (config.trace != NULL && !seconds_given)
+  {
+    config.seconds = 0;
+  }
+
+  if (do_sweep)
+  {
+    return sweep(config);
+  }
+  t_sim_stats stats;
+  clock_t start = clock();
+  if (simulate(config, stats) < 0)
+  {
+    return 1;
+  }
+  double cpu = (double)(clock() - start) / CLOCKS_PER_SEC;
+  report(config, stats, cpu > 0.0 ? cpu : 1e-6);
+  return 0;
+}
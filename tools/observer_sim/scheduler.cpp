@@ -0,0 +1,95 @@
+#include "scheduler.h"
+
+bool t_scheduler::run_until(t_time end)
+{
+  while (!events.empty() && events.top().time <= end)
+  {
+    t_event event = events.top();
+    events.pop();
+    now = event.time;
+    event_count++;
+    event.task->event(event);
+  }
+  now = end;
+  return !events.empty();
+}
+
+void t_task::event(const t_event& event)
+{
+  switch (event.kind)
+  {
+  case EVENT_INPUT:
+    inputs.push_back(t_input{ event.what, event.arg, input_order++ });
+    try_wake();
+    break;
+
+  case EVENT_TIMER:
+    if (scheduler.now < free_at)
+    {
+      // still in a case of wait_until_select
+      scheduler.post(free_at, this, EVENT_TIMER, event.what, event.arg);
+      break;
+    }
+    waiting = false;
+    run(event.what, event.arg, 0);
+    break;
+
+  case EVENT_WAKE:
+    wake_posted = false;
+    if (first_input() < 0)
+    {
+      break;
+    }
+    if (scheduler.now < free_at)
+    {
+      try_wake();
+      break;
+    }
+    {
+      size_t first = first_input();
+      t_input input = inputs[first];
+      inputs.erase(inputs.begin() + first);
+      run(input.what, input.arg, select_cost);
+    }
+    break;
+  }
+}
+
+void t_task::run(int what, uint64_t arg, unsigned entry_cost)
+{
+  elapsed = entry_cost;
+  cycles += entry_cost;
+  handle(what, arg);
+  free_at = scheduler.now + elapsed;
+  elapsed = 0;
+  try_wake();
+}
+
+// first_input returns the index of the input the select takes, the first
+// ready case wins, or -1 if there is none
+int t_task::first_input() const
+{
+  int first = -1;
+  for (size_t i = 0; i < inputs.size(); i++)
+  {
+    if (waiting && inputs[i].what < open_from)
+    {
+      continue;
+    }
+    if (first < 0 || inputs[i].what < inputs[first].what ||
+        (inputs[i].what == inputs[first].what && inputs[i].order < inputs[first].order))
+    {
+      first = i;
+    }
+  }
+  return first;
+}
+
+void t_task::try_wake()
+{
+  if (!wake_posted && first_input() >= 0)
+  {
+    wake_posted = true;
+    scheduler.post(free_at > scheduler.now ? free_at : scheduler.now, this, EVENT_WAKE, 0, 0);
+  }
+}
@@ -0,0 +1,154 @@
+// discrete event scheduler for simulating XMOS threads
+//
+// Time runs in ticks of 10 ns, the XMOS reference clock. A t_task is a
+// thread sitting in a select loop: an input (a channel message, a port
+// change) that becomes ready while the thread is busy waits until the
+// thread gets back to its select, and inputs that are ready at the same
+// time are taken in the order of their case, like with #pragma ordered.
+// A handler accounts for the time it takes with spend() and can block on
+// a timer with wait_until(), which keeps all inputs waiting just like
+// "t when timerafter(time) :> void" inside a case does, or with
+// wait_until_select(), a select of the timer and some of the inputs.
+
+#ifndef __scheduler_h__
+#define __scheduler_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <queue>
+#include <vector>
+#include <functional>
+
+typedef uint64_t t_time; // in ticks of 10 ns
+
+#define TICKS_PER_SECOND 100000000ULL
+
+class t_task;
+
+enum { EVENT_INPUT, EVENT_TIMER, EVENT_WAKE };
+
+struct t_event
+{
+  t_time time;
+  uint64_t order; // events at the same time run in the order they were posted
+  t_task* task;
+  int kind;
+  int what;
+  uint64_t arg;
+
+  bool operator>(const t_event& other) const
+  {
+    return time != other.time ? time > other.time : order > other.order;
+  }
+};
+
+class t_scheduler
+{
+public:
+  t_time now = 0;
+  uint64_t event_count = 0;
+
+  void post(t_time time, t_task* task, int kind, int what, uint64_t arg)
+  {
+    events.push(t_event{ time, order++, task, kind, what, arg });
+  }
+
+  // run_until runs the events up to end, returns false if there are none left
+  bool run_until(t_time end);
+
+private:
+  std::priority_queue<t_event, std::vector<t_event>, std::greater<t_event>> events;
+  uint64_t order = 0;
+};
+
+struct t_input
+{
+  int what; // also the case order, lower first
+  uint64_t arg;
+  uint64_t order;
+};
+
+class t_task
+{
+public:
+  // select_cost is the time from an input being taken to the case code
+  t_task(t_scheduler& scheduler, unsigned select_cost) : scheduler(scheduler), select_cost(select_cost) {}
+  virtual ~t_task() {}
+
+  // deliver makes an input ready at time
+  void deliver(t_time time, int what, uint64_t arg)
+  {
+    scheduler.post(time, this, EVENT_INPUT, what, arg);
+  }
+
+  // the current time inside a handler
+  t_time when() const
+  {
+    return scheduler.now + elapsed;
+  }
+
+  // spend accounts for time the handler takes
+  void spend(unsigned ticks)
+  {
+    elapsed += ticks;
+    cycles += ticks;
+  }
+
+  void event(const t_event& event);
+
+  // when the thread gets back to its select
+  t_time free_time() const
+  {
+    return free_at;
+  }
+
+  // busy_until keeps the thread busy until time, e.g. for a blocking
+  // port output
+  void busy_until(t_time time)
+  {
+    if (time > when())
+    {
+      elapsed = time - scheduler.now;
+    }
+  }
+
+  uint64_t cycles = 0; // ticks spent executing, not blocked in a port, timer or select
+
+protected:
+  t_scheduler& scheduler;
+
+  virtual void handle(int what, uint64_t arg) = 0;
+
+  // wait_until blocks the thread until time (or not at all if it passed),
+  // then handle(what, arg) continues
+  void wait_until(t_time time, int what, uint64_t arg)
+  {
+    wait_until_select(time, what, arg, INT_MAX);
+  }
+
+  // wait_until_select is wait_until in a select that also takes the inputs
+  // from open_what on, their cases run while waiting, the timer case first
+  void wait_until_select(t_time time, int what, uint64_t arg, int open_what)
+  {
+    waiting = true;
+    open_from = open_what;
+    scheduler.post(time > when() ? time : when(), this, EVENT_TIMER, what, arg);
+  }
+
+private:
+  unsigned select_cost;
+  std::vector<t_input> inputs;
+  uint64_t input_order = 0;
+  t_time free_at = 0;
+  bool waiting = false;
+  int open_from = INT_MAX; // inputs taken while waiting
+  bool wake_posted = false;
+  unsigned elapsed = 0;
+
+  void run(int what, uint64_t arg, unsigned entry_cost);
+  void try_wake();
+  int first_input() const;
+};
+
+#endif
@@ -0,0 +1,12 @@
+// host stand-in for the XMOS safestring.h, so the firmware's C files
+// compile unchanged for the simulation
+
+#ifndef __safestring_h__
+#define __safestring_h__
+
+#include <string.h>
+
+#define safememset memset
+#define safememcpy memcpy
+
+#endif
@@ -0,0 +1,422 @@
+// tracetool makes bus traces (see bustrace.h) for observer_sim and inspects them
+//
+// usage: tracetool screens session.bin|recording trace [-f fps] [-c cycles] [-r seed]
+//        tracetool csv capture.csv trace
+//        tracetool info trace
+//
+// screens turns the screens of a raw serial session or a recording (see
+// serial2hdmi's session.h and recording.h) back into the writes a PET
+// would have made: per frame, the cells that changed since the last frame
+// are written in ascending order as one burst, starting at a random point
+// of the frame, one write every cycles microseconds (default 16, a 6502
+// copy loop at 1 MHz), and a burst that doesn't fit runs into the next
+// frames like a scroll on the real machine. Raw sessions have a screen per
+// frame, recordings are sampled at the frame rate (default 50).
+//
+// csv converts a capture, e.g. a logic analyser's listing massaged with
+// awk, of lines
+//   time,what,address,data
+// with the time in seconds, what W for a write (address and data in hex),
+// F for a frame sync and G for a change of the graphic pin (data 0 or 1).
+// Writes outside 0x8000..0x8FFF, which the observer ignores, are dropped,
+// lines that don't parse (headers, comments) are skipped.
+//
+// info prints the duration, the event counts and the writes per frame.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bustrace.h"
+#include "receiver.h"
+#include "recording.h"
+
+#define TICKS_PER_US (BUSTRACE_TICKS_PER_SECOND / 1000000)
+#define PENDING_SIZE (1 << 16) // writes scheduled but not yet in the trace, a power of 2
+
+typedef struct {
+  t_trace_writer writer;
+  uint64_t period;         // of a frame, in ticks
+  uint64_t write_ticks;    // between two writes of a burst
+  uint64_t cpu_free;       // when the last burst ends
+  uint64_t frames;
+  unsigned char screen[SCREEN_SIZE]; // after the writes made so far
+  unsigned char graphic;
+  t_bus_event pending[PENDING_SIZE];
+  unsigned pending_in;
+  unsigned pending_out;
+} t_generator;
+
+static void init_generator(t_generator* generator, double fps, unsigned cycles)
+{
+  generator->period = (uint64_t)(BUSTRACE_TICKS_PER_SECOND / fps);
+  generator->write_ticks = cycles * TICKS_PER_US;
+  generator->cpu_free = 0;
+  generator->frames = 0;
+  memset(generator->screen, 0, SCREEN_SIZE);
+  generator->graphic = 0;
+  generator->pending_in = 0;
+  generator->pending_out = 0;
+}
+
+// flush_pending writes the scheduled writes before time to the trace
+static int flush_pending(t_generator* generator, uint64_t time)
+{
+  while (generator->pending_out != generator->pending_in)
+  {
+    t_bus_event* event = &generator->pending[generator->pending_out % PENDING_SIZE];
+    if (event->time >= time)
+    {
+      break;
+    }
+    if (trace_write(&generator->writer, event) < 0)
+    {
+      return -1;
+    }
+    generator->pending_out++;
+  }
+  return 0;
+}
+
+// add_frame adds a frame sync and the writes that make the PET's screen
+// equal to screen
+static int add_frame(t_generator* generator, const unsigned char* screen, unsigned char graphic)
+{
+  static unsigned short positions[SCREEN_SIZE];
+  uint64_t sync = generator->frames * generator->period;
+  generator->frames++;
+  if (flush_pending(generator, sync) < 0)
+  {
+    return -1;
+  }
+  t_bus_event event;
+  event.time = sync;
+  event.type = BUS_SYNC;
+  if (trace_write(&generator->writer, &event) < 0)
+  {
+    return -1;
+  }
+
+  uint64_t start = sync + (uint64_t)((double)rand() / ((double)RAND_MAX + 1) * generator->period);
+  if (start < generator->cpu_free)
+  {
+    start = generator->cpu_free;
+  }
+  if (graphic != generator->graphic)
+  {
+    // the pin changes with the frame, not with the writes
+    event.type = BUS_GRAPHIC;
+    event.data = graphic;
+    if (trace_write(&generator->writer, &event) < 0)
+    {
+      return -1;
+    }
+    generator->graphic = graphic;
+  }
+  unsigned count = screen_diff(generator->screen, screen, positions);
+  for (unsigned i = 0; i < count; i++)
+  {
+    if (generator->pending_in - generator->pending_out == PENDING_SIZE)
+    {
+      fprintf(stderr, "the writes fall more than %u behind the screens, try fewer cycles per write\n", PENDING_SIZE);
+      return -1;
+    }
+    t_bus_event* write = &generator->pending[generator->pending_in++ % PENDING_SIZE];
+    write->time = start + i * generator->write_ticks;
+    write->type = BUS_WRITE;
+    write->address = BUS_SCREEN_ADDRESS + positions[i];
+    write->data = screen[positions[i]];
+    generator->screen[positions[i]] = screen[positions[i]];
+  }
+  if (count > 0)
+  {
+    generator->cpu_free = start + count * generator->write_ticks;
+  }
+  return 0;
+}
+
+static int finish(t_generator* generator, const char* trace_file)
+{
+  int result = flush_pending(generator, UINT64_MAX);
+  printf("%llu frames, %llu events, %.1f s\n", (unsigned long long)generator->frames,
+    (unsigned long long)generator->writer.events,
+    (double)generator->writer.time / BUSTRACE_TICKS_PER_SECOND);
+  if (trace_writer_close(&generator->writer) < 0 || result < 0)
+  {
+    perror(trace_file);
+    return 1;
+  }
+  return 0;
+}
+
+static int from_recording(t_generator* generator, const char* recording_file, double fps)
+{
+  t_player player;
+  if (player_open(&player, recording_file) < 0)
+  {
+    return 1;
+  }
+  static unsigned char screen[SCREEN_SIZE];
+  memcpy(screen, player.screen, SCREEN_SIZE);
+  unsigned char graphic = player.graphic;
+  int more = 1;
+  int result = 0;
+  while (result == 0)
+  {
+    double time = generator->frames * 1000.0 / fps;
+    while (more && player.time <= time)
+    {
+      memcpy(screen, player.screen, SCREEN_SIZE);
+      graphic = player.graphic;
+      more = player_next(&player);
+    }
+    result = add_frame(generator, screen, graphic);
+    if (!more && time >= player.time)
+    {
+      break;
+    }
+  }
+  player_close(&player);
+  return result;
+}
+
+static int from_session(t_generator* generator, const char* session_file)
+{
+  FILE* fp = fopen(session_file, "rb");
+  if (fp == NULL)
+  {
+    perror(session_file);
+    return 1;
+  }
+  static unsigned char screen[SCREEN_SIZE];
+  unsigned char graphic = 0;
+  t_receiver_context context;
+  init_receiver_context(&context);
+  context.screen_buffer = screen;
+  context.graphic = &graphic;
+  int byte;
+  int result = 0;
+  while (result == 0 && (byte = fgetc(fp)) != EOF)
+  {
+    if (handle_received_byte(&context, (unsigned char)byte))
+    {
+      result = add_frame(generator, screen, graphic);
+    }
+  }
+  fclose(fp);
+  return result;
+}
+
+static int screens(int argc, char** argv)
+{
+  double fps = 50;
+  unsigned cycles = 16;
+  for (int i = 4; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "-f") == 0)
+    {
+      fps = atof(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "-c") == 0)
+    {
+      cycles = atoi(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "-r") == 0)
+    {
+      srand(atoi(argv[i + 1]));
+    }
+  }
+  if (fps <= 0 || cycles == 0)
+  {
+    fprintf(stderr, "frame rate and cycles per write must be positive\n");
+    return 2;
+  }
+  static t_generator generator;
+  init_generator(&generator, fps, cycles);
+  if (trace_writer_open(&generator.writer, argv[3]) < 0)
+  {
+    return 1;
+  }
+  int result = is_recording(argv[2]) ? from_recording(&generator, argv[2], fps) : from_session(&generator, argv[2]);
+  if (finish(&generator, argv[3]) != 0)
+  {
+    return 1;
+  }
+  return result != 0;
+}
+
+//----------------------------------------------------------------------------------------
+
+// split_fields cuts line at the commas, returns the number of fields
+static unsigned split_fields(char* line, char** fields, unsigned max_fields)
+{
+  unsigned count = 0;
+  while (count < max_fields)
+  {
+    fields[count++] = line;
+    line = strchr(line, ',');
+    if (line == NULL)
+    {
+      break;
+    }
+    *line++ = 0;
+  }
+  return count;
+}
+
+static int csv(const char* csv_file, const char* trace_file)
+{
+  FILE* fp = fopen(csv_file, "r");
+  if (fp == NULL)
+  {
+    perror(csv_file);
+    return 1;
+  }
+  t_trace_writer writer;
+  if (trace_writer_open(&writer, trace_file) < 0)
+  {
+    fclose(fp);
+    return 1;
+  }
+  char line[256];
+  double first = -1;
+  unsigned long skipped = 0;
+  int result = 0;
+  while (result == 0 && fgets(line, sizeof(line), fp) != NULL)
+  {
+    char* fields[4] = { "", "", "", "" };
+    split_fields(line, fields, 4);
+    char* end;
+    double seconds = strtod(fields[0], &end);
+    char what = fields[1][strspn(fields[1], " ")];
+    if (end == fields[0] || seconds < first)
+    {
+      skipped++;
+      continue;
+    }
+    unsigned address = strtoul(fields[2], NULL, 16);
+    unsigned data = strtoul(fields[3], NULL, 16);
+    if (first < 0)
+    {
+      first = seconds;
+    }
+    t_bus_event event;
+    event.time = (uint64_t)((seconds - first) * BUSTRACE_TICKS_PER_SECOND + 0.5);
+    if (event.time < writer.time)
+    {
+      event.time = writer.time; // rounding
+    }
+    switch (what)
+    {
+    case 'W':
+      if ((address & 0xF000) != BUS_SCREEN_ADDRESS)
+      {
+        continue;
+      }
+      event.type = BUS_WRITE;
+      event.address = address;
+      event.data = data;
+      break;
+    case 'F':
+      event.type = BUS_SYNC;
+      break;
+    case 'G':
+      event.type = BUS_GRAPHIC;
+      event.data = data != 0;
+      break;
+    default:
+      skipped++;
+      continue;
+    }
+    result = trace_write(&writer, &event);
+  }
+  fclose(fp);
+  printf("%llu events, %.1f s, %lu lines skipped\n", (unsigned long long)writer.events,
+    (double)writer.time / BUSTRACE_TICKS_PER_SECOND, skipped);
+  if (trace_writer_close(&writer) < 0 || result < 0)
+  {
+    perror(trace_file);
+    return 1;
+  }
+  return 0;
+}
+
+//----------------------------------------------------------------------------------------
+
+static int info(const char* trace_file)
+{
+  t_trace_reader reader;
+  if (trace_reader_open(&reader, trace_file) < 0)
+  {
+    return 1;
+  }
+  unsigned long writes = 0, screen_writes = 0, graphics = 0, frames = 0;
+  unsigned long frame_writes = 0, max_frame_writes = 0;
+  uint64_t first_sync = 0, last_sync = 0;
+  t_bus_event event;
+  int result;
+  while ((result = trace_read(&reader, &event)) == 1)
+  {
+    switch (event.type)
+    {
+    case BUS_WRITE:
+      writes++;
+      frame_writes++;
+      screen_writes += event.address >= BUS_SCREEN_ADDRESS && event.address < BUS_SCREEN_ADDRESS + SCREEN_SIZE;
+      break;
+    case BUS_GRAPHIC:
+      graphics++;
+      break;
+    case BUS_SYNC:
+      if (frames == 0)
+      {
+        first_sync = event.time;
+      }
+      last_sync = event.time;
+      frames++;
+      if (frame_writes > max_frame_writes)
+      {
+        max_frame_writes = frame_writes;
+      }
+      frame_writes = 0;
+      break;
+    }
+  }
+  long size = ftell(reader.fp);
+  trace_reader_close(&reader);
+  if (result < 0)
+  {
+    fprintf(stderr, "%s: damaged after %llu events\n", trace_file, (unsigned long long)reader.events);
+  }
+  double seconds = (double)reader.time / BUSTRACE_TICKS_PER_SECOND;
+  printf("%.1f s, %llu events, %ld bytes (%.1f MB per hour)\n", seconds, (unsigned long long)reader.events,
+    size, seconds > 0 ? size / seconds * 3600 / 1e6 : 0.0);
+  printf("%lu frame syncs", frames);
+  if (frames > 1)
+  {
+    printf(" (%.2f Hz)", (frames - 1) * (double)BUSTRACE_TICKS_PER_SECOND / (last_sync - first_sync));
+  }
+  printf(", %lu graphic changes\n", graphics);
+  printf("%lu writes, %lu to the screen, %.1f per frame, at most %lu\n", writes, screen_writes,
+    frames ? (double)writes / frames : 0.0, max_frame_writes);
+  return result < 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc >= 4 && strcmp(argv[1], "screens") == 0)
+  {
+    return screens(argc, argv);
+  }
+  if (argc == 4 && strcmp(argv[1], "csv") == 0)
+  {
+    return csv(argv[2], argv[3]);
+  }
+  if (argc == 3 && strcmp(argv[1], "info") == 0)
+  {
+    return info(argv[2]);
+  }
+  fprintf(stderr, "usage: tracetool screens session.bin|recording trace [-f fps] [-c cycles] [-r seed]\n"
+                  "       tracetool csv capture.csv trace\n"
+                  "       tracetool info trace\n");
+  return 2;
+}
@@ -0,0 +1,128 @@
+#include "frame_timing.h"
+
+// an edge is seen late, when the thread is busy, but never early, so one
+// before its prediction moves the sync to it, one after it only by 1/16 of
+// the difference, and the period follows by 1/4 of the sync's move per
+// frame; the sync then stays close to the earliest edges
+#define PHASE_GAIN_EARLY     1
+#define PHASE_GAIN_LATE     16
+#define PERIOD_GAIN          4
+#define OFF_SYNCS_TO_UNLOCK  4 // in a row
+#define MAX_MISSED           8 // frames without an edge, the timer wraps after 42 s
+
+// the first line's latch after the sync edge, measured at 50 Hz (520000)
+// and 60 Hz (370000), for other periods in proportion
+#define PERIOD_60HZ     1666667
+#define FIRST_LINE_60HZ  370000
+
+static unsigned locked;
+static unsigned period;     // 0 until the first two edges a frame apart
+static unsigned sync;       // filtered time of the last sync
+static unsigned frame_sync; // the lines of the frame synced last are timed from this
+static unsigned last_edge;
+static unsigned have_edge;
+static unsigned off_in_row;
+static int drift;
+static unsigned missed_syncs;
+static unsigned off_syncs;
+
+void frame_timing_init()
+{
+  locked = 0;
+  period = 0;
+  have_edge = 0;
+  off_in_row = 0;
+  drift = 0;
+  missed_syncs = 0;
+  off_syncs = 0;
+}
+
+unsigned frame_timing_sync(unsigned time)
+{
+  if (locked)
+  {
+    int elapsed = (int)(time - sync);
+    if (elapsed < (int)(period / 2))
+    {
+      off_syncs++; // a glitch just after the sync
+      return 0;
+    }
+    unsigned frames = ((unsigned)elapsed + period / 2) / period;
+    if (frames <= MAX_MISSED)
+    {
+      unsigned predicted = sync + frames * period;
+      int difference = (int)(time - predicted);
+      if (-FRAME_SYNC_WINDOW <= difference && difference <= FRAME_SYNC_WINDOW)
+      {
+        int correction = difference / (difference < 0 ? PHASE_GAIN_EARLY : PHASE_GAIN_LATE);
+        missed_syncs += frames - 1;
+        sync = predicted + correction;
+        period += correction / (int)(frames * PERIOD_GAIN);
+        frame_sync = sync;
+        drift = difference;
+        off_in_row = 0;
+        last_edge = time;
+        return 1;
+      }
+    }
+    // off the prediction, the lines are timed from the edge itself
+    off_syncs++;
+    off_in_row++;
+    if (off_in_row < OFF_SYNCS_TO_UNLOCK && frames <= MAX_MISSED)
+    {
+      frame_sync = time;
+      last_edge = time;
+      return 1;
+    }
+    locked = 0;
+  }
+
+  // lock on two edges a frame apart
+  drift = 0;
+  if (have_edge && time - last_edge >= FRAME_PERIOD_MIN && time - last_edge <= FRAME_PERIOD_MAX)
+  {
+    locked = 1;
+    period = time - last_edge;
+    sync = time;
+    off_in_row = 0;
+  }
+  have_edge = 1;
+  last_edge = time;
+  frame_sync = time;
+  // the first line's latch depends on the period, a guess at 50 Hz would
+  // time the copies of a 60 Hz frame 1.5 ms late, after the latches; until
+  // a period was measured the frame isn't copied, afterwards the last one
+  // stands in while relocking
+  return period != 0;
+}
+
+unsigned frame_timing_line_due(unsigned line)
+{
+  unsigned first = FIRST_LINE_60HZ + (int)(period - PERIOD_60HZ) * 9 / 20;
+  return frame_sync + first + line * FRAME_LINE_PERIOD;
+}
+
+unsigned frame_timing_locked()
+{
+  return locked;
+}
+
+unsigned frame_timing_period()
+{
+  return period;
+}
+
+int frame_timing_drift()
+{
+  return drift;
+}
+
+unsigned frame_timing_missed_syncs()
+{
+  return missed_syncs;
+}
+
+unsigned frame_timing_off_syncs()
+{
+  return off_syncs;
+}
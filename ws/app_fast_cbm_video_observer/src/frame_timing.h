@@ -0,0 +1,34 @@
+// tracks the frame sync to predict when the CRT latches each line
+//
+// frame_timing_sync takes the time of each frame sync edge. Two edges a
+// plausible frame period apart lock the tracking, from then on each edge is
+// compared with the prediction from the filtered sync time and period, and
+// moves both by a part of the difference. Edges off the prediction are
+// counted, after a few of them in a row the tracking starts over, e.g. when
+// the frame rate changed. All times in tens of nanoseconds.
+
+#ifndef __frame_timing_h__
+#define __frame_timing_h__
+
+#define FRAME_PERIOD_MIN   1500000 // 66.7 Hz
+#define FRAME_PERIOD_MAX   2200000 // 45.5 Hz
+#define FRAME_SYNC_WINDOW    20000 // an edge this close to its prediction is on time
+#define FRAME_LINE_PERIOD    40000 // from one line's latch to the next
+
+extern void frame_timing_init();
+
+// frame_timing_sync returns 1 if the frame is to be copied, 0 for an edge
+// within half a frame of the previous sync, which is ignored, and for the
+// edges before the first frame period was measured
+extern unsigned frame_timing_sync(unsigned time);
+
+// when the copy of line (0 ... 24) of the frame synced last is due
+extern unsigned frame_timing_line_due(unsigned line);
+
+extern unsigned frame_timing_locked();
+extern unsigned frame_timing_period();
+extern int frame_timing_drift();               // last edge after its prediction, 0 if not locked
+extern unsigned frame_timing_missed_syncs();   // frames without an edge while locked
+extern unsigned frame_timing_off_syncs();      // edges off the prediction or ignored
+
+#endif
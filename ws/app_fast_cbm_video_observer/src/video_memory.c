@@ -4,6 +4,34 @@
 unsigned char video_buffer[40*51];  // 2000 bytes of video data and 40 bytes of flags (with graphic)
 unsigned char copied_buffer[VIDEO_BUF_COPIES][40*52]; // 40 bytes of zeroes, followed by video_buffer
 
+// The line copied last, writes to it within TEAR_WINDOW of the copy are
+// tears. frame_observer publishes the line and the time its copy was due in
+// a single word, so memory_observer never sees the line of one copy with the
+// time of another: the line plus 1 in the low TEAR_LINE_BITS, 0 once the
+// flags are copied, and the time rounded down to 32 ticks (0.32 us) above.
+#define TEAR_LINE_BITS 5
+#define TEAR_LINE_MASK ((1 << TEAR_LINE_BITS) - 1)
+static volatile unsigned tear_copy;
+
+// The tears are counted by memory_observer and read by frame_observer, which
+// runs in parallel, so each word has one writer. frame_observer writes
+// tear_frame, the frame being counted, and moves it on once it copied the
+// flags. memory_observer writes tear_count, the frame it counted for in the
+// upper 24 bits and its tears in the lower 8, with a single store. A count
+// for an older frame reads as no tears, so memory_observer's first tear of
+// a frame resets it and nobody else ever does. The positions of a frame go
+// to one half of tear_positions, frame_observer reads those of the frame it
+// copies while memory_observer writes the other half for the next frame.
+// A tear in flight while the flags are copied is not reported.
+static volatile unsigned tear_frame;
+static volatile unsigned tear_count;
+static volatile unsigned char tear_positions[2][3 * TEAR_POSITIONS];
+
+static unsigned tears_of(unsigned count, unsigned frame)
+{
+  return (count >> 8) == (frame & 0xFFFFFF) ? (count & 0xFF) : 0;
+}
+
 void video_memory_init()
 {
   safememset(video_buffer, 0, sizeof(video_buffer));
@@ -11,29 +39,88 @@ void video_memory_init()
   {
     safememset(copied_buffer[buf_num], 0, 40); // first 40 bytes must be zero
   }
+  tear_copy = 0;
+  tear_frame = 0;
+  tear_count = 0;
 }
 
-void video_memory_write_data(unsigned index, unsigned data)
+void video_memory_write_data(unsigned index, unsigned data, unsigned time)
 {
   video_buffer[index] = (unsigned char)data;
+  unsigned copy = tear_copy;
+  // no line (0) starts at -80, so one compare for writes outside the line
+  unsigned start = ((copy & TEAR_LINE_MASK) - 1) * 80;
+  unsigned copy_time = copy & ~TEAR_LINE_MASK;
+  if (index - start < 80 && time - copy_time < TEAR_WINDOW)
+  {
+    unsigned frame = tear_frame;
+    unsigned tears = tears_of(tear_count, frame);
+    if (tears < TEAR_POSITIONS)
+    {
+      volatile unsigned char* position = tear_positions[frame & 1] + 3 * tears;
+      position[0] = (unsigned char)((copy & TEAR_LINE_MASK) - 1);
+      position[1] = (unsigned char)(index - start);
+      position[2] = (unsigned char)((time - copy_time) / 100);
+    }
+    if (tears < 255)
+    {
+      tears++;
+    }
+    // after the position, frame_observer copies as many as the count says
+    tear_count = (frame & 0xFFFFFF) << 8 | tears;
+  }
 }
 
 void video_memory_write_graphic(unsigned graphic)
 {
-  video_buffer[40*50] = (unsigned char)graphic;
+  video_buffer[40*50 + FLAGS_GRAPHIC] = (unsigned char)graphic;
 }
 
-void video_memory_copy_line_to(unsigned buf_num, unsigned line)
+void video_memory_write_sync(unsigned missed_syncs, int drift)
+{
+  drift /= 100; // in microseconds
+  if (drift > 127)
+  {
+    drift = 127;
+  }
+  if (drift < -127)
+  {
+    drift = -127;
+  }
+  video_buffer[40*50 + FLAGS_MISSED_SYNCS] = (unsigned char)missed_syncs;
+  video_buffer[40*50 + FLAGS_SYNC_DRIFT] = (unsigned char)drift;
+}
+
+void video_memory_copy_line_to(unsigned buf_num, unsigned line, unsigned time)
 {
   // line in range 0 ... 24
   // first 40 bytes are left alone
   safememcpy(copied_buffer[buf_num] + 40 + (line * 80), video_buffer + line * 80, 80);
+  tear_copy = (time & ~TEAR_LINE_MASK) | (line + 1);
 }
 
 void video_memory_copy_flags_to(unsigned buf_num)
 {
+  // memory_observer counts no more tears for this frame
+  tear_copy = 0;
+  unsigned frame = tear_frame;
+  unsigned tears = tears_of(tear_count, frame);
+  video_buffer[40*50 + FLAGS_TEARS] = (unsigned char)tears;
+  for (unsigned i = 0; i < 3 * TEAR_POSITIONS && i < 3 * tears; i++)
+  {
+    video_buffer[40*50 + FLAGS_TEAR_POSITIONS + i] = tear_positions[frame & 1][i];
+  }
   // first 40 bytes are left alone
   safememcpy(copied_buffer[buf_num] + 40*51, video_buffer + 40*50, 40);
+  // the next tear starts the count of the next frame
+  tear_frame = frame + 1;
+}
+
+// the renderer's counts go into a copy of which the flags are copied
+void video_memory_write_skipped_to(unsigned buf_num, unsigned skipped, unsigned superseded)
+{
+  copied_buffer[buf_num][40*51 + FLAGS_SKIPPED] = (unsigned char)skipped;
+  copied_buffer[buf_num][40*51 + FLAGS_SUPERSEDED] = (unsigned char)superseded;
 }
 
 unsigned video_memory_read_from_copy(unsigned buf_num, unsigned index)
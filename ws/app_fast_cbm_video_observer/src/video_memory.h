@@ -1,9 +1,31 @@
 // beware: only 8 bits of the data are written/read
 
-#define VIDEO_BUF_COPIES 4
+#ifndef VIDEO_BUF_COPIES
+#define VIDEO_BUF_COPIES 4 // the host simulation builds with more to try other counts
+#endif
+// the 40 bytes of flags, buffer 51 on the wire
+#define FLAGS_GRAPHIC        0 // graphic pin
+#define FLAGS_TEARS          1 // writes that tore a line in this frame, up to 255
+#define FLAGS_TEAR_POSITIONS 2 // line, column and microseconds after the line's
+                               // copy of the first TEAR_POSITIONS of them
+#define TEAR_POSITIONS       8
+#define FLAGS_MISSED_SYNCS  26 // frame syncs missed so far, modulo 256
+#define FLAGS_SYNC_DRIFT    27 // microseconds this frame's sync was off its prediction,
+                               // signed, clamped to +-127
+#define FLAGS_SKIPPED       28 // copies the renderer did not send so far, modulo 256
+#define FLAGS_SUPERSEDED    29 // of them, those waiting for the UART when a newer
+                               // copy came, modulo 256
+
+// A write within TEAR_WINDOW after its line was copied may still reach the
+// CRT, which reads the line's first pixel row in 40 us from just after the
+// copy, the copy has the old data then. In tens of nanoseconds.
+#define TEAR_WINDOW 6400
+
 extern void video_memory_init();
-extern void video_memory_write_data(unsigned index, unsigned data);
+extern void video_memory_write_data(unsigned index, unsigned data, unsigned time);
 extern void video_memory_write_graphic(unsigned graphic);
-extern void video_memory_copy_line_to(unsigned buf_num, unsigned line);
+extern void video_memory_write_sync(unsigned missed_syncs, int drift);
+extern void video_memory_copy_line_to(unsigned buf_num, unsigned line, unsigned time);
 extern void video_memory_copy_flags_to(unsigned buf_num);
+extern void video_memory_write_skipped_to(unsigned buf_num, unsigned skipped, unsigned superseded);
 extern unsigned video_memory_read_from_copy(unsigned buf_num, unsigned index);
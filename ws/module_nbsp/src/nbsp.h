@@ -442,4 +442,93 @@ inline void nbsp_uddw_receive(unsafe chanend c, unsigned& data1, unsigned& data2
 
 extern void nbsp_uddw_flush(t_nbsp_state& state);
 
+//-----------------------------------------------------------------------------------------
+// Protocol variant UDNW = unidirectional, N words
+// - UDDW generalised to bursts of n words, n is fixed per channel and must be
+//   the same on both sides, the buffer size must be greater than n
+// - no tokens in forward direction, one END token per burst as acknowledgement
+// - the receiving channel end buffers 8 bytes, i.e. two words, so for n > 2
+//   nbsp_udnw_send and nbsp_udnw_handle_ack block until the receiver has taken
+//   the words beyond the second one; this pays off only if the receiver gets
+//   back to its select quickly, otherwise stay with UDDW or n <= 2
+// - the same restrictions as for UDDW apply, nbsp_udnw_handle_ack and
+//   nbsp_udnw_receive replace nbsp_receive_msg, nbsp_handle_msg and
+//   nbsp_received_data on the sender and the receiver side
+
+inline unsigned nbsp_udnw_send(t_nbsp_state& state, const unsigned data[], unsigned n)
+{
+  if (state.words_to_be_acknowledged == 0)
+  {
+    // buffer must be empty, we can immediately send, no need for buffering
+    unsafe
+    {
+      for (unsigned i = 0; i < n; i++)
+      {
+        unsafe_outuint(state.c, data[i]);
+      }
+    }
+    state.words_to_be_acknowledged = n;
+    return 1;
+  }
+  else
+  {
+    if (queue_room(state.queue) >= n)
+    {
+      for (unsigned i = 0; i < n; i++)
+      {
+        queue_in(state.queue, data[i]);
+      }
+      return 1;
+    }
+    else
+    {
+      // buffer has no room, data is not sent
+      return 0;
+    }
+  }
+}
+
+#define NBSP_UDNW_HANDLE_ACK(state, n) \
+  nbsp_udnw_handle_ack(state.c, state, n)
+
+#pragma select handler
+inline void nbsp_udnw_handle_ack(unsafe chanend c, t_nbsp_state& state, unsigned n)
+{
+  unsigned token;
+
+  unsafe_inct(c, token);
+
+#if CHECK_FOR_PROGRAMMING_ERRORS
+  if (state.words_to_be_acknowledged == 0)
+  {
+    printf("nbsp error: unexpected ack\n");
+  }
+#endif
+
+  if (queue_count(state.queue) >= n)
+  {
+    // there is more data to send
+    for (unsigned i = 0; i < n; i++)
+    {
+      unsafe_outuint(c, queue_out(state.queue));
+    }
+  }
+  else
+  {
+    state.words_to_be_acknowledged = 0;
+  }
+}
+
+#pragma select handler
+inline void nbsp_udnw_receive(unsafe chanend c, unsigned data[], unsigned n)
+{
+  for (unsigned i = 0; i < n; i++)
+  {
+    unsafe_inuint(c, data[i]);
+  }
+  unsafe_outct(c, XS1_CT_END);
+}
+
+extern void nbsp_udnw_flush(t_nbsp_state& state, unsigned n);
+
 #endif